@@ -681,6 +681,28 @@ bool mi_heap_visit_blocks(const mi_heap_t* heap, bool visit_blocks, mi_block_vis
 /// at the start of the program.
 bool mi_abandoned_visit_blocks(mi_subproc_id_t subproc_id, int heap_tag, bool visit_blocks, mi_block_visit_fun* visitor, void* arg);
 
+/// Start defragmentation of a heap.
+/// @param heap The heap (or \a NULL for the default heap).
+/// @param perc_threshold Pages with at most this percentage of used blocks are marked as sparse.
+/// @returns The number of sparse pages.
+///
+/// Until mi_heap_defrag_end() no allocations are made in sparse pages. The program can
+/// then move objects for which mi_defrag_should_move() returns \a true (by allocating a
+/// new block, copying, and freeing the old one) so the sparse pages empty out and their
+/// memory can be returned to the OS. This is similar to the active defragmentation in Redis.
+/// Should only be called by the thread that owns the heap.
+size_t mi_heap_defrag_begin(mi_heap_t* heap, size_t perc_threshold);
+
+/// End defragmentation of a heap: sparse pages are used for allocation again.
+/// @param heap The heap (or \a NULL for the default heap).
+void mi_heap_defrag_end(mi_heap_t* heap);
+
+/// Should an object be moved during defragmentation?
+/// @param p Pointer to a block.
+/// @returns \a true if the page of \a p was marked sparse by mi_heap_defrag_begin()
+/// and is not the current allocation target. This is an O(1) check.
+bool mi_defrag_should_move(const void* p);
+
 /// \}
 
 // ------------------------------------------------------
@@ -813,6 +835,84 @@ mi_heap_t* mi_heap_new_in_arena(mi_arena_id_t arena_id);
 /// @see mi_heap_new_in_arena() for __v3__
 mi_heap_t* mi_heap_new_ex(int heap_tag, bool allow_destroy, mi_arena_id_t arena_id);
 
+/// @brief Create a new heap that only allocates memory at a specific NUMA node.
+/// @param numa_node The NUMA node, or -1 for no node.
+/// @return The new heap or `NULL`. Also returns `NULL` (with an `EINVAL` error) if
+/// \a numa_node is not below the number of NUMA nodes.
+///
+/// Segments are taken from arena's at the given node where possible, and
+/// memory that is allocated directly from the OS is bound to the node (using `mbind` on Linux).
+/// The heap only reuses and reclaims segments that are located at the same node.
+/// @see mi_thread_set_numa_node()
+mi_heap_t* mi_heap_new_on_numa(int numa_node);
+
+/// @brief Bind the heaps of the current thread to a NUMA node.
+/// @param numa_node The NUMA node, or -1 to unbind.
+/// @return `true` on success, or `false` (with an `EINVAL` error) if \a numa_node is not below the number of NUMA nodes.
+///
+/// Heaps without their own NUMA node (see mi_heap_new_on_numa()) then behave as
+/// if they were created at this node. An unbound thread uses the node it runs on,
+/// which is cached per thread and re-determined on mi_collect().
+/// Abandoned segments at the node of the thread are preferred for reclamation.
+bool mi_thread_set_numa_node(int numa_node);
+
+/// Set the transparent huge page policy of a heap.
+/// @param heap The heap.
+/// @param thp  1 to back the segments of the heap with transparent huge pages (`MADV_HUGEPAGE`),
+///             0 to avoid them (`MADV_NOHUGEPAGE`), or -1 to use the process default.
+///
+/// Best called right after creating the heap as it only affects segments allocated afterwards;
+/// the heap only reuses and reclaims segments with the same policy. Segments with huge pages
+/// commit and purge memory in units of 2MiB so purging never splits a huge OS page.
+/// Huge pages cannot be enabled if they are disabled for the process (see #mi_option_allow_thp).
+/// Only has an effect on Linux.
+void mi_heap_set_thp(mi_heap_t* heap, int thp);
+
+/// Limit the memory of a heap.
+/// @param heap The heap.
+/// @param soft_limit When the total size of the heap pages goes above this limit the heap
+///                   is collected and the commit pressure handler is called (see mi_register_commit_pressure()). Use 0 for no limit.
+/// @param limit No fresh pages are allocated when the heap pages would go above this limit
+///              and allocation returns \a NULL (with an \a ENOMEM error). Use 0 for no limit.
+///
+/// The limit is checked when the heap needs a fresh page and can be exceeded by at most one page.
+/// See also #mi_option_commit_limit for a process wide limit.
+void mi_heap_set_commit_limit(mi_heap_t* heap, size_t soft_limit, size_t limit);
+
+/// Output formats of the heap profiler (see mi_heap_profile_print_out()).
+typedef enum mi_heap_profile_format_e {
+  mi_heap_profile_pprof,            ///< heap profile (`heap_v2`) format of gperftools that can be read by `pprof`.
+  mi_heap_profile_collapsed_live,   ///< collapsed stacks (as used by flame graph tools) with the estimated live bytes.
+  mi_heap_profile_collapsed_alloc   ///< collapsed stacks with the estimated total allocated bytes.
+} mi_heap_profile_format_t;
+
+/// Set the sample rate of the heap profiler for a heap.
+/// @param heap The heap.
+/// @param sample_rate About one allocation per \a sample_rate allocated bytes is sampled (use 0 to disable sampling).
+///
+/// Only available when building with `-DMI_HEAP_PROFILE=ON`. Each heap counts down the allocated bytes
+/// (with a random interval around the sample rate) and records the call stack of the allocation that
+/// reaches zero, until that object is freed. Each sample is weighted to estimate all allocations
+/// (so an object of at least \a sample_rate bytes counts for itself).
+/// The samples of the objects in a heap are forgotten on mi_heap_destroy(), except in guarded builds
+/// (which includes debug builds) where mi_heap_destroy() is mi_heap_delete() and the objects stay live.
+/// The initial rate is set by #mi_option_heap_profile_rate.
+void mi_heap_profile_set_sample_rate(mi_heap_t* heap, size_t sample_rate);
+
+/// Print the heap profile.
+/// @param format The output format.
+/// @param out An output function or \a NULL for the default.
+/// @param arg Optional argument passed to \a out (if not \a NULL)
+///
+/// Outputs the estimated live bytes and total allocated bytes (since the last mi_heap_profile_reset())
+/// per call stack. The `pprof` format is followed by the memory mappings of the process
+/// (so `pprof` can symbolize the addresses), while the collapsed formats give the raw addresses
+/// (which can be symbolized with `addr2line` for example).
+void mi_heap_profile_print_out(mi_heap_profile_format_t format, mi_output_fun* out, void* arg);
+
+/// Reset the total allocated bytes of the heap profile (but keep the live samples).
+void mi_heap_profile_reset(void);
+
 /// \}
 
 
@@ -907,6 +1007,18 @@ void mi_collect(bool force);
 /// to try to reduce non-local accesss.
 void mi_thread_set_in_threadpool(void);
 
+/// Buffer frees of blocks owned by other threads in the current thread.
+/// @param enable Enable or disable buffering for the current thread.
+///
+/// Buffered blocks are chained per page and published to the owning page
+/// with a single atomic operation when the chain fills up, on the next
+/// allocation slow path of this thread, on mi_collect(), or when the thread
+/// terminates. This overrides the #mi_option_remote_free_buffer option for the
+/// current thread (which is otherwise read once per thread); disabling it publishes
+/// any blocks that are still buffered. Frees of blocks in heaps that can be
+/// destroyed with mi_heap_destroy() (like those from mi_heap_new()) are never buffered.
+void mi_thread_set_remote_free_buffered(bool enable);
+
 /// Is the C runtime \a malloc API redirected?
 /// @returns \a true if all malloc API calls are redirected to mimalloc.
 ///
@@ -988,6 +1100,27 @@ typedef void (mi_error_fun)(int err, void* arg);
 /// * \a EINVAL: Trying to free or re-allocate an invalid pointer.
 void mi_register_error(mi_error_fun* errfun, void* arg);
 
+/// Type of commit pressure handlers.
+/// @param heap The heap that went above its soft limit, or \a NULL if the process went above #mi_option_commit_soft_limit.
+/// @param committed The current size of the heap pages, or the committed memory of the process.
+/// @param limit The soft limit.
+/// @param arg Argument that was passed at registration to hold extra state.
+///
+/// @see mi_register_commit_pressure()
+typedef void (mi_commit_pressure_fun)(mi_heap_t* heap, size_t committed, size_t limit, void* arg);
+
+/// Register a commit pressure handler.
+/// @param fun The handler (or \a NULL to unregister).
+/// @param arg Extra argument that will be passed on to the handler.
+///
+/// When the process commits more than #mi_option_commit_soft_limit, or a heap
+/// goes above its soft limit (see mi_heap_set_commit_limit()), the allocator
+/// collects memory (like mi_collect_reduce()) at the next allocation that
+/// takes the slow path and then calls the handler, which can free memory
+/// of the program (e.g. drop caches). The handler is called once each time a
+/// soft limit is crossed.
+void mi_register_commit_pressure(mi_commit_pressure_fun* fun, void* arg);
+
 /// Allocate a small object.
 /// @param size The size in bytes, can be at most #MI_SMALL_SIZE_MAX.
 /// @returns a pointer to newly allocated memory of at least \a size
@@ -1036,7 +1169,16 @@ void mi_free_small(void* p);
 /// \{
 
 /// Statistics version. Increased on each backward incompatible change.
-#define MI_STAT_VERSION   4
+#define MI_STAT_VERSION   6
+
+/// Number of buckets in the lifetime histogram of each size bin: bucket 0 counts objects that lived
+/// less than 1ms, bucket \a i those that lived from 4<sup>i-1</sup> up to 4<sup>i</sup> ms, and the last
+/// bucket all longer lived ones.
+#define MI_STAT_LIFETIME_BUCKETS  (16)
+
+/// Number of buckets in the latency histogram of each slow path: bucket \a i counts latencies
+/// from 2<sup>i-1</sup> up to 2<sup>i</sup> nano-seconds, and the last bucket all longer ones.
+#define MI_STAT_LATENCY_BUCKETS   (32)
 
 /// Helper to declare a properly initialized mi_stats_t() local variable as \a name
 /// where the \a size and \a version fields are properly initialized.
@@ -1105,6 +1247,15 @@ void mi_stats_print_out(mi_output_fun* out, void* arg);
 /// @return \a true if \a stats is not \a NULL, and if \a stats->size 
 /// and \a stats->version match the `sizeof(mi_stats_t)` and `MI_STAT_VERSION`
 /// with the linked mimalloc version.
+///
+/// When building with `MI_HEAP_PROFILE`, the \a lifetime_bins histograms hold the estimated number of freed
+/// objects per size bin by lifetime (see #MI_STAT_LIFETIME_BUCKETS), based on the samples of the heap profiler
+/// (see mi_heap_profile_set_sample_rate()). The histograms stay zero when the sample rate is 0 (see
+/// #mi_option_heap_profile_rate), and in builds without `MI_HEAP_PROFILE` (where mi_stats_get_json() also leaves them out).
+///
+/// When #mi_option_latency_stats is enabled, the \a latency_bins histograms count how long the slow paths
+/// took (see #MI_STAT_LATENCY_BUCKETS): the generic allocation path, segment allocation and reclaim,
+/// OS allocation and free, commit, decommit, and purging.
 bool mi_stats_get(mi_stats_t* stats);
 
 /// @brief Get the statistics for the current subprocess aggregated over all its heaps as JSON.
@@ -1117,14 +1268,29 @@ char*  mi_stats_get_json(size_t buf_size, char* buf);
 /// @brief __v3__: Return the block size for the given bin.
 size_t  mi_stats_get_bin_size(size_t bin);
 
-/// @brief __v3__: Return statistics for a given heap.
-/// @param heap The heap.
+/// @brief Return statistics for a given heap (also available without `MI_STAT`).
+/// @param heap The heap (or \a NULL for the default heap).
 /// @param stats Pointer to a mi_stats_t() structure (declared as `mi_stats_t_decl(name)`).
 /// @return \a true if \a stats is not \a NULL, and if \a stats->size 
 /// and \a stats->version match the `sizeof(mi_stats_t)` and `MI_STAT_VERSION`
 /// with the linked mimalloc version.
+/// Only the \a pages and \a page_committed statistics have a peak and total. The live bytes are
+/// in \a malloc_normal, \a malloc_huge, and \a malloc_bins, the live block counts in \a malloc_normal_count and
+/// \a malloc_huge_count, and the number of pages per size class in \a page_bins.
+/// Should be called from the thread that owns the heap.
 bool mi_heap_stats_get(mi_heap_t* heap, mi_stats_t* stats);
 
+/// @brief Dump the flight recorder to a file descriptor.
+/// @param fd The file descriptor to write to.
+/// @return \a true if the dump was written completely.
+/// When #mi_option_trace_events is set to N, each thread records its last N allocator events
+/// (like OS commits and decommits, segment allocation, abandonment and reclamation, purging,
+/// arena reservations, slow path allocations, and errors) in a ring buffer. This writes them in a compact
+/// binary format (see `MI_TRACE_VERSION` in `mimalloc-stats.h`) without allocating memory, and is
+/// also called automatically on the first error when #mi_option_trace_dump_on_error is set.
+/// Use `tools/mitrace.c` to decode a dump as text or JSON.
+bool mi_trace_dump(int fd);
+
 /// @brief __v3__: Get the statistics for a heap as JSON.
 /// @param heap The heap.
 /// @param buf_size Byte size of the buffer \a buf (or 0 if \a buf is \a NULL).
@@ -1230,6 +1396,20 @@ typedef enum mi_option_e {
   mi_option_retry_on_oom,             ///< retry on out-of-memory for N milli seconds (=400), set to 0 to disable retries. (only on windows)
   mi_option_generic_collect,          ///< collect heaps every N (=10000) generic allocation calls
   mi_option_allow_thp,                ///< allow transparent huge pages? (=1) (on Android =0 by default). Set to 0 to disable THP for the process.
+  mi_option_page_bump,                ///< allocate fresh blocks in a page with a bump pointer instead of extending the free list (=0)
+  mi_option_remap_threshold,          ///< huge blocks of at least N KiB are allocated in their own remappable area such that a realloc can use `mremap` (=0, disabled) (internally, this value is in KiB; use mi_option_get_size())
+  mi_option_remote_free_buffer,       ///< buffer frees of blocks owned by other threads and publish them per page in batches; can be set per thread with mi_thread_set_remote_free_buffered() (=0)
+  mi_option_cpu_heaps,                ///< threads (other than the main thread) allocate from a shared heap per cpu instead of their own heap, so memory scales with the core count instead of the thread count; only affects threads that did not allocate yet (=0) (Linux x86-64 with glibc 2.35+ only as it needs restartable sequences; ignored with a warning elsewhere)
+  mi_option_commit_limit,             ///< fail to commit memory when the committed memory of the process would go above N KiB; allocation then returns \a NULL (with an \a ENOMEM error) (=0, no limit) (internally, this value is in KiB; use mi_option_get_size())
+  mi_option_commit_soft_limit,        ///< when the committed memory goes above N KiB, the allocator collects and calls the handler registered with mi_register_commit_pressure() (=0, no limit) (internally, this value is in KiB; use mi_option_get_size())
+  mi_option_heap_profile_rate,        ///< only used when building with MI_HEAP_PROFILE: sample one allocation per N KiB allocated for the heap profile (=512, 0 to disable) (see mi_heap_profile_set_sample_rate()) (internally, this value is in KiB; use mi_option_get_size())
+  mi_option_latency_stats,            ///< record latency histograms of slow paths (the generic malloc, segment allocation and reclaim, OS allocation, commit, decommit, and purging) in the statistics (see mi_stats_t) (=0)
+  mi_option_trace_events,             ///< record the last N allocator events (like OS commits, segment allocation, purging, and slow path allocations) of each thread in a flight recorder (=0, disabled) (see mi_trace_dump())
+  mi_option_trace_dump_on_error,      ///< on the first error (like an out-of-memory error), dump the flight recorder to file descriptor N (=0, disabled; use 2 for \a stderr) (see mi_trace_dump())
+  mi_option_purge_thread,             ///< do delayed purges (decommit or reset) on a background thread such that allocating threads do not decommit themselves (=0)
+  mi_option_purge_adaptive,           ///< adapt the purge delay of each segment and arena: lengthen it when purged memory is reused soon after the purge, and shorten it when purged memory stays unused (=0)
+  mi_option_purge_delay_min,          ///< lower bound in milli-seconds of an adaptive purge delay (multiplied by mi_option_arena_purge_mult for arenas) (=1)
+  mi_option_purge_delay_max,          ///< upper bound in milli-seconds of an adaptive purge delay (multiplied by mi_option_arena_purge_mult for arenas) (=1000)
 
   // guard pages
   mi_option_guarded_min,              ///< only used when building with MI_GUARDED: minimal rounded object size for guarded objects (=0)
@@ -1659,6 +1839,16 @@ Advanced options:
    memory on a purge (`MEM_RESET` on Windows, generally `MADV_FREE` (which does not decrease rss immediately) on `mmap` systems).
    Mimalloc generally does not "free" OS memory but only "purges" OS memory, in other words, it tries to keep virtual
    address ranges and decommits within those ranges (to make the underlying physical memory available to other processes).
+- `MIMALLOC_PURGE_THREAD=1`: do delayed purges on a background thread. By default, expired purges are done by the threads
+   that allocate and free which puts the decommit (or reset) calls on their slow paths. When enabled, those threads only
+   schedule a purge and a background thread purges the memory once the `MIMALLOC_PURGE_DELAY` (or the arena purge delay) expires.
+   This is only used when the purge delay is positive, and an explicit `mi_collect(true)` still purges right away.
+   The option can also be enabled at runtime in which case the thread starts on a later allocation. Not available on WASI.
+- `MIMALLOC_PURGE_ADAPTIVE=1`: adapt the purge delay per segment and arena instead of using a fixed `MIMALLOC_PURGE_DELAY`.
+   When purged memory is used again within four times the delay, the delay is doubled (to avoid repeated decommit and commit
+   calls under bursty load), and when purged memory stays unused until the next purge, the delay is shortened by a quarter
+   (to lower the rss sooner after a spike). The delay stays within `MIMALLOC_PURGE_DELAY_MIN` (=1) and `MIMALLOC_PURGE_DELAY_MAX` (=1000)
+   milli-seconds (multiplied by `MIMALLOC_ARENA_PURGE_MULT` for arenas). This is only used when the purge delay is positive.
 
 Further options for large workloads and services:
 
@@ -2018,6 +2208,22 @@ use a tool like [TraceControl] that is specialized for analyzing mimalloc traces
 [ETW]: https://learn.microsoft.com/en-us/windows-hardware/test/wpt/event-tracing-for-windows
 [TraceControl]: https://github.com/xinglonghe/TraceControl
 
+## USDT
+
+On Linux, mimalloc can be built with static tracepoints ([USDT]) for its internal lifecycle events,
+like segment and page allocation, abandonment and reclamation, huge allocations, arena reservation,
+commit, decommit, and purging. The probes have no cost unless a tool attaches to them.
+To build with USDT support, use the `-DMI_USDT=ON` cmake option (this needs the `sys/sdt.h` header
+from the systemtap sdt development package). The probes and their arguments are listed in `include/mimalloc/track.h`.
+
+You can then attach to the probes with tools like `bpftrace` or `perf`. For example,
+to count the fresh pages per size bin:
+```
+> bpftrace -e 'usdt:./libmimalloc.so:mimalloc:page_fresh { @pages[arg2] = count(); }' -c <my_mimalloc_program>
+```
+
+[USDT]: https://docs.kernel.org/trace/uprobetracer.html
+
 */
 
 /*! \page bench Performance
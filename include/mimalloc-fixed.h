@@ -0,0 +1,42 @@
+/* ----------------------------------------------------------------------------
+Copyright (c) 2018-2024 Microsoft Research, Daan Leijen
+This is free software; you can redistribute it and/or modify it under the
+terms of the MIT license. A copy of the license can be found in the file
+"LICENSE" at the root of this distribution.
+-----------------------------------------------------------------------------*/
+#pragma once
+#ifndef MIMALLOC_FIXED_H
+#define MIMALLOC_FIXED_H
+
+// ----------------------------------------------------------------------------
+// This header provides a C++ allocator for objects of a fixed size `N`
+// where the size class is resolved at compile time (see `mi_heap_malloc_sc`).
+// This is useful for node based containers or object pools, for example:
+//
+//   using node_alloc = mi::fixed_alloc<sizeof(node_t)>;
+//   node_t* n = new(node_alloc::allocate()) node_t();
+//   ...
+//   n->~node_t();
+//   node_alloc::deallocate(n);
+// ---------------------------------------------------------------------------
+#if defined(__cplusplus)
+  #include <cstddef>
+  #include <mimalloc.h>
+
+  namespace mi {
+    template<std::size_t N> struct fixed_alloc {
+      static constexpr mi_sizeclass_t sizeclass = MI_SIZECLASS_OF(N);
+      static constexpr std::size_t    size = N;
+
+      static void* allocate() noexcept                 { return mi_malloc_sc(sizeclass); }
+      static void* allocate(mi_heap_t* heap) noexcept  { return mi_heap_malloc_sc(heap, sizeclass); }
+      static void* allocate_zero(mi_heap_t* heap) noexcept { return mi_heap_zalloc_sc(heap, sizeclass); }
+      static void  deallocate(void* p) noexcept        { mi_free_sc(p, sizeclass); }
+    };
+
+    // convenience: a fixed allocator for objects of type `T`
+    template<class T> using fixed_alloc_for = fixed_alloc<sizeof(T)>;
+  }
+#endif
+
+#endif // MIMALLOC_FIXED_H
@@ -11,7 +11,7 @@ terms of the MIT license. A copy of the license can be found in the file
 #include <mimalloc.h>
 #include <stdint.h>
 
-#define MI_STAT_VERSION   4  // increased on every backward incompatible change
+#define MI_STAT_VERSION   6  // increased on every backward incompatible change
 
 // count allocation over time
 typedef struct mi_stat_count_s {
@@ -66,8 +66,24 @@ typedef struct mi_stat_counter_s {
   MI_STAT_COUNTER(pages_unabandon_busy_wait) \
 
 
+// Slow paths with a latency histogram (only recorded when `mi_option_latency_stats` is enabled)
+typedef enum mi_stat_latency_e {
+  mi_latency_malloc_generic,                // `_mi_malloc_generic`: allocation outside the fast path
+  mi_latency_segment_alloc,                 // allocating a fresh segment
+  mi_latency_segment_reclaim,               // trying to reclaim an abandoned segment
+  mi_latency_os_commit,                     // committing OS memory
+  mi_latency_os_decommit,                   // decommitting OS memory
+  mi_latency_os_purge,                      // purging (reset or decommit) OS memory
+  mi_latency_arena_purge,                   // purging expired arena ranges
+  mi_latency_os_alloc,                      // allocating OS memory (`mmap`, `VirtualAlloc`)
+  mi_latency_os_free,                       // freeing OS memory (`munmap`, `VirtualFree`)
+  mi_latency_last
+} mi_stat_latency_t;
+
 // Define the statistics structure
 #define MI_BIN_HUGE             (73U)   // see types.h
+#define MI_STAT_LIFETIME_BUCKETS  (16)  // bucket 0 counts lifetimes below 1ms, bucket `i` from 4^(i-1) up to 4^i ms (and the last bucket all longer ones)
+#define MI_STAT_LATENCY_BUCKETS   (32)  // bucket `i` counts latencies from 2^(i-1) up to 2^i nano-seconds (and the last bucket all longer ones)
 #define MI_STAT_COUNT(stat)     mi_stat_count_t stat;
 #define MI_STAT_COUNTER(stat)   mi_stat_counter_t stat;
 
@@ -85,11 +101,55 @@ typedef struct mi_stats_s
   // size segregated statistics
   mi_stat_count_t   malloc_bins[MI_BIN_HUGE+1];   // allocation per size bin
   mi_stat_count_t   page_bins[MI_BIN_HUGE+1];     // pages allocated per size bin
+  mi_stat_counter_t lifetime_bins[MI_BIN_HUGE+1][MI_STAT_LIFETIME_BUCKETS];  // estimated freed objects per size bin and lifetime (always zero unless built with MI_HEAP_PROFILE and sampling)
+
+  // latency histograms of slow paths
+  mi_stat_counter_t latency_bins[mi_latency_last][MI_STAT_LATENCY_BUCKETS];   // count per slow path and latency (only with `mi_option_latency_stats`)
 } mi_stats_t;
 
 #undef MI_STAT_COUNT
 #undef MI_STAT_COUNTER
 
+
+// Flight recorder (with `mi_option_trace_events`): `mi_trace_dump` writes a `mi_trace_header_t`, and then
+// for each thread a `mi_trace_thread_t` followed by its `count` most recent events (oldest first).
+#define MI_TRACE_VERSION  1   // increased on every change of the dump format
+
+typedef enum mi_trace_kind_e {
+  mi_trace_none,
+  mi_trace_malloc_generic,                  // allocation outside the fast path: size = requested size, arg = size bin
+  mi_trace_segment_alloc,                   // addr = segment, size = segment size, arg = segment kind (0 = normal, 1 = huge)
+  mi_trace_segment_abandon,                 // addr = segment, size = segment size, arg = pages in use
+  mi_trace_segment_reclaim,                 // addr = segment, size = segment size, arg = pages in use
+  mi_trace_arena_reserve,                   // addr = arena start, size = arena size, arg = arena id
+  mi_trace_arena_purge,                     // addr = start, size = purged size, arg = arena id
+  mi_trace_os_commit,                       // addr = start, size = committed size
+  mi_trace_os_decommit,                     // addr = start, size = decommitted size
+  mi_trace_os_purge,                        // addr = start, size = purged size, arg = 1 if it was decommitted
+  mi_trace_error,                           // arg = error code (like ENOMEM)
+  mi_trace_last
+} mi_trace_kind_t;
+
+typedef struct mi_trace_event_s {
+  int64_t  time;                            // monotonic time in nano-seconds
+  uint64_t addr;
+  uint64_t size;
+  uint32_t kind;                            // a `mi_trace_kind_t`
+  uint32_t arg;
+} mi_trace_event_t;
+
+typedef struct mi_trace_header_s {
+  char     magic[8];                        // "mi-trace"
+  uint32_t version;                         // `MI_TRACE_VERSION`
+  uint32_t event_size;                      // `sizeof(mi_trace_event_t)`
+  int64_t  time;                            // time of the dump (on the same clock as the events)
+} mi_trace_header_t;
+
+typedef struct mi_trace_thread_s {
+  uint64_t thread_id;                       // the (last) thread that recorded these events (or 0 for uninitialized threads)
+  uint64_t count;                           // the number of events that follow
+} mi_trace_thread_t;
+
 // helper
 #define mi_stats_t_decl(name)  mi_stats_t name = { 0 }; name.size = sizeof(mi_stats_t); name.version = MI_STAT_VERSION;
 
@@ -101,6 +161,14 @@ extern "C" {
 mi_decl_export bool  mi_stats_get( mi_stats_t* stats ) mi_attr_noexcept;
 mi_decl_export char* mi_stats_get_json( size_t buf_size, char* buf ) mi_attr_noexcept;    // use mi_free to free the result if the input buf == NULL
 
+// Statistics of a single heap (also available without MI_STAT): only `pages` and `page_committed` have a peak and total.
+// The live bytes are in `malloc_normal`, `malloc_huge`, and `malloc_bins`, the live block counts in `malloc_normal_count`
+// and `malloc_huge_count`, and the pages per size bin in `page_bins`. Should be called by the thread that owns the heap.
+mi_decl_export bool  mi_heap_stats_get( mi_heap_t* heap, mi_stats_t* stats ) mi_attr_noexcept;
+
+// Write the events of the flight recorder to the file descriptor `fd` (see `MI_TRACE_VERSION`). Does not allocate.
+mi_decl_export bool  mi_trace_dump( int fd ) mi_attr_noexcept;
+
 #ifdef __cplusplus
 }
 #endif
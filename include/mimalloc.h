@@ -225,6 +225,28 @@ mi_decl_nodiscard mi_decl_export mi_decl_restrict void* mi_heap_mallocn(mi_heap_
 mi_decl_nodiscard mi_decl_export mi_decl_restrict void* mi_heap_malloc_small(mi_heap_t* heap, size_t size) mi_attr_noexcept mi_attr_malloc mi_attr_alloc_size(2);
 mi_decl_nodiscard mi_decl_export mi_decl_restrict void* mi_heap_zalloc_small(mi_heap_t* heap, size_t size) mi_attr_noexcept mi_attr_malloc mi_attr_alloc_size(2);
 
+// Allocate `count` blocks of `size` bytes into `out` at once.
+// Returns the number of blocks allocated (which is only less than `count` on out-of-memory).
+mi_decl_export size_t mi_heap_malloc_batch(mi_heap_t* heap, size_t size, size_t count, void** out) mi_attr_noexcept;
+mi_decl_export size_t mi_heap_zalloc_batch(mi_heap_t* heap, size_t size, size_t count, void** out) mi_attr_noexcept;
+mi_decl_export size_t mi_malloc_batch(size_t size, size_t count, void** out) mi_attr_noexcept;
+mi_decl_export size_t mi_zalloc_batch(size_t size, size_t count, void** out) mi_attr_noexcept;
+
+// Free an array of `count` pointers (that may be NULL); most efficient if the pointers are grouped by page.
+mi_decl_export void   mi_free_batch(void** ps, size_t count) mi_attr_noexcept;
+
+// Size classes: compute the size class of a (constant) size once, and allocate
+// from it without any size-to-bin computation on the fast path.
+// A size class is opaque; use `mi_sizeclass_of` or `MI_SIZECLASS_OF` (for compile-time constants).
+typedef size_t mi_sizeclass_t;
+#define MI_SIZECLASS_OF(size)  ((mi_sizeclass_t)((size)==0 ? 1 : ((size) + sizeof(void*) - 1) / sizeof(void*)))
+
+mi_decl_nodiscard mi_decl_export mi_sizeclass_t mi_sizeclass_of(size_t size) mi_attr_noexcept;
+mi_decl_nodiscard mi_decl_export mi_decl_restrict void* mi_heap_malloc_sc(mi_heap_t* heap, mi_sizeclass_t sc) mi_attr_noexcept mi_attr_malloc;
+mi_decl_nodiscard mi_decl_export mi_decl_restrict void* mi_heap_zalloc_sc(mi_heap_t* heap, mi_sizeclass_t sc) mi_attr_noexcept mi_attr_malloc;
+mi_decl_nodiscard mi_decl_export mi_decl_restrict void* mi_malloc_sc(mi_sizeclass_t sc) mi_attr_noexcept mi_attr_malloc;
+mi_decl_export void mi_free_sc(void* p, mi_sizeclass_t sc) mi_attr_noexcept;
+
 mi_decl_nodiscard mi_decl_export void* mi_heap_realloc(mi_heap_t* heap, void* p, size_t newsize)              mi_attr_noexcept mi_attr_alloc_size(3);
 mi_decl_nodiscard mi_decl_export void* mi_heap_reallocn(mi_heap_t* heap, void* p, size_t count, size_t size)  mi_attr_noexcept mi_attr_alloc_size2(3,4);
 mi_decl_nodiscard mi_decl_export void* mi_heap_reallocf(mi_heap_t* heap, void* p, size_t newsize)             mi_attr_noexcept mi_attr_alloc_size(3);
@@ -333,17 +355,77 @@ mi_decl_export bool mi_abandoned_visit_blocks(mi_subproc_id_t subproc_id, int he
 mi_decl_export void mi_heap_guarded_set_sample_rate(mi_heap_t* heap, size_t sample_rate, size_t seed);
 mi_decl_export void mi_heap_guarded_set_size_bound(mi_heap_t* heap, size_t min, size_t max);
 
+// Experimental: sampling heap profiler (only when building with `MI_HEAP_PROFILE=ON`). About one allocation per `sample_rate`
+// allocated bytes is sampled (0 disables sampling) and its call stack is recorded until it is freed. `mi_heap_profile_print_out`
+// outputs the estimated live or total allocated bytes per call stack (since the last `mi_heap_profile_reset`).
+// `mi_heap_destroy` forgets the samples of its objects, except in guarded (and thus debug) builds where it is `mi_heap_delete`
+// and the objects (and their samples) stay live.
+typedef enum mi_heap_profile_format_e {
+  mi_heap_profile_pprof,            // heap profile (`heap_v2`) format of gperftools that can be read by `pprof`
+  mi_heap_profile_collapsed_live,   // collapsed stacks (for flame graphs) with the estimated live bytes
+  mi_heap_profile_collapsed_alloc   // collapsed stacks with the estimated total allocated bytes
+} mi_heap_profile_format_t;
+mi_decl_export void mi_heap_profile_set_sample_rate(mi_heap_t* heap, size_t sample_rate);
+mi_decl_export void mi_heap_profile_print_out(mi_heap_profile_format_t format, mi_output_fun* out, void* arg) mi_attr_noexcept;
+mi_decl_export void mi_heap_profile_reset(void) mi_attr_noexcept;
+
 // Experimental: communicate that the thread is part of a threadpool
 mi_decl_export void mi_thread_set_in_threadpool(void) mi_attr_noexcept;
 
+// Experimental: buffer frees of blocks owned by other threads and publish them per page in batches
+// (overrides `mi_option_remote_free_buffer` for the current thread; disabling publishes any buffered frees)
+mi_decl_export void mi_thread_set_remote_free_buffered(bool enable) mi_attr_noexcept;
+
+// Experimental: numa bound heaps. A heap created by `mi_heap_new_on_numa` only allocates (and reclaims) memory
+// at the given numa node; `mi_thread_set_numa_node` binds all heaps of the current thread (use -1 to unbind).
+// Both fail (with EINVAL) if the node is not below the numa node count.
+mi_decl_nodiscard mi_decl_export mi_heap_t* mi_heap_new_on_numa(int numa_node);
+mi_decl_export bool mi_thread_set_numa_node(int numa_node) mi_attr_noexcept;
+
+// Experimental: transparent huge page policy of a heap: 1 = back its segments with huge OS pages,
+// 0 = avoid huge OS pages, -1 = use the process default. Only affects memory allocated after the call.
+mi_decl_export void mi_heap_set_thp(mi_heap_t* heap, int thp);
+
+// Experimental: soft and hard limits on the total size of the pages of a heap (use 0 for no limit), and a handler that is called
+// after collecting when a heap (`heap != NULL`), or the process (see `mi_option_commit_soft_limit`), goes above its soft limit.
+mi_decl_export void mi_heap_set_commit_limit(mi_heap_t* heap, size_t soft_limit, size_t limit);
+typedef void (mi_cdecl mi_commit_pressure_fun)(mi_heap_t* heap, size_t committed, size_t limit, void* arg);
+mi_decl_export void mi_register_commit_pressure(mi_commit_pressure_fun* fun, void* arg) mi_attr_noexcept;
+
 // Experimental: create a new heap with a specified heap tag. Set `allow_destroy` to false to allow the thread
 // to reclaim abandoned memory (with a compatible heap_tag and arena_id) but in that case `mi_heap_destroy` will
 // fall back to `mi_heap_delete`.
 mi_decl_nodiscard mi_decl_export mi_heap_t* mi_heap_new_ex(int heap_tag, bool allow_destroy, mi_arena_id_t arena_id);
 
+// Experimental: create a monotonic heap that only bump allocates in large chunks. Freeing an object in
+// a monotonic heap is a no-op and all memory is released at once with `mi_heap_destroy` (or `mi_heap_delete`).
+// Note: `mi_usable_size` of an object may extend up to the end of its chunk.
+mi_decl_nodiscard mi_decl_export mi_heap_t* mi_heap_new_monotonic(void);
+
+// Experimental: object caches. An object cache allocates objects of a fixed size from its own heap with
+// a `heap_tag` (>0) (so its pages are not reclaimed by the default heap). The constructor runs once when an object's block is first carved from a page,
+// and the destructor only runs when the page is returned to its segment (or when the cache is deleted).
+// Freed objects therefore stay constructed and are returned as-is by a later `mi_objcache_alloc`.
+// Like a heap, a cache can only allocate from the thread that created it but objects can be freed
+// from any thread (using `mi_objcache_free`). The constructor should not allocate from the same cache.
+typedef struct mi_objcache_s mi_objcache_t;
+typedef void (mi_cdecl mi_objcache_fun)(void* obj, void* arg);
+mi_decl_nodiscard mi_decl_export mi_objcache_t* mi_objcache_new(int heap_tag, size_t size, mi_objcache_fun* ctor, mi_objcache_fun* dtor, void* arg);
+mi_decl_export void  mi_objcache_delete(mi_objcache_t* oc);   // destructs all objects (also the ones still in use)
+mi_decl_nodiscard mi_decl_export mi_decl_restrict void* mi_objcache_alloc(mi_objcache_t* oc) mi_attr_noexcept mi_attr_malloc;
+mi_decl_export void  mi_objcache_free(mi_objcache_t* oc, void* p) mi_attr_noexcept;
+
 // Experimental and unsafe: assumes the page of `p` is only accessed by the calling thread
 mi_decl_nodiscard mi_decl_export bool mi_unsafe_heap_page_is_under_utilized(mi_heap_t* heap, void* p, size_t perc_threshold) mi_attr_noexcept;
 
+// Experimental: defragmentation. `mi_heap_defrag_begin` marks the pages with at most `perc_threshold` percent used blocks
+// as sparse (and returns their count); no allocations are made in sparse pages until `mi_heap_defrag_end`.
+// Objects for which `mi_defrag_should_move` returns `true` should be reallocated (and the old block freed) by the program.
+// These functions should only be called by the thread that owns the heap.
+mi_decl_export size_t mi_heap_defrag_begin(mi_heap_t* heap, size_t perc_threshold) mi_attr_noexcept;
+mi_decl_export void   mi_heap_defrag_end(mi_heap_t* heap) mi_attr_noexcept;
+mi_decl_nodiscard mi_decl_export bool mi_defrag_should_move(const void* p) mi_attr_noexcept;
+
 // deprecated
 mi_decl_export int mi_reserve_huge_os_pages(size_t pages, double max_secs, size_t* pages_reserved) mi_attr_noexcept;
 mi_decl_export void mi_collect_reduce(size_t target_thread_owned) mi_attr_noexcept;
@@ -431,6 +513,20 @@ typedef enum mi_option_e {
   mi_option_target_segments_per_thread, // experimental (=0)
   mi_option_generic_collect,            // collect heaps every N (=10000) generic allocation calls
   mi_option_allow_thp,                  // allow transparent huge pages? (=1) (on Android =0 by default). Set to 0 to disable THP for the process.
+  mi_option_page_bump,                  // allocate fresh blocks in a page with a bump pointer instead of extending the free list (=0)
+  mi_option_remap_threshold,            // huge blocks of at least N KiB are allocated in their own remappable area such that a realloc can use `mremap` (=0, disabled)
+  mi_option_remote_free_buffer,         // buffer frees of blocks owned by other threads and publish them per page in batches (=0)
+  mi_option_cpu_heaps,                  // threads allocate from per-cpu heaps instead of their own thread local heap; only affects threads that did not allocate yet (=0) (Linux x86-64 with glibc 2.35+ only as it needs restartable sequences; ignored with a warning elsewhere)
+  mi_option_commit_limit,               // fail to commit memory above N KiB committed memory in the process (=0, no limit)
+  mi_option_commit_soft_limit,          // collect and call the commit pressure handler when the process commits more than N KiB (=0, no limit)
+  mi_option_heap_profile_rate,          // only used when building with MI_HEAP_PROFILE: sample one allocation per N KiB allocated bytes for the heap profile (=512, 0 to disable)
+  mi_option_latency_stats,              // record latency histograms of slow paths like the generic malloc, OS calls, and purging in the statistics (=0)
+  mi_option_trace_events,               // record the last N allocator events of each thread in a flight recorder (=0, disabled)
+  mi_option_trace_dump_on_error,        // dump the flight recorder to file descriptor N on the first error (like out-of-memory) (=0, disabled)
+  mi_option_purge_thread,               // do delayed purges on a background thread instead of on the allocating threads (=0)
+  mi_option_purge_adaptive,             // adapt the purge delay per segment and arena to how soon purged memory is reused (=0)
+  mi_option_purge_delay_min,            // lower bound of an adaptive purge delay in milli-seconds (=1)
+  mi_option_purge_delay_max,            // upper bound of an adaptive purge delay in milli-seconds (=1000)
   _mi_option_last,
   // legacy option names
   mi_option_large_os_pages = mi_option_allow_large_os_pages,
@@ -135,7 +135,9 @@ static inline uintptr_t _mi_random_shuffle(uintptr_t x);
 
 // init.c
 extern mi_decl_hidden mi_decl_cache_align mi_stats_t       _mi_stats_main;
+extern mi_decl_hidden mi_stats_lite_t                      _mi_stats_lite_main;
 extern mi_decl_hidden mi_decl_cache_align const mi_page_t  _mi_page_empty;
+extern mi_decl_hidden bool                                  _mi_cpu_heaps_active;
 void        _mi_auto_process_init(void);
 void mi_cdecl _mi_auto_process_done(void) mi_attr_noexcept;
 bool        _mi_is_redirected(void);
@@ -149,6 +151,11 @@ void        _mi_thread_data_collect(void);
 void        _mi_tld_init(mi_tld_t* tld, mi_heap_t* bheap);
 mi_threadid_t _mi_thread_id(void) mi_attr_noexcept;
 mi_heap_t*    _mi_heap_main_get(void);     // statically allocated main backing heap
+bool        _mi_cpu_heaps_enabled(void);
+void        _mi_cpu_heaps_option_changed(bool enable);
+mi_heap_t*  _mi_cpu_heap_acquire(void);
+mi_heap_t*  _mi_cpu_heap_try_acquire_owner(mi_threadid_t owner);
+void        _mi_cpu_heap_release(mi_heap_t* heap);
 mi_subproc_t* _mi_subproc_from_id(mi_subproc_id_t subproc_id);
 void        _mi_heap_guarded_init(mi_heap_t* heap);
 
@@ -163,6 +170,7 @@ size_t      _mi_os_page_size(void);
 size_t      _mi_os_good_alloc_size(size_t size);
 bool        _mi_os_has_overcommit(void);
 bool        _mi_os_has_virtual_reserve(void);
+bool        _mi_os_has_remap(void);
 
 bool        _mi_os_reset(void* addr, size_t size);
 bool        _mi_os_decommit(void* addr, size_t size);
@@ -176,6 +184,8 @@ bool        _mi_os_protect(void* addr, size_t size);
 
 void*       _mi_os_alloc_aligned(size_t size, size_t alignment, bool commit, bool allow_large, mi_memid_t* memid);
 void*       _mi_os_alloc_aligned_at_offset(size_t size, size_t alignment, size_t align_offset, bool commit, bool allow_large, mi_memid_t* memid);
+void*       _mi_os_alloc_remappable(size_t size, size_t alignment, mi_memid_t* memid);
+void*       _mi_os_remap(void* p, size_t size, size_t newsize, size_t alignment, mi_memid_t* memid);
 
 void*       _mi_os_get_aligned_hint(size_t try_alignment, size_t size);
 bool        _mi_os_canuse_large_page(size_t size, size_t alignment);
@@ -184,15 +194,24 @@ void*       _mi_os_alloc_huge_os_pages(size_t pages, int numa_node, mi_msecs_t m
 
 int         _mi_os_numa_node_count(void);
 int         _mi_os_numa_node(void);
+bool        _mi_os_numa_bind(void* addr, size_t size, int numa_node);
+void        _mi_os_numa_unbind(void* addr, size_t size);
+bool        _mi_os_set_thp(void* addr, size_t size, bool enable);
+void        _mi_os_reset_thp(void* addr, size_t size);
+bool        _mi_os_has_commit_pressure(void);
+bool        _mi_os_commit_pressure_clear(void);
 
 // arena.c
 mi_arena_id_t _mi_arena_id_none(void);
 void        _mi_arena_free(void* p, size_t size, size_t still_committed_size, mi_memid_t memid);
 void*       _mi_arena_alloc(size_t size, bool commit, bool allow_large, mi_arena_id_t req_arena_id, mi_memid_t* memid);
-void*       _mi_arena_alloc_aligned(size_t size, size_t alignment, size_t align_offset, bool commit, bool allow_large, mi_arena_id_t req_arena_id, mi_memid_t* memid);
+void*       _mi_arena_alloc_aligned(size_t size, size_t alignment, size_t align_offset, bool commit, bool allow_large, mi_arena_id_t req_arena_id, int req_numa_node, mi_memid_t* memid);
 bool        _mi_arena_memid_is_suitable(mi_memid_t memid, mi_arena_id_t request_arena_id);
+int         _mi_arena_memid_numa_node(mi_memid_t memid);
+bool        _mi_arena_memid_is_os_backed(mi_memid_t memid);
 bool        _mi_arena_contains(const void* p);
 void        _mi_arenas_collect(bool force_purge);
+mi_msecs_t  _mi_arenas_purge_expired(void);
 void        _mi_arena_unsafe_destroy_all(void);
 
 bool        _mi_arena_segment_clear_abandoned(mi_segment_t* segment);
@@ -225,12 +244,16 @@ void       _mi_segment_page_free(mi_page_t* page, bool force, mi_segments_tld_t*
 void       _mi_segment_page_abandon(mi_page_t* page, mi_segments_tld_t* tld);
 bool       _mi_segment_try_reclaim_abandoned( mi_heap_t* heap, bool try_all, mi_segments_tld_t* tld);
 void       _mi_segment_collect(mi_segment_t* segment, bool force);
+mi_msecs_t _mi_segment_purge_expired(mi_segment_t* segment);
+bool       _mi_segment_large_page_resize(mi_page_t* page, size_t block_size, mi_segments_tld_t* tld);
 
 #if MI_HUGE_PAGE_ABANDON
 void        _mi_segment_huge_page_free(mi_segment_t* segment, mi_page_t* page, mi_block_t* block);
 #else
 void        _mi_segment_huge_page_reset(mi_segment_t* segment, mi_page_t* page, mi_block_t* block);
 #endif
+bool        _mi_segment_huge_page_resize(mi_page_t* page, size_t block_size, mi_segments_tld_t* tld);
+mi_page_t*  _mi_segment_huge_page_remap(mi_page_t* page, size_t block_size, mi_segments_tld_t* tld);
 
 uint8_t*   _mi_segment_page_start(const mi_segment_t* segment, const mi_page_t* page, size_t* page_size); // page start for any page
 void       _mi_abandoned_reclaim_all(mi_heap_t* heap, mi_segments_tld_t* tld);
@@ -243,6 +266,10 @@ void*       _mi_malloc_generic(mi_heap_t* heap, size_t size, bool zero, size_t h
 
 void        _mi_page_retire(mi_page_t* page) mi_attr_noexcept;                  // free the page if there are no other pages with many free blocks
 void        _mi_page_unfull(mi_page_t* page);
+void        _mi_page_to_full(mi_page_t* page);
+void        _mi_page_set_sparse(mi_page_t* page, bool sparse);
+size_t      _mi_page_monotonic_usable_size(const mi_page_t* page, const void* p);
+mi_page_t*  _mi_page_huge_remap(mi_page_t* page, size_t block_size);
 void        _mi_page_free(mi_page_t* page, mi_page_queue_t* pq, bool force);   // free the page
 void        _mi_page_abandon(mi_page_t* page, mi_page_queue_t* pq);            // abandon the page, to be picked up by another thread...
 void        _mi_page_force_abandon(mi_page_t* page);
@@ -269,17 +296,51 @@ void        _mi_heap_destroy_pages(mi_heap_t* heap);
 void        _mi_heap_collect_abandon(mi_heap_t* heap);
 void        _mi_heap_set_default_direct(mi_heap_t* heap);
 bool        _mi_heap_memid_is_suitable(mi_heap_t* heap, mi_memid_t memid);
+int         _mi_heap_numa_node(mi_heap_t* heap);
 void        _mi_heap_unsafe_destroy_all(mi_heap_t* heap);
 mi_heap_t*  _mi_heap_by_tag(mi_heap_t* heap, uint8_t tag);
 void        _mi_heap_area_init(mi_heap_area_t* area, mi_page_t* page);
 bool        _mi_heap_area_visit_blocks(const mi_heap_area_t* area, mi_page_t* page, mi_block_visit_fun* visitor, void* arg);
 
+// "objcache.c"
+void        _mi_objcache_page_carve(mi_page_t* page, size_t start, size_t count);  // construct freshly carved blocks
+void        _mi_objcache_page_free(mi_page_t* page);                               // destruct all carved blocks
+
+// "profile.c"
+void        _mi_heap_profile_init(mi_heap_t* heap);
+void        _mi_heap_profile_process_init(void);
+void        _mi_heap_profile_sample(mi_heap_t* heap, mi_page_t* page, mi_block_t* block, size_t size);  // sample an allocated block
+void        _mi_heap_profile_free(const mi_block_t* block);                                            // called on free of a block in a `has_sampled` page
+void        _mi_heap_profile_move(const mi_block_t* block, const mi_block_t* newblock);                // a sampled block moved (on a huge remap)
+void        _mi_heap_profile_page_destroy(const mi_page_t* page);                                      // forget all samples in a page (on `mi_heap_destroy`)
+
+// "trace.c"
+void        _mi_trace_record(mi_trace_kind_t kind, const void* p, size_t size, size_t arg);  // record an event in the flight recorder of this thread
+void        _mi_trace_release(mi_tld_t* tld);                                                 // release the flight recorder of a terminated thread
+void        _mi_trace_error(int err);                                                         // record an error (and dump the flight recorder if `mi_option_trace_dump_on_error` is set)
+
+// "purge.c"
+void        _mi_purge_thread_maybe_start(void);                         // start the purge thread if enabled (called from the generic malloc)
+void        _mi_purge_thread_done(void);                                // stop the purge thread (called from `mi_process_done`)
+bool        _mi_purge_thread_is_running(void);
+void        _mi_purge_thread_wakeup(mi_msecs_t expire);                 // a purge was scheduled that expires at `expire`
+void        _mi_purge_segment_post(mi_segment_t* segment, mi_msecs_t expire);  // post a segment with scheduled purges to the purge thread
+void        _mi_purge_segment_remove(mi_segment_t* segment);            // called before a posted segment is freed
+bool        _mi_purge_is_adaptive(void);                                // is `mi_option_purge_adaptive` in effect?
+bool        _mi_purge_reused_soon(mi_msecs_t purged_at, mi_msecs_t delay);     // is memory purged at `purged_at` reused soon (for an adaptive purge delay)?
+mi_msecs_t  _mi_purge_delay_adapt(mi_msecs_t delay, bool reused, long mult);  // lengthen (if `reused`) or shorten an adaptive purge delay
+
 // "stats.c"
 void        _mi_stats_done(mi_stats_t* stats);
 void        _mi_stats_merge_thread(mi_tld_t* tld);
+mi_stats_lite_t* _mi_stats_lite_claim(void);
+void        _mi_stats_lite_release(mi_stats_lite_t* stats);
+void        _mi_stats_lite_free_shared(size_t bsize, bool is_huge);
 mi_msecs_t  _mi_clock_now(void);
 mi_msecs_t  _mi_clock_end(mi_msecs_t start);
 mi_msecs_t  _mi_clock_start(void);
+mi_nsecs_t  _mi_clock_nsecs(void);
+void        _mi_stat_latency_record(mi_stats_t* stats, mi_stat_latency_t event, mi_nsecs_t start);
 
 // "alloc.c"
 void*       _mi_page_malloc_zero(mi_heap_t* heap, mi_page_t* page, size_t size, bool zero, size_t* usable) mi_attr_noexcept;  // called from `_mi_malloc_generic`
@@ -288,8 +349,10 @@ void*       _mi_page_malloc_zeroed(mi_heap_t* heap, mi_page_t* page, size_t size
 void*       _mi_heap_malloc_zero(mi_heap_t* heap, size_t size, bool zero) mi_attr_noexcept;
 void*       _mi_heap_malloc_zero_ex(mi_heap_t* heap, size_t size, bool zero, size_t huge_alignment, size_t* usable) mi_attr_noexcept;     // called from `_mi_heap_malloc_aligned`
 void*       _mi_heap_realloc_zero(mi_heap_t* heap, void* p, size_t newsize, bool zero, size_t* usable_pre, size_t* usable_post) mi_attr_noexcept;
+void*       _mi_cpu_heap_malloc(size_t size, bool zero, size_t huge_alignment, size_t* usable) mi_attr_noexcept;  // called from `_mi_malloc_generic`
 mi_block_t* _mi_page_ptr_unalign(const mi_page_t* page, const void* p);
 bool        _mi_free_delayed_block(mi_block_t* block);
+void        _mi_free_remote_flush(mi_tld_t* tld);
 void        _mi_free_generic(mi_segment_t* segment, mi_page_t* page, bool is_local, void* p) mi_attr_noexcept;  // for runtime integration
 void        _mi_padding_shrink(const mi_page_t* page, const mi_block_t* block, const size_t min_size);
 
@@ -505,6 +568,11 @@ static inline bool mi_heap_is_initialized(mi_heap_t* heap) {
   return (heap != NULL && heap != &_mi_heap_empty);
 }
 
+// Is this a heap shared by the threads on a cpu? (see `init.c:_mi_cpu_heap_acquire`)
+static inline bool _mi_heap_is_per_cpu(const mi_heap_t* heap) {
+  return (heap->thread_id == (mi_threadid_t)heap);
+}
+
 static inline uintptr_t _mi_ptr_cookie(const void* p) {
   extern mi_decl_hidden mi_heap_t _mi_heap_main;
   mi_assert_internal(_mi_heap_main.cookie != 0);
@@ -601,6 +669,11 @@ static inline bool mi_page_is_huge(const mi_page_t* page) {
   return page->is_huge;
 }
 
+// Do the blocks in this page belong to an object cache? (and stay constructed when free, see `objcache.c`)
+static inline bool mi_page_is_objcache(const mi_page_t* page) {
+  return (page->objcache != NULL);
+}
+
 // Get the usable block size of a page without fixed padding.
 // This may still include internal padding due to alignment and rounding up size classes.
 static inline size_t mi_page_usable_block_size(const mi_page_t* page) {
@@ -711,6 +784,27 @@ static inline void mi_page_set_has_aligned(mi_page_t* page, bool has_aligned) {
   page->flags.x.has_aligned = has_aligned;
 }
 
+// Does the page hold chunks of a monotonic heap? (in which case `mi_free` is a no-op)
+static inline bool mi_page_is_monotonic(const mi_page_t* page) {
+  return page->flags.x.is_monotonic;
+}
+
+// A monotonic chunk starts with a bitmap with a bit per `MI_MAX_ALIGN_SIZE` unit of the chunk
+// that is set at each object boundary (so `mi_usable_size` can find the end of an object).
+static inline void mi_monotonic_mark(uint8_t* chunk, const uint8_t* p) {
+  const size_t i = (size_t)(p - chunk) / MI_MAX_ALIGN_SIZE;
+  ((size_t*)chunk)[i / MI_SIZE_BITS] |= ((size_t)1 << (i % MI_SIZE_BITS));
+}
+
+// Does the page contain blocks sampled by the heap profiler? (so `mi_free` needs to check if the block is sampled)
+static inline bool mi_page_has_sampled(const mi_page_t* page) {
+  return page->flags.x.has_sampled;
+}
+
+static inline void mi_page_set_has_sampled(mi_page_t* page, bool has_sampled) {
+  page->flags.x.has_sampled = has_sampled;
+}
+
 /* -------------------------------------------------------------------
   Guarded objects
 ------------------------------------------------------------------- */
@@ -749,6 +843,52 @@ mi_decl_restrict void* _mi_heap_malloc_guarded(mi_heap_t* heap, size_t size, boo
 
 #endif
 
+/* -------------------------------------------------------------------
+  Heap profiling
+------------------------------------------------------------------- */
+
+// Count down the allocated bytes and take a sample of `block` once we go below zero.
+static inline void mi_heap_profile_count(mi_heap_t* heap, mi_page_t* page, mi_block_t* block, size_t size) {
+  MI_UNUSED(heap); MI_UNUSED(page); MI_UNUSED(block); MI_UNUSED(size);
+  #if MI_HEAP_PROFILE
+  // this code is written to result in fast assembly as it is on the hot path for allocation
+  const ptrdiff_t count = heap->profile_countdown - (ptrdiff_t)size;  // if the rate is 0, the count starts at PTRDIFF_MAX and is reset on each sample
+  heap->profile_countdown = count;
+  if mi_unlikely(count < 0) {
+    _mi_heap_profile_sample(heap, page, block, size);
+  }
+  #endif
+}
+
+
+/* -------------------------------------------------------------------
+  Latency statistics of slow paths
+------------------------------------------------------------------- */
+
+// Start timing a slow path; returns 0 (and takes no timestamp) if `mi_option_latency_stats` is not enabled.
+static inline mi_nsecs_t mi_stat_latency_start(void) {
+  return (mi_likely(_mi_option_get_fast(mi_option_latency_stats) == 0) ? 0 : _mi_clock_nsecs());
+}
+
+// Record the elapsed time since `start` in the latency histogram of `event` (if timing was started)
+static inline void mi_stat_latency_end(mi_stats_t* stats, mi_stat_latency_t event, mi_nsecs_t start) {
+  if mi_unlikely(start != 0) {
+    _mi_stat_latency_record(stats, event, start);
+  }
+}
+
+
+/* -------------------------------------------------------------------
+  Flight recorder
+------------------------------------------------------------------- */
+
+// Record an allocator event (if `mi_option_trace_events` is enabled)
+static inline void mi_trace_record(mi_trace_kind_t kind, const void* p, size_t size, size_t arg) {
+  if mi_unlikely(_mi_option_get_fast(mi_option_trace_events) != 0) {
+    _mi_trace_record(kind, p, size, arg);
+  }
+}
+
 
 /* -------------------------------------------------------------------
 Encoding/Decoding the free list next pointers
@@ -30,6 +30,7 @@ typedef struct mi_os_mem_config_s {
   bool    has_overcommit;         // can we reserve more memory than can be actually committed?
   bool    has_partial_free;       // can allocated blocks be freed partially? (true for mmap, false for VirtualAlloc)
   bool    has_virtual_reserve;    // supports virtual address space reservation? (if true we can reserve virtual address space without using commit or physical memory)
+  bool    has_remap;              // can committed memory be moved to another address and resized? (e.g. using `mremap` on Linux)
 } mi_os_mem_config_t;
 
 // Initialize
@@ -71,6 +72,15 @@ int _mi_prim_reuse(void* addr, size_t size);
 // Protect memory. Returns error code or 0 on success.
 int _mi_prim_protect(void* addr, size_t size, bool protect);
 
+// Move the committed range `addr` of `size` bytes to `newaddr` and resize it to `newsize` bytes
+// (where any extension is zero initialized). The range at `newaddr` is reserved by the caller and is replaced.
+// Returns error code or 0 on success. Only called if `has_remap` is true.
+int _mi_prim_remap(void* addr, size_t size, void* newaddr, size_t newsize);
+
+// Advise the OS to back the range `addr` of `size` bytes with transparent huge pages (if `enable`), or to never do so.
+// Returns error code or 0 on success (or `ENOSYS` if not supported).
+int _mi_prim_set_thp(void* addr, size_t size, bool enable);
+
 // Allocate huge (1GiB) pages possibly associated with a NUMA node.
 // `is_zero` is set to true if the memory was zero initialized (as on most OS's)
 // pre: size > 0  and a multiple of 1GiB.
@@ -83,9 +93,39 @@ size_t _mi_prim_numa_node(void);
 // Return the number of logical NUMA nodes
 size_t _mi_prim_numa_node_count(void);
 
+// Prefer to allocate the physical pages of the range `addr` of `size` bytes at the given NUMA node
+// (or use the default policy again if `numa_node < 0`).
+// Returns error code or 0 on success (or `ENOSYS` if not supported).
+int _mi_prim_numa_bind(void* addr, size_t size, int numa_node);
+
+// Return the cpu the current thread runs on (or -1 if unknown).
+// This is called on every allocation with per-cpu heaps so it should be fast.
+int _mi_prim_cpu_id(void);
+
+// Return the number of possible cpu's (or 0 if unknown).
+size_t _mi_prim_cpu_count(void);
+
+// Set `*claim` from 0 to 1 in a restartable sequence that only commits if the current thread
+// still runs on `cpu`. This needs no atomic operation as long as the claim is only ever
+// set by threads running on `cpu` (it can be cleared from any cpu with a release store).
+// Returns 1 on success, 0 if it was already claimed (or we were preempted or migrated),
+// or -1 if restartable sequences are not supported.
+int _mi_prim_cpu_claim(_Atomic(uintptr_t)* claim, int cpu);
+
+// Capture the return addresses of the current call stack into `frames` (innermost first),
+// skipping the frame of this function itself and `skip` further frames.
+// Returns the number of frames captured (or 0 if not supported). (only for heap profiling)
+size_t _mi_prim_stack_trace(void** frames, size_t max_frames, size_t skip);
+
+// Output the memory mappings of the process in the `/proc/self/maps` format. (only for heap profiling)
+void _mi_prim_out_mappings(mi_output_fun* out, void* arg);
+
 // Clock ticks
 mi_msecs_t _mi_prim_clock_now(void);
 
+// High resolution monotonic clock in nano-seconds (only for latency statistics).
+mi_nsecs_t _mi_prim_clock_nsecs(void);
+
 // Return process information (only for statistics)
 typedef struct mi_process_info_s {
   mi_msecs_t  elapsed;
@@ -104,6 +144,9 @@ void _mi_prim_process_info(mi_process_info_t* pinfo);
 // msg != NULL && _mi_strlen(msg) > 0
 void _mi_prim_out_stderr( const char* msg );
 
+// Write `size` bytes to the file descriptor `fd` (retrying on partial writes). (only for the flight recorder)
+bool _mi_prim_write(int fd, const void* buf, size_t size);
+
 // Get an environment variable. (only for options)
 // name != NULL, result != NULL, result_size >= 64
 // Return 1 for success, 0 if not found,
@@ -124,6 +167,24 @@ void _mi_prim_thread_done_auto_done(void);
 // Called when the default heap for a thread changes
 void _mi_prim_thread_associate_default_heap(mi_heap_t* heap);
 
+// Start the background purge thread that runs `fun` (see `purge.c`).
+// Return `false` if threads are not supported (in which case purging stays on the allocating threads).
+bool _mi_prim_purge_thread_start(void (*fun)(void));
+
+// Called on the purge thread to wait until it is signaled or `timeout` milli-seconds passed
+// (or wait until signaled if `timeout < 0`). A signal before the wait is not lost.
+void _mi_prim_purge_thread_wait(mi_msecs_t timeout);
+
+// Signal the purge thread (to wake it up from `_mi_prim_purge_thread_wait`).
+void _mi_prim_purge_thread_signal(void);
+
+// Wait until the purge thread has terminated.
+void _mi_prim_purge_thread_join(void);
+
+// Register handlers that are called around a `fork` (called at most once).
+// The purge thread does not exist in the forked child.
+void _mi_prim_purge_thread_atfork(void (*prepare)(void), void (*parent)(void), void (*child)(void));
+
 
 //-------------------------------------------------------------------
 // Access to TLS (thread local storage) slots.
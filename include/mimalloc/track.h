@@ -136,7 +136,7 @@ defined, undefined, or not accessible at all:
 #if MI_PADDING
 #define mi_track_malloc(p,reqsize,zero) \
   if ((p)!=NULL) { \
-    mi_assert_internal(mi_usable_size(p)==(reqsize)); \
+    mi_assert_internal(mi_usable_size(p)==(reqsize) || mi_page_is_monotonic(_mi_ptr_page(p))); /* monotonic objects are rounded up to `MI_MAX_ALIGN_SIZE` (without padding) */ \
     mi_track_malloc_size(p,reqsize,reqsize,zero); \
   }
 #else
@@ -147,4 +147,43 @@ defined, undefined, or not accessible at all:
   }
 #endif
 
+
+/* ------------------------------------------------------------------------------------------------------
+Static tracepoints (USDT) for tools like bpftrace, perf, or systemtap (when building with `MI_USDT=1`).
+A probe is just a `nop` in the code and has no cost unless a tool attaches to it. All probes are
+in the `mimalloc` provider and can be listed with `bpftrace -l 'usdt:<path>/libmimalloc.so:*'`.
+
+  #define mi_usdt_probe0(name)
+  #define mi_usdt_probe1(name,a1)
+  ...
+  #define mi_usdt_probe4(name,a1,a2,a3,a4)
+
+The probes (and their arguments) are:
+
+  thread_init(thread_id), thread_done(thread_id)
+  segment_alloc(segment,size,kind), segment_free(segment,size)
+  segment_abandon(segment,used), segment_reclaim(segment,used)
+  page_fresh(page,block_size,bin), page_retire(page,block_size), page_free(page,block_size)
+  page_abandon(page,block_size), page_reclaim(page,block_size,heap)
+  huge_alloc(page,block_size,alignment)
+  arena_reserve(start,size,arena_id), arena_purge(start,size,arena_id)
+  os_commit(start,size), os_decommit(start,size), os_purge(start,size,needs_recommit)
+-------------------------------------------------------------------------------------------------------*/
+
+#if MI_USDT
+#include <sys/sdt.h>
+
+#define mi_usdt_probe0(name)              DTRACE_PROBE(mimalloc,name)
+#define mi_usdt_probe1(name,a1)           DTRACE_PROBE1(mimalloc,name,a1)
+#define mi_usdt_probe2(name,a1,a2)        DTRACE_PROBE2(mimalloc,name,a1,a2)
+#define mi_usdt_probe3(name,a1,a2,a3)     DTRACE_PROBE3(mimalloc,name,a1,a2,a3)
+#define mi_usdt_probe4(name,a1,a2,a3,a4)  DTRACE_PROBE4(mimalloc,name,a1,a2,a3,a4)
+#else
+#define mi_usdt_probe0(name)
+#define mi_usdt_probe1(name,a1)
+#define mi_usdt_probe2(name,a1,a2)
+#define mi_usdt_probe3(name,a1,a2,a3)
+#define mi_usdt_probe4(name,a1,a2,a3,a4)
+#endif
+
 #endif
@@ -204,6 +204,10 @@ typedef int32_t  mi_ssize_t;
 #define MI_LARGE_OBJ_SIZE_MAX             (MI_SEGMENT_SIZE/2)      // 16 MiB on 64-bit
 #define MI_LARGE_OBJ_WSIZE_MAX            (MI_LARGE_OBJ_SIZE_MAX/MI_INTPTR_SIZE)
 
+// Monotonic heaps bump allocate in chunks that are allocated as large blocks
+#define MI_MONOTONIC_CHUNK_MIN            (MI_MEDIUM_PAGE_SIZE)    // 512 KiB on 64-bit
+#define MI_MONOTONIC_CHUNK_MAX            (MI_LARGE_OBJ_SIZE_MAX)  // 16 MiB on 64-bit
+
 // Maximum number of size classes. (spaced exponentially in 12.5% increments)
 #if MI_BIN_HUGE != 73U
 #error "mimalloc internal: expecting 73 bins"
@@ -264,14 +268,16 @@ typedef enum mi_delayed_e {
 } mi_delayed_t;
 
 
-// The `in_full` and `has_aligned` page flags are put in a union to efficiently
-// test if both are false (`full_aligned == 0`) in the `mi_free` routine.
+// The `in_full`, `has_aligned`, `is_monotonic`, and `has_sampled` page flags are put in a union to efficiently
+// test if all are false (`full_aligned == 0`) in the `mi_free` routine.
 #if !MI_TSAN
 typedef union mi_page_flags_s {
   uint8_t full_aligned;
   struct {
     uint8_t in_full : 1;
     uint8_t has_aligned : 1;
+    uint8_t is_monotonic : 1;
+    uint8_t has_sampled : 1;    // contains blocks sampled by the heap profiler (see `profile.c`)
   } x;
 } mi_page_flags_t;
 #else
@@ -281,6 +287,8 @@ typedef union mi_page_flags_s {
   struct {
     uint8_t in_full;
     uint8_t has_aligned;
+    uint8_t is_monotonic;
+    uint8_t has_sampled;
   } x;
 } mi_page_flags_t;
 #endif
@@ -324,19 +332,22 @@ typedef struct mi_page_s {
   uint8_t               is_committed:1;    // `true` if the page virtual memory is committed
   uint8_t               is_zero_init:1;    // `true` if the page was initially zero initialized
   uint8_t               is_huge:1;         // `true` if the page is in a huge segment (`segment->kind == MI_SEGMENT_HUGE`)
+  uint8_t               is_sparse:1;       // `true` if the page was under-utilized at `mi_heap_defrag_begin` (and is avoided for allocation)
                                            // padding
   // layout like this to optimize access in `mi_malloc` and `mi_free`
   uint16_t              capacity;          // number of blocks committed, must be the first field, see `segment.c:page_clear`
   uint16_t              reserved;          // number of blocks reserved in memory
-  mi_page_flags_t       flags;             // `in_full` and `has_aligned` flags (8 bits)
+  mi_page_flags_t       flags;             // `in_full`, `has_aligned`, and `is_monotonic` flags (8 bits)
   uint8_t               free_is_zero:1;    // `true` if the blocks in the free list are zero initialized
-  uint8_t               retire_expire:7;   // expiration count for retired blocks
+  uint8_t               is_bump:1;         // `true` if fresh blocks are bump allocated from `capacity` up to `reserved` (see `alloc.c:mi_page_malloc_bump`)
+  uint8_t               retire_expire:6;   // expiration count for retired blocks
 
   mi_block_t*           free;              // list of available free blocks (`malloc` allocates from this list)
   mi_block_t*           local_free;        // list of deferred free blocks by this thread (migrates to `free`)
   uint16_t              used;              // number of blocks in use (including blocks in `thread_free`)
   uint8_t               block_size_shift;  // if not zero, then `(1 << block_size_shift) == block_size` (only used for fast path in `free.c:_mi_page_ptr_unalign`)
-  uint8_t               heap_tag;          // tag of the owning heap, used to separate heaps by object type
+  uint8_t               heap_tag;          // tag of the owning heap, used to separate heaps by object type (< `MI_HEAP_TAG_COUNT`)
+  uint8_t               is_destroyable:1;  // `true` if the owning heap may be destroyed (so frees by other threads are never buffered, see `free.c:mi_free_remote_buffered`)
                                            // padding
   size_t                block_size;        // size available in each block (always `>0`)
   uint8_t*              page_start;        // start of the page area containing the blocks
@@ -352,7 +363,7 @@ typedef struct mi_page_s {
   struct mi_page_s*     prev;              // previous page owned by this thread with the same `block_size`
 
   // 64-bit 11 words, 32-bit 13 words, (+2 for secure)
-  void* padding[1];
+  struct mi_objcache_s* objcache;          // the object cache of the owning heap (or NULL), see `objcache.c`
 } mi_page_t;
 
 
@@ -388,6 +399,7 @@ typedef enum mi_segment_kind_e {
 
 #define MI_MINIMAL_COMMIT_SIZE      (1*MI_SEGMENT_SLICE_SIZE)
 #define MI_COMMIT_SIZE              (MI_SEGMENT_SLICE_SIZE)              // 64KiB
+#define MI_THP_COMMIT_SIZE          (2*MI_MiB)                           // commit size for segments backed by transparent huge pages
 #define MI_COMMIT_MASK_BITS         (MI_SEGMENT_SIZE / MI_COMMIT_SIZE)
 #define MI_COMMIT_MASK_FIELD_BITS    MI_SIZE_BITS
 #define MI_COMMIT_MASK_FIELD_COUNT  (MI_COMMIT_MASK_BITS / MI_COMMIT_MASK_FIELD_BITS)
@@ -402,6 +414,7 @@ typedef struct mi_commit_mask_s {
 
 typedef mi_page_t  mi_slice_t;
 typedef int64_t    mi_msecs_t;
+typedef int64_t    mi_nsecs_t;
 
 
 // ---------------------------------------------------------------
@@ -469,11 +482,19 @@ typedef struct mi_segment_s {
   bool              allow_purge;        // can we purge the memory (reset or decommit)
   size_t            segment_size;
   mi_subproc_t*     subproc;            // segment belongs to sub process
+  int               numa_node;          // numa node the memory is (preferably) located at, or -1 if unknown
+  bool              numa_bound;         // bound to `numa_node` by `_mi_os_numa_bind` (and unbound when freed)
+  int               thp;                // transparent huge page policy (see `mi_heap_t.thp`)
 
   // segment fields
   mi_msecs_t        purge_expire;       // purge slices in the `purge_mask` after this time
   mi_commit_mask_t  purge_mask;         // slices that can be purged
   mi_commit_mask_t  commit_mask;        // slices that are currently committed
+  bool              purge_background;   // delayed purges are done by the purge thread (see `purge.c`)
+  mi_lock_t         purge_lock;         // if `purge_background`, protects the purge and commit masks (as the purge thread may purge concurrently)
+  mi_msecs_t        purge_delay;        // with `mi_option_purge_adaptive`, the purge delay of this segment (or 0 for the default)
+  mi_msecs_t        purged_at;          // with `mi_option_purge_adaptive`, time of the last delayed purge (or 0 if that was reused since)
+  mi_commit_mask_t  purged_mask;        // slices purged by the last delayed purge (if `purged_at != 0`)
 
   // from here is zero initialized
   struct mi_segment_s* next;            // the list of freed segments in the cache (must be first field, see `segment.c:mi_segment_init`)
@@ -489,6 +510,10 @@ typedef struct mi_segment_s {
   struct mi_segment_s* abandoned_os_next; // only used for abandoned segments outside arena's, and only if `mi_option_visit_abandoned` is enabled
   struct mi_segment_s* abandoned_os_prev;
 
+  bool              purge_posted;        // posted to the purge thread? (protected by `purge_lock`)
+  struct mi_segment_s* purge_next;       // list of segments posted to the purge thread (protected by `purge.c:mi_purge_lock`, and it can stay linked for a bit after it is no longer posted)
+  struct mi_segment_s* purge_prev;
+
   size_t            segment_slices;      // for huge segments this may be different from `MI_SLICES_PER_SEGMENT`
   size_t            segment_info_slices; // initial count of slices that we are using for segment info and possible guard pages.
 
@@ -526,6 +551,9 @@ typedef struct mi_page_queue_s {
 
 #define MI_BIN_FULL  (MI_BIN_HUGE+1)
 
+// Heap tags are stored in a byte (`mi_page_t.heap_tag`)
+#define MI_HEAP_TAG_COUNT  (256)
+
 // Random context
 typedef struct mi_random_cxt_s {
   uint32_t input[16];
@@ -557,6 +585,8 @@ struct mi_heap_s {
   _Atomic(mi_block_t*)  thread_delayed_free;
   mi_threadid_t         thread_id;                           // thread this heap belongs too
   mi_arena_id_t         arena_id;                            // arena id if the heap belongs to a specific arena (or 0)
+  int                   numa_node;                           // numa node the heap is bound to (or -1 for any)
+  int                   thp;                                 // transparent huge pages for its segments: 1 = use, 0 = avoid, -1 = process default
   uintptr_t             cookie;                              // random cookie to verify pointers (see `_mi_ptr_cookie`)
   uintptr_t             keys[2];                             // two random keys used to encode the `thread_delayed_free` list
   mi_random_ctx_t       random;                              // random number context used for secure allocation
@@ -564,17 +594,33 @@ struct mi_heap_s {
   size_t                page_retired_min;                    // smallest retired index (retired pages are fully free, but still in the page queues)
   size_t                page_retired_max;                    // largest retired index into the `pages` array.
   size_t                pages_full_size;                     // optimization: total size of blocks in the pages of the full queue (issue #1220)
+  size_t                pages_size;                          // total size of blocks in all pages of the `pages` queues (used for the commit limits)
+  size_t                commit_soft_limit;                   // signal commit pressure when `pages_size` goes above this limit (or 0)
+  size_t                commit_limit;                        // do not allocate fresh pages when `pages_size` would go above this limit (or 0)
+  mi_stat_count_t       stat_pages;                          // pages in the `pages` queues; maintained on page transitions, also without `MI_STAT` (see `stats.c:mi_heap_stats_get`)
+  mi_stat_count_t       stat_pages_size;                     // total size of blocks in those pages (where `current == pages_size`)
   long                  generic_count;                       // how often is `_mi_malloc_generic` called?
   long                  generic_collect_count;               // how often is `_mi_malloc_generic` called without collecting?
   mi_heap_t*            next;                                // list of heaps per thread
   bool                  no_reclaim;                          // `true` if this heap should not reclaim abandoned pages
   uint8_t               tag;                                 // custom tag, can be used for separating heaps based on the object types
+  bool                  monotonic;                           // `true` if this heap only bump allocates and `mi_free` is a no-op (see `page.c:mi_heap_monotonic_malloc`)
+  bool                  commit_pressure;                     // `true` if `pages_size` went above the `commit_soft_limit` (see `page.c:mi_heap_commit_pressure`)
+  struct mi_objcache_s* objcache;                            // the object cache that owns this heap (or NULL), see `objcache.c`
+  uint8_t*              bump_chunk;                          // monotonic heap: start of the current chunk (with its object boundary map)
+  uint8_t*              bump_next;                           // monotonic heap: next free byte in the current chunk
+  uint8_t*              bump_end;                            // monotonic heap: end of the current chunk
+  size_t                bump_chunk_size;                     // monotonic heap: size of the next chunk (grows up to `MI_MONOTONIC_CHUNK_MAX`)
   #if MI_GUARDED
   size_t                guarded_size_min;                    // minimal size for guarded objects
   size_t                guarded_size_max;                    // maximal size for guarded objects
   size_t                guarded_sample_rate;                 // sample rate (set to 0 to disable guarded pages)
   size_t                guarded_sample_count;                // current sample count (counting down to 0)
   #endif
+  #if MI_HEAP_PROFILE
+  size_t                profile_sample_rate;                 // average number of allocated bytes between heap profile samples (or 0 if disabled)
+  ptrdiff_t             profile_countdown;                   // allocated bytes until the next sample (counting down to below 0)
+  #endif
   mi_page_t*            pages_free_direct[MI_PAGES_DIRECT];  // optimize: array where every entry points a page with possibly free blocks in the corresponding queue for that size.
   mi_page_queue_t       pages[MI_BIN_FULL + 1];              // queue of pages for each size class (or "bin")
 };
@@ -612,6 +658,31 @@ typedef struct mi_span_queue_s {
 #define MI_SEGMENT_BIN_MAX (35)     // 35 == mi_segment_bin(MI_SLICES_PER_SEGMENT)
 
 // Segments thread local data
+// Low-overhead statistics (with `MI_STAT_LITE`): plain counters that are only written by the owning thread
+// (without atomic read-modify-write operations) and summed over all threads on demand (see `stats.c:mi_stats_lite_collect`).
+// These blocks are never freed but reused by new threads.
+#define MI_STAT_LITE_FIELDS() \
+  MI_STAT_LITE_COUNTER(malloc_normal)       /* allocated bytes <= MI_MEDIUM_OBJ_SIZE_MAX */ \
+  MI_STAT_LITE_COUNTER(malloc_normal_count) \
+  MI_STAT_LITE_COUNTER(free_normal)         /* freed bytes <= MI_MEDIUM_OBJ_SIZE_MAX */ \
+  MI_STAT_LITE_COUNTER(malloc_huge)         /* allocated bytes in huge pages */ \
+  MI_STAT_LITE_COUNTER(malloc_huge_count) \
+  MI_STAT_LITE_COUNTER(free_huge)           /* freed bytes in huge pages */ \
+  MI_STAT_LITE_COUNTER(pages)               /* allocated pages */ \
+  MI_STAT_LITE_COUNTER(pages_freed) \
+  MI_STAT_LITE_COUNTER(segments)            /* allocated segments */ \
+  MI_STAT_LITE_COUNTER(segments_freed)
+
+#define MI_STAT_LITE_COUNTER(stat)  _Atomic(int64_t) stat;
+
+typedef struct mi_stats_lite_s {
+  struct mi_stats_lite_s* next;      // list of all blocks
+  _Atomic(uintptr_t)      in_use;    // owned by a thread?
+  MI_STAT_LITE_FIELDS()
+} mi_stats_lite_t;
+
+#undef MI_STAT_LITE_COUNTER
+
 typedef struct mi_segments_tld_s {
   mi_span_queue_t     spans[MI_SEGMENT_BIN_MAX+1];  // free slice spans inside segments
   size_t              count;        // current number of segments;
@@ -621,8 +692,32 @@ typedef struct mi_segments_tld_s {
   size_t              reclaim_count;// number of reclaimed (abandoned) segments
   mi_subproc_t*       subproc;      // sub-process this thread belongs to.
   mi_stats_t*         stats;        // points to tld stats
+  mi_stats_lite_t*    stats_lite;   // points to tld low-overhead statistics
+  int                 numa_node;    // cached numa node of the thread (or -1 if not yet determined)
+  int                 numa_bound;   // numa node the thread is bound to (or -1 if unbound)
+  mi_threadid_t       thread_id;    // owner id of segments allocated by this tld (the thread id, or a unique id for per-cpu heaps)
 } mi_segments_tld_t;
 
+// Buffered frees of blocks owned by other threads: blocks are chained per page
+// and published with a single CAS (see `free.c:mi_free_remote_buffered`).
+#define MI_REMOTE_FREE_PAGES  (16)    // pages in the buffer
+#define MI_REMOTE_FREE_BATCH  (64)    // blocks per page before the chain is published
+#define MI_REMOTE_FREE_FLUSH  (256)   // buffered frees before all chains are published
+
+typedef struct mi_remote_free_page_s {
+  mi_page_t*  page;
+  mi_block_t* first;
+  mi_block_t* last;
+  size_t      count;
+} mi_remote_free_page_t;
+
+typedef struct mi_remote_free_s {
+  int8_t                enabled;      // 1: enabled, -1: disabled for this thread, 0: not yet determined from `mi_option_remote_free_buffer`
+  size_t                count;        // total number of buffered blocks
+  size_t                frees;        // buffered frees since all chains were published
+  mi_remote_free_page_t pages[MI_REMOTE_FREE_PAGES];
+} mi_remote_free_t;
+
 // Thread local data
 struct mi_tld_s {
   unsigned long long  heartbeat;     // monotonic heartbeat count
@@ -631,6 +726,9 @@ struct mi_tld_s {
   mi_heap_t*          heaps;         // list of heaps in this thread (so we can abandon all when the thread terminates)
   mi_segments_tld_t   segments;      // segment tld
   mi_stats_t          stats;         // statistics
+  mi_stats_lite_t*    stats_lite;    // low-overhead statistics (only maintained with `MI_STAT_LITE`)
+  mi_remote_free_t    remote_free;   // buffered frees of blocks owned by other threads
+  struct mi_trace_buffer_s* trace;   // flight recorder events of this thread (claimed on the first event, see `trace.c`)
 };
 
 
@@ -660,6 +758,12 @@ struct mi_tld_s {
 #endif
 #endif
 
+// Define MI_STAT_LITE as 1 to maintain a few statistics with low overhead in release builds (see `mi_stats_lite_t`)
+#if (MI_STAT>0) || !defined(MI_STAT_LITE)
+#undef  MI_STAT_LITE
+#define MI_STAT_LITE 0
+#endif
+
 // add to stat keeping track of the peak
 void _mi_stat_increase(mi_stat_count_t* stat, size_t amount);
 void _mi_stat_decrease(mi_stat_count_t* stat, size_t amount);
@@ -684,4 +788,12 @@ void _mi_stat_counter_increase(mi_stat_counter_t* stat, size_t amount);
 #define mi_heap_stat_decrease(heap,stat,amount)  mi_stat_decrease( (heap)->tld->stats.stat, amount)
 #define mi_heap_stat_adjust_decrease(heap,stat,amount)  mi_stat_adjust_decrease( (heap)->tld->stats.stat, amount)
 
+// low-overhead statistics are only written by the owning thread so we can avoid an atomic add
+#if (MI_STAT_LITE)
+#define mi_stat_lite_add(stat,amount)         mi_atomic_storei64_relaxed(&(stat), mi_atomic_loadi64_relaxed(&(stat)) + (int64_t)(amount))
+#else
+#define mi_stat_lite_add(stat,amount)         ((void)0)
+#endif
+#define mi_heap_stat_lite_add(heap,stat,amount)  mi_stat_lite_add( (heap)->tld->stats_lite->stat, amount)
+
 #endif
@@ -21,7 +21,9 @@ static bool mi_malloc_is_naturally_aligned( size_t size, size_t alignment ) {
   if (alignment > size) return false;
   if (alignment <= MI_MAX_ALIGN_SIZE) return true;
   const size_t bsize = mi_good_size(size);
-  return (bsize <= MI_MAX_ALIGN_GUARANTEE && (bsize & (alignment-1)) == 0);
+  if (bsize <= MI_MAX_ALIGN_GUARANTEE) return ((bsize & (alignment-1)) == 0);
+  // larger blocks are the only block in their page and start at a slice boundary
+  return (alignment <= MI_SEGMENT_SLICE_SIZE);
 }
 
 #if MI_GUARDED
@@ -104,7 +106,9 @@ static mi_decl_noinline void* mi_heap_malloc_zero_aligned_at_overalloc(mi_heap_t
       block->next = MI_BLOCK_TAG_ALIGNED;
     }
     #endif
-    _mi_padding_shrink(page, (mi_block_t*)p, adjust + size);
+    if (!mi_page_is_monotonic(page)) {  // (objects in a monotonic heap have no padding)
+      _mi_padding_shrink(page, (mi_block_t*)p, adjust + size);
+    }
   }
   // todo: expand padding if overallocated ?
 
@@ -115,7 +119,7 @@ static mi_decl_noinline void* mi_heap_malloc_zero_aligned_at_overalloc(mi_heap_t
   #if MI_DEBUG > 1
   mi_page_t* const apage = _mi_ptr_page(aligned_p);
   void* unalign_p = _mi_page_ptr_unalign(apage, aligned_p);
-  mi_assert_internal(p == unalign_p);
+  mi_assert_internal(p == unalign_p || mi_page_is_monotonic(apage));
   #endif
 
   // now zero the block if needed
@@ -149,8 +153,12 @@ static mi_decl_noinline void* mi_heap_malloc_zero_aligned_at_generic(mi_heap_t*
   // use regular allocation if it is guaranteed to fit the alignment constraints.
   // this is important to try as the fast path in `mi_heap_malloc_zero_aligned` only works when there exist
   // a page with the right block size, and if we always use the over-alloc fallback that would never happen.
-  if (offset == 0 && mi_malloc_is_naturally_aligned(size,alignment)) {
-    void* p = mi_heap_malloc_zero_no_guarded(heap, size, zero, usable);
+  // we round the size up to the alignment first: the size classes are such that a multiple of the alignment
+  // maps to a block size that is a multiple of the alignment as well, so we do not need to over-allocate.
+  // (monotonic heaps bump allocate at `MI_MAX_ALIGN_SIZE` and always over-allocate)
+  if (offset == 0 && alignment <= MI_BLOCK_ALIGNMENT_MAX && !heap->monotonic &&
+      mi_malloc_is_naturally_aligned(_mi_align_up(size, alignment), alignment)) {
+    void* p = mi_heap_malloc_zero_no_guarded(heap, _mi_align_up(size, alignment), zero, usable);
     mi_assert_internal(p == NULL || ((uintptr_t)p % alignment) == 0);
     const bool is_aligned_or_null = (((uintptr_t)p) & (alignment-1))==0;
     if mi_likely(is_aligned_or_null) {
@@ -181,6 +189,15 @@ static void* mi_heap_malloc_zero_aligned_at(mi_heap_t* const heap, const size_t
     return NULL;
   }
 
+  // with per-cpu heaps, allocate under the claim as the page of an over-allocated block is updated as well
+  if mi_unlikely(!mi_heap_is_initialized(heap) && _mi_cpu_heaps_enabled()) {
+    mi_heap_t* const cpu_heap = _mi_cpu_heap_acquire();
+    if (cpu_heap == NULL) { return mi_heap_malloc_zero_aligned_at(mi_heap_get_default(), size, alignment, offset, zero, usable); } // re-entered
+    void* const p = mi_heap_malloc_zero_aligned_at(cpu_heap, size, alignment, offset, zero, usable);
+    _mi_cpu_heap_release(cpu_heap);
+    return p;
+  }
+
   #if MI_GUARDED
   if (offset==0 && alignment < MI_BLOCK_ALIGNMENT_MAX && mi_heap_malloc_use_guarded(heap,size)) {
     return mi_heap_malloc_guarded_aligned(heap, size, alignment, zero);
@@ -188,9 +205,10 @@ static void* mi_heap_malloc_zero_aligned_at(mi_heap_t* const heap, const size_t
   #endif
 
   // try first if there happens to be a small block available with just the right alignment
-  if mi_likely(size <= MI_SMALL_SIZE_MAX && alignment <= size) {
+  const size_t asize = (offset == 0 && alignment <= MI_SMALL_SIZE_MAX ? _mi_align_up(size, alignment) : size);
+  if mi_likely(asize <= MI_SMALL_SIZE_MAX && alignment <= asize) {
     const uintptr_t align_mask = alignment-1;       // for any x, `(x & align_mask) == (x % alignment)`
-    const size_t padsize = size + MI_PADDING_SIZE;
+    const size_t padsize = asize + MI_PADDING_SIZE;
     mi_page_t* page = _mi_heap_get_free_small_page(heap, padsize);
     if mi_likely(page->free != NULL) {
       const bool is_aligned = (((uintptr_t)page->free + offset) & align_mask)==0;
@@ -200,7 +218,7 @@ static void* mi_heap_malloc_zero_aligned_at(mi_heap_t* const heap, const size_t
         void* p = (zero ? _mi_page_malloc_zeroed(heap,page,padsize) : _mi_page_malloc(heap,page,padsize)); // call specific page malloc for better codegen
         mi_assert_internal(p != NULL);
         mi_assert_internal(((uintptr_t)p + offset) % alignment == 0);
-        mi_track_malloc(p,size,zero);
+        mi_track_malloc(p,asize,zero);
         return p;
       }
     }
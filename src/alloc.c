@@ -25,33 +25,32 @@ terms of the MIT license. A copy of the license can be found in the file
 // Allocation
 // ------------------------------------------------------
 
-// Fast allocation in a page: just pop from the free list.
-// Fall back to generic allocation only if the list is empty.
-// Note: in release mode the (inlined) routine is about 7 instructions with a single test.
-extern inline void* _mi_page_malloc_zero(mi_heap_t* heap, mi_page_t* page, size_t size, bool zero, size_t* usable) mi_attr_noexcept
-{
-  mi_assert_internal(size >= MI_PADDING_SIZE);
-  mi_assert_internal(page->block_size == 0 /* empty heap */ || mi_page_block_size(page) >= size);
-
-  // check the free list
-  mi_block_t* const block = page->free;
-  if mi_unlikely(block == NULL) {
-    return _mi_malloc_generic(heap, size, zero, 0, usable);
-  }
-  mi_assert_internal(block != NULL && _mi_ptr_page(block) == page);
-  if (usable != NULL) { *usable = mi_page_usable_block_size(page); };
-  // pop from the free list
-  page->free = mi_block_next(page, block);
-  page->used++;
-  mi_assert_internal(page->free == NULL || _mi_ptr_page(page->free) == page);
-  mi_assert_internal(page->block_size < MI_MAX_ALIGN_SIZE || _mi_is_aligned(block, MI_MAX_ALIGN_SIZE));
-
-  #if MI_DEBUG>3
-  if (page->free_is_zero && size > sizeof(*block)) {
-    mi_assert_expensive(mi_mem_is_zero(block+1,size - sizeof(*block)));
-  }
+// Set up the padding at the end of a `block` of `page` for a requested `size` (including the padding).
+static inline void mi_page_block_set_padding(mi_page_t* page, mi_block_t* block, size_t size) {
+  MI_UNUSED(page); MI_UNUSED(block); MI_UNUSED(size);
+  #if MI_PADDING // && !MI_TRACK_ENABLED
+    mi_padding_t* const padding = (mi_padding_t*)((uint8_t*)block + mi_page_usable_block_size(page));
+    ptrdiff_t delta = ((uint8_t*)padding - (uint8_t*)block - (size - MI_PADDING_SIZE));
+    #if (MI_DEBUG>=2)
+    mi_assert_internal(delta >= 0 && mi_page_usable_block_size(page) >= (size - MI_PADDING_SIZE + delta));
+    #endif
+    mi_track_mem_defined(padding,sizeof(mi_padding_t));  // note: re-enable since mi_page_usable_block_size may set noaccess
+    padding->canary = mi_ptr_encode_canary(page,block,page->keys);
+    padding->delta  = (uint32_t)(delta);
+    #if MI_PADDING_CHECK
+    if (!mi_page_is_huge(page)) {
+      uint8_t* fill = (uint8_t*)padding - delta;
+      const size_t maxpad = (delta > MI_MAX_ALIGN_SIZE ? MI_MAX_ALIGN_SIZE : delta); // set at most N initial padding bytes
+      for (size_t i = 0; i < maxpad; i++) { fill[i] = MI_DEBUG_PADDING; }
+    }
+    #endif
   #endif
+}
 
+// Initialize a block that was just popped from the free list of `page`:
+// zero or debug fill it, and set up the padding.
+static inline void mi_page_block_init(mi_page_t* page, mi_block_t* block, size_t size, bool zero) {
+  MI_UNUSED(size);
   // allow use of the block internally
   // note: when tracking we need to avoid ever touching the MI_PADDING since
   // that is tracked by valgrind etc. as non-accessible (through the red-zone, see `mimalloc/track.h`)
@@ -73,44 +72,157 @@ extern inline void* _mi_page_malloc_zero(mi_heap_t* heap, mi_page_t* page, size_
   }
 
   #if (MI_DEBUG>0) && !MI_TRACK_ENABLED && !MI_TSAN
-  if (!zero && !mi_page_is_huge(page)) {
+  if (!zero && !mi_page_is_huge(page) && !mi_page_is_objcache(page)) {  // object cache blocks stay constructed
     memset(block, MI_DEBUG_UNINIT, mi_page_usable_block_size(page));
   }
   #elif (MI_SECURE!=0)
   if (!zero) { block->next = 0; } // don't leak internal data
   #endif
 
+  mi_page_block_set_padding(page, block, size);
+}
+
+// Account for `count` blocks of `size` allocated from `page`.
+static inline void mi_page_malloc_stat(mi_heap_t* heap, const mi_page_t* page, size_t size, size_t count) {
+  MI_UNUSED(heap); MI_UNUSED(page); MI_UNUSED(size); MI_UNUSED(count);
   #if (MI_STAT>0)
   const size_t bsize = mi_page_usable_block_size(page);
   if (bsize <= MI_MEDIUM_OBJ_SIZE_MAX) {
-    mi_heap_stat_increase(heap, malloc_normal, bsize);
-    mi_heap_stat_counter_increase(heap, malloc_normal_count, 1);
+    mi_heap_stat_increase(heap, malloc_normal, count * bsize);
+    mi_heap_stat_counter_increase(heap, malloc_normal_count, count);
     #if (MI_STAT>1)
     const size_t bin = _mi_bin(bsize);
-    mi_heap_stat_increase(heap, malloc_bins[bin], 1);
-    mi_heap_stat_increase(heap, malloc_requested, size - MI_PADDING_SIZE);
+    mi_heap_stat_increase(heap, malloc_bins[bin], count);
+    mi_heap_stat_increase(heap, malloc_requested, count * (size - MI_PADDING_SIZE));
     #endif
   }
+  #elif (MI_STAT_LITE)
+  const size_t bsize = mi_page_usable_block_size(page);
+  if mi_likely(bsize <= MI_MEDIUM_OBJ_SIZE_MAX) {
+    mi_heap_stat_lite_add(heap, malloc_normal, count * bsize);
+    mi_heap_stat_lite_add(heap, malloc_normal_count, count);
+  }
+  else {
+    mi_heap_stat_lite_add(heap, malloc_huge, count * bsize);
+    mi_heap_stat_lite_add(heap, malloc_huge_count, count);
+  }
   #endif
+}
 
-  #if MI_PADDING // && !MI_TRACK_ENABLED
-    mi_padding_t* const padding = (mi_padding_t*)((uint8_t*)block + mi_page_usable_block_size(page));
-    ptrdiff_t delta = ((uint8_t*)padding - (uint8_t*)block - (size - MI_PADDING_SIZE));
-    #if (MI_DEBUG>=2)
-    mi_assert_internal(delta >= 0 && mi_page_usable_block_size(page) >= (size - MI_PADDING_SIZE + delta));
-    #endif
-    mi_track_mem_defined(padding,sizeof(mi_padding_t));  // note: re-enable since mi_page_usable_block_size may set noaccess
-    padding->canary = mi_ptr_encode_canary(page,block,page->keys);
-    padding->delta  = (uint32_t)(delta);
-    #if MI_PADDING_CHECK
-    if (!mi_page_is_huge(page)) {
-      uint8_t* fill = (uint8_t*)padding - delta;
-      const size_t maxpad = (delta > MI_MAX_ALIGN_SIZE ? MI_MAX_ALIGN_SIZE : delta); // set at most N initial padding bytes
-      for (size_t i = 0; i < maxpad; i++) { fill[i] = MI_DEBUG_PADDING; }
+// Can we bump allocate a fresh block from `page`? (see `mi_option_page_bump`)
+// We only bump once `local_free` is empty so recently freed blocks are reused first.
+static inline bool mi_page_can_bump(const mi_page_t* page) {
+  #if (MI_SECURE<2)
+  return (page->is_bump && page->local_free == NULL && page->capacity < page->reserved);
+  #else
+  MI_UNUSED(page);
+  return false;  // we always use the (randomized) free list
+  #endif
+}
+
+// Take the next never-touched block of a bump page; this extends the `capacity`
+// one block at a time so `used + |free| + |local_free| == capacity` still holds.
+static inline mi_block_t* mi_page_bump_block(mi_heap_t* heap, mi_page_t* page) {
+  mi_assert_internal(mi_page_can_bump(page));
+  const size_t bsize = mi_page_block_size(page);
+  mi_block_t* const block = (mi_block_t*)(mi_page_start(page) + (size_t)page->capacity * bsize);
+  page->capacity++;
+  mi_heap_stat_increase(heap, page_committed, bsize);
+  MI_UNUSED(heap);
+  if mi_unlikely(mi_page_is_objcache(page)) {
+    _mi_objcache_page_carve(page, page->capacity - 1, 1);
+  }
+  return block;
+}
+
+static mi_decl_noinline void* mi_page_malloc_bump(mi_heap_t* heap, mi_page_t* page, size_t size, bool zero, size_t* usable) mi_attr_noexcept {
+  mi_block_t* const block = mi_page_bump_block(heap, page);
+  mi_assert_internal(_mi_ptr_page(block) == page);
+  if (usable != NULL) { *usable = mi_page_usable_block_size(page); };
+  page->used++;
+  mi_page_block_init(page, block, size, zero);
+  mi_page_malloc_stat(heap, page, size, 1);
+  mi_heap_profile_count(heap, page, block, size);
+  return block;
+}
+
+// Bump allocate `size` bytes (including padding) in the current chunk of a monotonic heap.
+// Returns NULL if it does not fit, in which case `_mi_malloc_generic` starts a new chunk.
+static inline void* mi_heap_monotonic_bump(mi_heap_t* heap, size_t size, bool zero, size_t* usable) mi_attr_noexcept {
+  mi_assert_internal(heap->monotonic);
+  const size_t req_size = size - MI_PADDING_SIZE;  // correct for padding_size in case of an overflow on `size`
+  const size_t asize = _mi_align_up(req_size == 0 ? 1 : req_size, MI_MAX_ALIGN_SIZE);
+  if mi_unlikely(req_size > MI_MAX_ALLOC_SIZE || asize > (size_t)(heap->bump_end - heap->bump_next)) return NULL;
+  uint8_t* const p = heap->bump_next;
+  heap->bump_next += asize;
+  mi_monotonic_mark(heap->bump_chunk, heap->bump_next);
+  if (usable != NULL) { *usable = asize; }
+  if (zero) { _mi_memzero_aligned(p, asize); }
+  return p;
+}
+
+// Allocate from the heap of the current cpu for a thread without a heap of its own (see `init.c:_mi_cpu_heap_acquire`).
+// Note: the size includes MI_PADDING_SIZE
+mi_decl_noinline void* _mi_cpu_heap_malloc(size_t size, bool zero, size_t huge_alignment, size_t* usable) mi_attr_noexcept {
+  mi_heap_t* const heap = _mi_cpu_heap_acquire();
+  if mi_unlikely(heap == NULL) {
+    // re-entered while holding a claim: continue with a heap of our own
+    mi_heap_t* const theap = mi_heap_get_default(); // calls mi_thread_init
+    if mi_unlikely(!mi_heap_is_initialized(theap)) { return NULL; }
+    return _mi_malloc_generic(theap, size, zero, huge_alignment, usable);
+  }
+  void* p;
+  if mi_likely(size <= MI_SMALL_SIZE_MAX + MI_PADDING_SIZE && huge_alignment == 0) {
+    // the usual fast path, but in the claimed heap
+    mi_page_t* const page = _mi_heap_get_free_small_page(heap, size);
+    p = _mi_page_malloc_zero(heap, page, size, zero, usable);
+  }
+  else {
+    p = _mi_malloc_generic(heap, size, zero, huge_alignment, usable);
+  }
+  _mi_cpu_heap_release(heap);
+  return p;
+}
+
+// Fast allocation in a page: just pop from the free list.
+// Fall back to generic allocation only if the list is empty.
+// Note: in release mode the (inlined) routine is about 7 instructions with a single test.
+extern inline void* _mi_page_malloc_zero(mi_heap_t* heap, mi_page_t* page, size_t size, bool zero, size_t* usable) mi_attr_noexcept
+{
+  mi_assert_internal(size >= MI_PADDING_SIZE);
+  mi_assert_internal(page->block_size == 0 /* empty heap */ || mi_page_block_size(page) >= size);
+
+  // check the free list
+  mi_block_t* const block = page->free;
+  if mi_unlikely(block == NULL) {
+    if (mi_page_can_bump(page)) { return mi_page_malloc_bump(heap, page, size, zero, usable); }
+    if (heap->monotonic) {
+      void* const p = mi_heap_monotonic_bump(heap, size, zero, usable);
+      if mi_likely(p != NULL) return p;
     }
-    #endif
+    if (_mi_cpu_heaps_active && heap == &_mi_heap_empty) {
+      // a thread without a heap of its own allocates in the heap of its cpu
+      return _mi_cpu_heap_malloc(size, zero, 0, usable);
+    }
+    return _mi_malloc_generic(heap, size, zero, 0, usable);
+  }
+  mi_assert_internal(block != NULL && _mi_ptr_page(block) == page);
+  if (usable != NULL) { *usable = mi_page_usable_block_size(page); };
+  // pop from the free list
+  page->free = mi_block_next(page, block);
+  page->used++;
+  mi_assert_internal(page->free == NULL || _mi_ptr_page(page->free) == page);
+  mi_assert_internal(page->block_size < MI_MAX_ALIGN_SIZE || _mi_is_aligned(block, MI_MAX_ALIGN_SIZE));
+
+  #if MI_DEBUG>3
+  if (page->free_is_zero && size > sizeof(*block)) {
+    mi_assert_expensive(mi_mem_is_zero(block+1,size - sizeof(*block)));
+  }
   #endif
 
+  mi_page_block_init(page, block, size, zero);
+  mi_page_malloc_stat(heap, page, size, 1);
+  mi_heap_profile_count(heap, page, block, size);
   return block;
 }
 
@@ -131,7 +243,7 @@ static inline mi_decl_restrict void* mi_heap_malloc_small_zero(mi_heap_t* heap,
   mi_assert(size <= MI_SMALL_SIZE_MAX);
   #if MI_DEBUG
   const uintptr_t tid = _mi_thread_id();
-  mi_assert(heap->thread_id == 0 || heap->thread_id == tid); // heaps are thread local
+  mi_assert(heap->thread_id == 0 || heap->thread_id == tid || _mi_heap_is_per_cpu(heap)); // heaps are thread local (or locked per cpu)
   #endif
   #if (MI_PADDING || MI_GUARDED)
   if (size == 0) { size = sizeof(void*); }
@@ -168,6 +280,51 @@ mi_decl_nodiscard extern inline mi_decl_restrict void* mi_malloc_small(size_t si
   return mi_heap_malloc_small(mi_prim_get_default_heap(), size);
 }
 
+// ------------------------------------------------------
+// Size classes
+// A size class is the size in machine words; for small sizes it directly
+// indexes `pages_free_direct` (adjusted for the padding) without any bin computation.
+// ------------------------------------------------------
+
+mi_sizeclass_t mi_sizeclass_of(size_t size) mi_attr_noexcept {
+  if mi_unlikely(size > MI_MAX_ALLOC_SIZE) { return (MI_MAX_ALLOC_SIZE/MI_INTPTR_SIZE) + 1; } // fails on allocation
+  return MI_SIZECLASS_OF(size);
+}
+
+static inline mi_decl_restrict void* mi_heap_malloc_sc_zero(mi_heap_t* heap, mi_sizeclass_t sc, bool zero) mi_attr_noexcept {
+  mi_assert(heap != NULL);
+  mi_assert(sc > 0);
+  mi_assert(heap->thread_id == 0 || heap->thread_id == _mi_thread_id() || _mi_heap_is_per_cpu(heap)); // heaps are thread local (or locked per cpu)
+  const size_t size = sc * MI_INTPTR_SIZE;
+  if mi_likely(sc <= MI_SMALL_WSIZE_MAX) {
+    #if MI_GUARDED
+    if (mi_heap_malloc_use_guarded(heap,size)) {
+      return _mi_heap_malloc_guarded(heap, size, zero);
+    }
+    #endif
+    mi_assert_internal(sc + MI_PADDING_WSIZE == _mi_wsize_from_size(size + MI_PADDING_SIZE));
+    mi_page_t* const page = heap->pages_free_direct[sc + MI_PADDING_WSIZE];
+    void* const p = _mi_page_malloc_zero(heap, page, size + MI_PADDING_SIZE, zero, NULL);
+    mi_track_malloc(p,size,zero);
+    return p;
+  }
+  else {
+    return _mi_heap_malloc_zero(heap, size, zero);
+  }
+}
+
+mi_decl_nodiscard mi_decl_restrict void* mi_heap_malloc_sc(mi_heap_t* heap, mi_sizeclass_t sc) mi_attr_noexcept {
+  return mi_heap_malloc_sc_zero(heap, sc, false);
+}
+
+mi_decl_nodiscard mi_decl_restrict void* mi_heap_zalloc_sc(mi_heap_t* heap, mi_sizeclass_t sc) mi_attr_noexcept {
+  return mi_heap_malloc_sc_zero(heap, sc, true);
+}
+
+mi_decl_nodiscard mi_decl_restrict void* mi_malloc_sc(mi_sizeclass_t sc) mi_attr_noexcept {
+  return mi_heap_malloc_sc_zero(mi_prim_get_default_heap(), sc, false);
+}
+
 // The main allocation function
 extern inline void* _mi_heap_malloc_zero_ex(mi_heap_t* heap, size_t size, bool zero, size_t huge_alignment, size_t* usable) mi_attr_noexcept {
   // fast path for small objects
@@ -183,8 +340,14 @@ extern inline void* _mi_heap_malloc_zero_ex(mi_heap_t* heap, size_t size, bool z
   else {
     // regular allocation
     mi_assert(heap!=NULL);
-    mi_assert(heap->thread_id == 0 || heap->thread_id == _mi_thread_id());   // heaps are thread local
-    void* const p = _mi_malloc_generic(heap, size + MI_PADDING_SIZE, zero, huge_alignment, usable);  // note: size can overflow but it is detected in malloc_generic
+    mi_assert(heap->thread_id == 0 || heap->thread_id == _mi_thread_id() || _mi_heap_is_per_cpu(heap));   // heaps are thread local (or locked per cpu)
+    void* p = NULL;
+    if mi_unlikely(heap->monotonic && huge_alignment == 0) {
+      p = mi_heap_monotonic_bump(heap, size + MI_PADDING_SIZE, zero, usable);
+    }
+    if mi_likely(p == NULL) {
+      p = _mi_malloc_generic(heap, size + MI_PADDING_SIZE, zero, huge_alignment, usable);  // note: size can overflow but it is detected in malloc_generic
+    }
     mi_track_malloc(p,size,zero);
 
     #if MI_DEBUG>3
@@ -266,6 +429,176 @@ mi_decl_nodiscard mi_decl_restrict void* mi_mallocn(size_t count, size_t size) m
   return mi_heap_mallocn(mi_prim_get_default_heap(),count,size);
 }
 
+
+// ------------------------------------------------------
+// Batch allocation
+// ------------------------------------------------------
+
+// Pop up to `count` blocks from the free list of `page` into `out` (and bump
+// allocate further blocks for a bump page).
+// The `used` count and statistics are updated once for the whole run.
+static size_t mi_page_malloc_batch(mi_heap_t* heap, mi_page_t* page, size_t size, bool zero, size_t count, void** out) {
+  mi_assert_internal(mi_page_block_size(page) >= size);
+  size_t n = 0;
+  mi_block_t* block = page->free;
+  while (block != NULL && n < count) {
+    mi_assert_internal(_mi_ptr_page(block) == page);
+    mi_block_t* const next = mi_block_next(page, block);
+    mi_page_block_init(page, block, size, zero);
+    mi_track_malloc(block, size - MI_PADDING_SIZE, zero);
+    out[n++] = block;
+    block = next;
+  }
+  page->free = block;
+  while (n < count && block == NULL && mi_page_can_bump(page)) {
+    mi_block_t* const fresh = mi_page_bump_block(heap, page);
+    mi_page_block_init(page, fresh, size, zero);
+    mi_track_malloc(fresh, size - MI_PADDING_SIZE, zero);
+    out[n++] = fresh;
+  }
+  page->used += (uint16_t)n;
+  mi_page_malloc_stat(heap, page, size, n);
+  return n;
+}
+
+// Allocate `count` blocks of `size` bytes into `out`; returns the number of blocks allocated
+// which is only less than `count` if we ran out of memory.
+static size_t mi_heap_malloc_batch_zero(mi_heap_t* heap, size_t size, size_t count, void** out, bool zero) mi_attr_noexcept {
+  mi_assert(heap != NULL);
+  mi_assert(heap->thread_id == 0 || heap->thread_id == _mi_thread_id() || _mi_heap_is_per_cpu(heap)); // heaps are thread local (or locked per cpu)
+  if (count == 0 || out == NULL) return 0;
+  // with per-cpu heaps, allocate the whole batch under the claim (as we drain the page free list directly)
+  if mi_unlikely(!mi_heap_is_initialized(heap) && _mi_cpu_heaps_enabled()) {
+    mi_heap_t* const cpu_heap = _mi_cpu_heap_acquire();
+    if (cpu_heap == NULL) { return mi_heap_malloc_batch_zero(mi_heap_get_default(), size, count, out, zero); } // re-entered
+    const size_t n = mi_heap_malloc_batch_zero(cpu_heap, size, count, out, zero);
+    _mi_cpu_heap_release(cpu_heap);
+    return n;
+  }
+  #if (MI_PADDING || MI_GUARDED)
+  if (size == 0) { size = sizeof(void*); }
+  #endif
+  bool use_batch = (size <= MI_MEDIUM_OBJ_SIZE_MAX);
+  #if MI_GUARDED
+  if (heap->guarded_sample_rate != 0) { use_batch = false; } // keep sampling each allocation
+  #endif
+  #if MI_HEAP_PROFILE
+  if (heap->profile_sample_rate != 0) { use_batch = false; } // count each allocation for the heap profile
+  #endif
+  if (!use_batch) {
+    // huge blocks (or guarded sampling or heap profiling): allocate one at a time
+    size_t n = 0;
+    for (; n < count; n++) {
+      out[n] = _mi_heap_malloc_zero(heap, size, zero);
+      if (out[n] == NULL) break;
+    }
+    return n;
+  }
+
+  // compute the page once and drain its free list; only when it runs dry
+  // we take the generic path (which collects, extends, or finds a fresh page)
+  const size_t bsize = size + MI_PADDING_SIZE;
+  mi_page_t* page = (bsize <= MI_SMALL_SIZE_MAX + MI_PADDING_SIZE ? _mi_heap_get_free_small_page(heap, bsize) : heap->pages[_mi_bin(bsize)].first);
+  size_t n = 0;
+  while (n < count) {
+    if (page == NULL || (page->free == NULL && !mi_page_can_bump(page))) {
+      void* const p = _mi_malloc_generic(heap, bsize, zero, 0, NULL);
+      if (p == NULL) break;
+      mi_track_malloc(p, size, zero);
+      out[n++] = p;
+      page = _mi_ptr_page(p);  // and continue with the page of that block
+    }
+    else {
+      n += mi_page_malloc_batch(heap, page, bsize, zero, count - n, out + n);
+    }
+  }
+  return n;
+}
+
+size_t mi_heap_malloc_batch(mi_heap_t* heap, size_t size, size_t count, void** out) mi_attr_noexcept {
+  return mi_heap_malloc_batch_zero(heap, size, count, out, false);
+}
+
+size_t mi_heap_zalloc_batch(mi_heap_t* heap, size_t size, size_t count, void** out) mi_attr_noexcept {
+  return mi_heap_malloc_batch_zero(heap, size, count, out, true);
+}
+
+size_t mi_malloc_batch(size_t size, size_t count, void** out) mi_attr_noexcept {
+  return mi_heap_malloc_batch(mi_prim_get_default_heap(), size, count, out);
+}
+
+size_t mi_zalloc_batch(size_t size, size_t count, void** out) mi_attr_noexcept {
+  return mi_heap_zalloc_batch(mi_prim_get_default_heap(), size, count, out);
+}
+
+// Resize a block on a large page in place by growing into the adjacent free slices
+// of its segment, or by releasing its tail slices (see `segment.c:_mi_segment_large_page_resize`).
+// A block on a huge page is resized within its segment and a released tail is reset
+// (see `segment.c:_mi_segment_huge_page_resize`). The block must keep its page kind and
+// this is only done for a page owned by the current thread where `p` is the start of its only block.
+static bool mi_page_resize_in_place(mi_page_t* page, void* p, size_t newsize) {
+  if (page->used != 1 || page->reserved != 1 ||
+      mi_page_has_aligned(page) ||  // also excludes guarded and monotonic pages
+      mi_page_block_size(page) <= MI_MEDIUM_OBJ_SIZE_MAX || p != (void*)mi_page_start(page) ||
+      newsize > MI_MAX_ALLOC_SIZE || _mi_page_segment(page)->thread_id != _mi_thread_id()) {
+    return false;
+  }
+  const size_t bsize = newsize + MI_PADDING_SIZE;
+  mi_heap_t* const heap = mi_page_heap(page);
+  // the block size changes so the page must be in the full queue (it may not be after a reclaim or defragmentation)
+  _mi_page_to_full(page);
+  const size_t old_bsize  = mi_page_block_size(page);
+  const size_t old_usable = mi_page_usable_block_size(page);
+  if (mi_page_is_huge(page)) {
+    if (bsize <= MI_LARGE_OBJ_SIZE_MAX) return false;
+    if (!_mi_segment_huge_page_resize(page, bsize, &heap->tld->segments)) return false;
+  }
+  else {
+    if (bsize <= MI_MEDIUM_OBJ_SIZE_MAX || bsize > MI_LARGE_OBJ_SIZE_MAX) return false;
+    if (!_mi_segment_large_page_resize(page, bsize, &heap->tld->segments)) return false;
+  }
+
+  // the page stays in the full queue
+  const size_t new_bsize  = mi_page_block_size(page);
+  const size_t new_usable = mi_page_usable_block_size(page);
+  heap->pages_full_size = heap->pages_full_size - old_bsize + new_bsize;
+  heap->pages_size = heap->pages_size - old_bsize + new_bsize;
+  if (new_bsize > old_bsize) { _mi_stat_increase(&heap->stat_pages_size, new_bsize - old_bsize); }
+                        else { _mi_stat_decrease(&heap->stat_pages_size, old_bsize - new_bsize); }
+  if (new_usable > old_usable) { mi_heap_stat_increase(heap, malloc_huge, new_usable - old_usable); }
+                          else { mi_heap_stat_decrease(heap, malloc_huge, old_usable - new_usable); }
+  mi_page_block_set_padding(page, (mi_block_t*)p, bsize);
+  return true;
+}
+
+// Grow a block on a huge page in a remappable segment by remapping the segment which may move it
+// (see `page.c:_mi_page_huge_remap`). Returns the new block address or NULL if not possible.
+static void* mi_page_huge_remap(mi_page_t* page, void* p, size_t newsize) {
+  if (!mi_page_is_huge(page) || _mi_page_segment(page)->memid.memkind != MI_MEM_OS_REMAP ||
+      page->used != 1 || mi_page_has_aligned(page) || p != (void*)mi_page_start(page) ||
+      newsize > MI_MAX_ALLOC_SIZE || _mi_page_segment(page)->thread_id != _mi_thread_id()) {
+    return NULL;
+  }
+  _mi_page_to_full(page);  // (it may not be after a reclaim)
+  #if (MI_STAT>0)
+  mi_heap_t* const heap = mi_page_heap(page);
+  const size_t old_usable = mi_page_usable_block_size(page);
+  #endif
+  const bool was_sampled = mi_page_has_sampled(page);
+  mi_page_t* const newpage = _mi_page_huge_remap(page, newsize + MI_PADDING_SIZE);
+  if (newpage == NULL) return NULL;
+  void* const newp = mi_page_start(newpage);
+  if mi_unlikely(was_sampled) {
+    _mi_heap_profile_move((mi_block_t*)p, (mi_block_t*)newp);
+    mi_page_set_has_sampled(newpage, true);
+  }
+  #if (MI_STAT>0)
+  mi_heap_stat_increase(heap, malloc_huge, mi_page_usable_block_size(newpage) - old_usable);
+  #endif
+  mi_page_block_set_padding(newpage, (mi_block_t*)newp, newsize + MI_PADDING_SIZE);
+  return newp;
+}
+
 // Expand (or shrink) in place (or fail)
 void* mi_expand(void* p, size_t newsize) mi_attr_noexcept {
   #if MI_PADDING
@@ -276,7 +609,8 @@ void* mi_expand(void* p, size_t newsize) mi_attr_noexcept {
   if (p == NULL) return NULL;
   const mi_page_t* const page = mi_validate_ptr_page(p,"mi_expand");  
   const size_t size = _mi_usable_size(p,page);
-  if (newsize > size) return NULL;
+  if (mi_page_is_monotonic(page)) return NULL;
+  if (newsize > size && !mi_page_resize_in_place((mi_page_t*)page, p, newsize)) return NULL;
   return p; // it fits
   #endif
 }
@@ -295,14 +629,40 @@ void* _mi_heap_realloc_zero(mi_heap_t* heap, void* p, size_t newsize, bool zero,
   else {    
     page = mi_validate_ptr_page(p,"mi_realloc");  
     size = _mi_usable_size(p,page);
-    if (usable_pre!=NULL) { *usable_pre = mi_page_usable_block_size(page); }    
+    if (usable_pre!=NULL) { *usable_pre = (mi_page_is_monotonic(page) ? size : mi_page_usable_block_size(page)); }  // (a monotonic block is a whole chunk)
+  }
+  if (page != NULL && (newsize > size || size - newsize >= MI_SEGMENT_SLICE_SIZE) &&
+      mi_page_resize_in_place((mi_page_t*)page, p, newsize)) {
+    // grown or shrunk in place
+    mi_track_resize(p,size,newsize);
+    if (zero && newsize > size) {
+      // zero from the last word of the previous size as for a copy below (where that word is then copied back)
+      const size_t start = (size >= sizeof(intptr_t) ? size - sizeof(intptr_t) : 0);
+      uint8_t last[sizeof(intptr_t)];
+      _mi_memcpy(last, (uint8_t*)p + start, size - start);
+      _mi_memzero((uint8_t*)p + start, newsize - start);
+      _mi_memcpy((uint8_t*)p + start, last, size - start);
+    }
+    if (usable_post!=NULL) { *usable_post = mi_page_usable_block_size(page); }
+    return p;
+  }
+  if (page != NULL && newsize > size && mi_page_is_huge(page)) {
+    void* const newp = mi_page_huge_remap((mi_page_t*)page, p, newsize);
+    if (newp != NULL) {
+      // grown in place or moved by remapping
+      mi_track_free_size(p, size);
+      mi_track_malloc(newp, newsize, false);
+      if (zero) { _mi_memzero((uint8_t*)newp + size, newsize - size); }
+      if (usable_post!=NULL) { *usable_post = mi_page_usable_block_size(_mi_ptr_page(newp)); }
+      return newp;
+    }
   }
   if mi_unlikely(newsize <= size && newsize >= (size / 2) && newsize > 0) {  // note: newsize must be > 0 or otherwise we return NULL for realloc(NULL,0)
     mi_assert_internal(p!=NULL);
     // todo: do not track as the usable size is still the same in the free; adjust potential padding?
     // mi_track_resize(p,size,newsize)
     // if (newsize < size) { mi_track_mem_noaccess((uint8_t*)p + newsize, size - newsize); }
-    if (usable_post!=NULL) { *usable_post = mi_page_usable_block_size(page); }
+    if (usable_post!=NULL) { *usable_post = (mi_page_is_monotonic(page) ? size : mi_page_usable_block_size(page)); }
     return p;  // reallocation still fits and not more than 50% waste
   }
   void* newp = mi_heap_umalloc(heap,newsize,usable_post);
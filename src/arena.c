@@ -44,6 +44,8 @@ typedef struct mi_arena_s {
   mi_lock_t           abandoned_visit_lock; // lock is only used when abandoned segments are being visited
   _Atomic(size_t)     search_idx;           // optimization to start the search for free blocks
   _Atomic(mi_msecs_t) purge_expire;         // expiration time when blocks should be purged from `blocks_purge`.
+  _Atomic(mi_msecs_t) purge_delay;          // with `mi_option_purge_adaptive`, the purge delay of this arena (or 0 for the default)
+  _Atomic(mi_msecs_t) purged_at;            // with `mi_option_purge_adaptive`, time of the last purge (or 0 if blocks were claimed since)
 
   mi_bitmap_field_t*  blocks_dirty;         // are the blocks potentially non-zero?
   mi_bitmap_field_t*  blocks_committed;     // are the blocks committed? (can be NULL for memory that cannot be decommitted)
@@ -67,6 +69,8 @@ static mi_decl_cache_align _Atomic(int64_t)     mi_arenas_purge_expire; // set i
 #include "arena-abandon.c"
 #undef MI_IN_ARENA_C
 
+static void mi_arena_purge_note_reuse(mi_arena_t* arena);
+
 /* -----------------------------------------------------------
   Arena id's
   id = arena_index + 1
@@ -99,10 +103,25 @@ bool _mi_arena_memid_is_suitable(mi_memid_t memid, mi_arena_id_t request_arena_i
   }
 }
 
+// Return the numa node of the arena the memory belongs to (or -1 if unknown)
+int _mi_arena_memid_numa_node(mi_memid_t memid) {
+  if (memid.memkind != MI_MEM_ARENA) return -1;
+  const mi_arena_t* arena = mi_arena_from_index(mi_arena_id_index(memid.mem.arena.id));
+  return (arena != NULL ? arena->numa_node : -1);
+}
+
 bool _mi_arena_memid_is_os_allocated(mi_memid_t memid) {
   return (memid.memkind == MI_MEM_OS);
 }
 
+// is the memory allocated by us from the OS? (directly, or in an arena we reserved ourselves)
+bool _mi_arena_memid_is_os_backed(mi_memid_t memid) {
+  if (mi_memkind_is_os(memid.memkind)) return true;
+  if (memid.memkind != MI_MEM_ARENA) return false;
+  const mi_arena_t* arena = mi_arena_from_index(mi_arena_id_index(memid.mem.arena.id));
+  return (arena != NULL && mi_memkind_is_os(arena->memid.memkind));
+}
+
 size_t mi_arena_get_count(void) {
   return mi_atomic_load_relaxed(&mi_arena_count);
 }
@@ -250,6 +269,7 @@ static mi_decl_noinline void* mi_arena_try_alloc_at(mi_arena_t* arena, size_t ar
   if (arena->blocks_purge != NULL) {
     // this is thread safe as a potential purge only decommits parts that are not yet claimed as used (in `blocks_inuse`).
     _mi_bitmap_unclaim_across(arena->blocks_purge, arena->field_count, needed_bcount, bitmap_index);
+    if mi_unlikely(mi_atomic_loadi64_relaxed(&arena->purged_at) != 0) { mi_arena_purge_note_reuse(arena); }
   }
 
   // set the dirty bits (todo: no need for an atomic op here?)
@@ -402,13 +422,13 @@ static bool mi_arena_reserve(size_t req_size, bool allow_large, mi_arena_id_t *a
 
 
 void* _mi_arena_alloc_aligned(size_t size, size_t alignment, size_t align_offset, bool commit, bool allow_large,
-                              mi_arena_id_t req_arena_id, mi_memid_t* memid)
+                              mi_arena_id_t req_arena_id, int req_numa_node, mi_memid_t* memid)
 {
   mi_assert_internal(memid != NULL);
   mi_assert_internal(size > 0);
   *memid = _mi_memid_none();
 
-  const int numa_node = _mi_os_numa_node(); // current numa node
+  const int numa_node = (req_numa_node >= 0 ? req_numa_node : _mi_os_numa_node()); // preferred (or current) numa node
 
   // try to allocate in an arena if the alignment is small enough and the object is not too small (as for heap meta data)
   if (!mi_option_is_enabled(mi_option_disallow_arena_alloc)) {  // is arena allocation allowed?
@@ -447,7 +467,7 @@ void* _mi_arena_alloc_aligned(size_t size, size_t alignment, size_t align_offset
 
 void* _mi_arena_alloc(size_t size, bool commit, bool allow_large, mi_arena_id_t req_arena_id, mi_memid_t* memid)
 {
-  return _mi_arena_alloc_aligned(size, MI_ARENA_BLOCK_SIZE, 0, commit, allow_large, req_arena_id, memid);
+  return _mi_arena_alloc_aligned(size, MI_ARENA_BLOCK_SIZE, 0, commit, allow_large, req_arena_id, -1 /* current numa node */, memid);
 }
 
 
@@ -471,6 +491,26 @@ static long mi_arena_purge_delay(void) {
   return (mi_option_get(mi_option_purge_delay) * mi_option_get(mi_option_arena_purge_mult));
 }
 
+// the current purge delay of an arena (which can differ per arena with `mi_option_purge_adaptive`)
+static mi_msecs_t mi_arena_purge_delay_of(mi_arena_t* arena) {
+  const mi_msecs_t delay = mi_atomic_loadi64_relaxed(&arena->purge_delay);
+  if (delay > 0 && mi_option_is_enabled(mi_option_purge_adaptive)) return delay;
+  return mi_arena_purge_delay();
+}
+
+// with `mi_option_purge_adaptive`: blocks are claimed again; lengthen the purge delay if this is
+// soon after the last purge (see `purge.c:_mi_purge_delay_adapt`)
+// note: we do not track which blocks were purged, but arena blocks are only claimed on a segment
+// allocation which is what a longer delay could have served from the unpurged memory.
+static void mi_arena_purge_note_reuse(mi_arena_t* arena) {
+  mi_msecs_t purged_at = mi_atomic_loadi64_relaxed(&arena->purged_at);
+  if (purged_at == 0 || !mi_atomic_casi64_strong_acq_rel(&arena->purged_at, &purged_at, (mi_msecs_t)0)) return;  // only once per purge
+  const mi_msecs_t delay = mi_arena_purge_delay_of(arena);
+  if (_mi_purge_reused_soon(purged_at, delay)) {
+    mi_atomic_storei64_relaxed(&arena->purge_delay, _mi_purge_delay_adapt(delay, true /* reused */, mi_option_get(mi_option_arena_purge_mult)));
+  }
+}
+
 // reset or decommit in an arena and update the committed/decommit bitmaps
 // assumes we own the area (i.e. blocks_in_use is claimed by us)
 static void mi_arena_purge(mi_arena_t* arena, size_t bitmap_idx, size_t blocks) {
@@ -479,6 +519,8 @@ static void mi_arena_purge(mi_arena_t* arena, size_t bitmap_idx, size_t blocks)
   mi_assert_internal(!arena->memid.is_pinned);
   const size_t size = mi_arena_block_size(blocks);
   void* const p = mi_arena_block_start(arena, bitmap_idx);
+  mi_usdt_probe3(arena_purge, p, size, arena->id);
+  mi_trace_record(mi_trace_arena_purge, p, size, (size_t)arena->id);
   bool needs_recommit;
   size_t already_committed = 0;
   if (_mi_bitmap_is_claimed_across(arena->blocks_committed, arena->field_count, blocks, bitmap_idx, &already_committed)) {
@@ -507,7 +549,7 @@ static void mi_arena_purge(mi_arena_t* arena, size_t bitmap_idx, size_t blocks)
 // Note: assumes we (still) own the area as we may purge immediately
 static void mi_arena_schedule_purge(mi_arena_t* arena, size_t bitmap_idx, size_t blocks) {
   mi_assert_internal(arena->blocks_purge != NULL);
-  const long delay = mi_arena_purge_delay();
+  const mi_msecs_t delay = mi_arena_purge_delay_of(arena);
   if (delay < 0) return;  // is purging allowed at all?
 
   if (_mi_preloading() || delay == 0) {
@@ -521,7 +563,9 @@ static void mi_arena_schedule_purge(mi_arena_t* arena, size_t bitmap_idx, size_t
     if (mi_atomic_casi64_strong_acq_rel(&arena->purge_expire, &expire0, expire)) {
       // expiration was not yet set
       // maybe set the global arenas expire as well (if it wasn't set already)
-      mi_atomic_casi64_strong_acq_rel(&mi_arenas_purge_expire, &expire0, expire);
+      if (mi_atomic_casi64_strong_acq_rel(&mi_arenas_purge_expire, &expire0, expire)) {
+        _mi_purge_thread_wakeup(expire);
+      }
     }
     else {
       // already an expiration was set
@@ -613,9 +657,16 @@ static int mi_arena_try_purge(mi_arena_t* arena, mi_msecs_t now, bool force)
       } // while bitidx
     } // purge != 0
   }
+  // with an adaptive delay, shorten the delay if the previous purge was not reused (see `mi_arena_purge_note_reuse`)
+  if (any_purged && !force && _mi_purge_is_adaptive()) {
+    if (mi_atomic_loadi64_relaxed(&arena->purged_at) != 0) {
+      mi_atomic_storei64_relaxed(&arena->purge_delay, _mi_purge_delay_adapt(mi_arena_purge_delay_of(arena), false /* reused */, mi_option_get(mi_option_arena_purge_mult)));
+    }
+    mi_atomic_storei64_relaxed(&arena->purged_at, now);
+  }
   // if not fully purged, make sure to purge again in the future
   if (!full_purge) {
-    const long delay = mi_arena_purge_delay();
+    const mi_msecs_t delay = mi_arena_purge_delay_of(arena);
     mi_msecs_t expected = 0;
     mi_atomic_casi64_strong_acq_rel(&arena->purge_expire,&expected,_mi_clock_now() + delay);
   }
@@ -638,8 +689,10 @@ static void mi_arenas_try_purge( bool force, bool visit_all )
   static mi_atomic_guard_t purge_guard;
   mi_atomic_guard(&purge_guard)
   {
-    // increase global expire: at most one purge per delay cycle
-    mi_atomic_storei64_release(&mi_arenas_purge_expire, now + mi_arena_purge_delay());
+    const mi_nsecs_t latency_start = mi_stat_latency_start();
+    // increase global expire: at most one purge per delay cycle (or per minimal delay if the arena delays are adaptive)
+    const mi_msecs_t cycle = (_mi_purge_is_adaptive() ? mi_option_get_clamp(mi_option_purge_delay_min, 1, 1000000) * mi_option_get(mi_option_arena_purge_mult) : mi_arena_purge_delay());
+    mi_atomic_storei64_release(&mi_arenas_purge_expire, now + cycle);
     size_t max_purge_count = (visit_all ? max_arena : 2);
     bool all_visited = true;
     bool any_purged = false;
@@ -663,6 +716,7 @@ static void mi_arenas_try_purge( bool force, bool visit_all )
       // all arena's were visited and nothing needed to be purged: reset global expire
       mi_atomic_storei64_release(&mi_arenas_purge_expire, (mi_msecs_t)0);
     }
+    mi_stat_latency_end(&_mi_stats_main, mi_latency_arena_purge, latency_start);
   }
 }
 
@@ -748,8 +802,10 @@ void _mi_arena_free(void* p, size_t size, size_t committed_size, mi_memid_t memi
     mi_assert_internal(memid.memkind < MI_MEM_OS);
   }
 
-  // purge expired decommits
-  mi_arenas_try_purge(false, false);
+  // purge expired decommits (unless the purge thread does this)
+  if (!_mi_purge_thread_is_running()) {
+    mi_arenas_try_purge(false, false);
+  }
 }
 
 // destroy owned arenas; this is unsafe and should only be done using `mi_option_destroy_on_exit`
@@ -779,9 +835,17 @@ static void mi_arenas_unsafe_destroy(void) {
 
 // Purge the arenas; if `force_purge` is true, amenable parts are purged even if not yet expired
 void _mi_arenas_collect(bool force_purge) {
+  if (!force_purge && _mi_purge_thread_is_running()) return;  // expired purges are done by the purge thread
   mi_arenas_try_purge(force_purge, force_purge /* visit all? */);
 }
 
+// Purge all expired parts of the arenas; called by the purge thread (see `purge.c`)
+// Returns the next expiration (or 0 if no purges are scheduled)
+mi_msecs_t _mi_arenas_purge_expired(void) {
+  mi_arenas_try_purge(false, true /* visit all */);
+  return mi_atomic_loadi64_acquire(&mi_arenas_purge_expire);
+}
+
 // destroy owned arenas; this is unsafe and should only be done using `mi_option_destroy_on_exit`
 // for dynamic libraries that are unloaded and need to release all their allocated memory.
 void _mi_arena_unsafe_destroy_all(void) {
@@ -818,6 +882,8 @@ static bool mi_arena_add(mi_arena_t* arena, mi_arena_id_t* arena_id, mi_stats_t*
       arena->id = mi_arena_id_create(i);
       mi_atomic_store_ptr_release(mi_arena_t, &mi_arenas[i], arena);
       if (arena_id != NULL) { *arena_id = arena->id; }
+      mi_usdt_probe3(arena_reserve, arena->start, mi_arena_block_size(arena->block_count), arena->id);
+      mi_trace_record(mi_trace_arena_reserve, arena->start, mi_arena_block_size(arena->block_count), (size_t)arena->id);
       return true;
     }
   }
@@ -867,6 +933,8 @@ static bool mi_manage_os_memory_ex2(void* start, size_t size, bool is_large, int
   arena->numa_node    = numa_node; // TODO: or get the current numa node if -1? (now it allows anyone to allocate on -1)
   arena->is_large     = is_large;
   arena->purge_expire = 0;
+  arena->purge_delay  = 0;
+  arena->purged_at    = 0;
   arena->search_idx   = 0;
   mi_lock_init(&arena->abandoned_visit_lock);
   // consecutive bitmaps
@@ -25,22 +25,32 @@ static void   mi_stat_free(const mi_page_t* page, const mi_block_t* block);
 
 // forward declaration of multi-threaded free (`_mt`) (or free in huge block if compiled with MI_HUGE_PAGE_ABANDON)
 static mi_decl_noinline void mi_free_block_mt(mi_page_t* page, mi_segment_t* segment, mi_block_t* block, void* p, bool was_guarded);
+static mi_decl_noinline void mi_free_block_delayed_mt(mi_page_t* page, mi_block_t* block);
+static void mi_free_chain_mt(mi_page_t* page, mi_block_t* first, mi_block_t* last);
+static bool mi_free_remote_buffered(mi_page_t* page, mi_block_t* block);
 
-// regular free of a (thread local) block pointer
-// fast path written carefully to prevent spilling on the stack
-static inline void mi_free_block_local(mi_page_t* page, mi_block_t* block, bool was_guarded, bool track_stats, bool check_full)
+// checks before a thread local block is pushed on a free list; returns `false` if it should not be freed (double free)
+static inline bool mi_free_block_local_check(mi_page_t* page, mi_block_t* block, bool was_guarded, bool track_stats)
 {
   MI_UNUSED(was_guarded);
-  // checks  
-  if mi_unlikely(mi_check_is_double_free(page, block)) return;
+  if mi_unlikely(mi_check_is_double_free(page, block)) return false;
   if (!was_guarded) { mi_check_padding(page, block); }
   if (track_stats) { mi_stat_free(page, block); }
   #if (MI_DEBUG>0) && !MI_TRACK_ENABLED  && !MI_TSAN
-  if (!mi_page_is_huge(page)) {   // huge page content may be already decommitted
+  if (!mi_page_is_huge(page) && !mi_page_is_objcache(page)) {   // huge page content may be already decommitted (and object cache blocks stay constructed)
     memset(block, MI_DEBUG_FREED, mi_page_block_size(page));
   }
   #endif
   if (track_stats) { mi_track_free_size(block, mi_page_usable_size_of(page, block, was_guarded)); } // faster then mi_usable_size as we already know the page and that p is unaligned
+  return true;
+}
+
+// regular free of a (thread local) block pointer
+// fast path written carefully to prevent spilling on the stack
+static inline void mi_free_block_local(mi_page_t* page, mi_block_t* block, bool was_guarded, bool track_stats, bool check_full)
+{
+  // checks
+  if mi_unlikely(!mi_free_block_local_check(page, block, was_guarded, track_stats)) return;
 
   // actual free: push on the local free list
   mi_block_set_next(page, block, page->local_free);
@@ -97,17 +107,41 @@ static inline bool mi_block_check_unguard(mi_page_t* page, mi_block_t* block, vo
 }
 #endif
 
+// remove the heap profile sample of a block (if it was sampled)
+static inline void mi_block_check_sampled(mi_page_t* page, mi_block_t* block) {
+  #if MI_HEAP_PROFILE
+  if mi_unlikely(mi_page_has_sampled(page)) { _mi_heap_profile_free(block); }
+  #else
+  MI_UNUSED(page); MI_UNUSED(block);
+  #endif
+}
+
 // free a local pointer  (page parameter comes first for better codegen)
 static void mi_decl_noinline mi_free_generic_local(mi_page_t* page, mi_segment_t* segment, void* p) mi_attr_noexcept {
   MI_UNUSED(segment);
+  if mi_unlikely(mi_page_is_monotonic(page)) return;  // only released with the heap
   mi_block_t* const block = (mi_page_has_aligned(page) ? _mi_page_ptr_unalign(page, p) : (mi_block_t*)p);
+  mi_block_check_sampled(page, block);
   const bool was_guarded = mi_block_check_unguard(page, block, p);
   mi_free_block_local(page, block, was_guarded, true /* track stats */, true /* check for a full page */);
 }
 
 // free a pointer owned by another thread (page parameter comes first for better codegen)
 static void mi_decl_noinline mi_free_generic_mt(mi_page_t* page, mi_segment_t* segment, void* p) mi_attr_noexcept {
+  // a block in the per-cpu heap of the current cpu is freed locally (under the claim of that heap)
+  const mi_threadid_t owner = mi_atomic_load_relaxed(&segment->thread_id);
+  mi_heap_t* const cpu_heap = _mi_cpu_heap_try_acquire_owner(owner);
+  if mi_unlikely(cpu_heap != NULL) {
+    if mi_likely(mi_atomic_load_relaxed(&segment->thread_id) == owner) {  // still owned? (it may have been abandoned)
+      mi_free_generic_local(page, segment, p);
+      _mi_cpu_heap_release(cpu_heap);
+      return;
+    }
+    _mi_cpu_heap_release(cpu_heap);
+  }
+  if mi_unlikely(mi_page_is_monotonic(page)) return;  // only released with the heap
   mi_block_t* const block = _mi_page_ptr_unalign(page, p); // don't check `has_aligned` flag to avoid a race (issue #865)
+  mi_block_check_sampled(page, block);
   const bool was_guarded = mi_block_check_unguard(page, block, p);
   mi_free_block_mt(page, segment, block, p, was_guarded);
 }
@@ -201,14 +235,131 @@ void mi_free_small(void* p) mi_attr_noexcept {
 }
 
 
+// ------------------------------------------------------
+// Batch free
+// ------------------------------------------------------
+
+// Free a run of `count` pointers into the same thread local `page`:
+// the blocks are pushed onto the `local_free` list and we only check
+// once if the page should be retired or moved out of the full queue.
+// (we push each block directly instead of building a separate chain so
+// the double free check also detects a pointer that occurs twice in the run)
+static void mi_free_batch_local(mi_page_t* page, void** ps, size_t count) {
+  size_t n = 0;
+  for (size_t i = 0; i < count; i++) {
+    void* const p = ps[i];
+    mi_block_t* const block = (mi_page_has_aligned(page) ? _mi_page_ptr_unalign(page, p) : (mi_block_t*)p);
+    mi_block_check_sampled(page, block);
+    const bool was_guarded = mi_block_check_unguard(page, block, p);
+    if mi_unlikely(!mi_free_block_local_check(page, block, was_guarded, true /* track stats */)) continue;
+    mi_block_set_next(page, block, page->local_free);
+    page->local_free = block;
+    n++;
+  }
+  if (n == 0) return;
+
+  mi_assert_internal(page->used >= n);
+  page->used -= (uint16_t)n;
+  if mi_unlikely(page->used == 0) {
+    _mi_page_retire(page);
+  }
+  else if mi_unlikely(mi_page_is_in_full(page)) {
+    _mi_page_unfull(page);
+  }
+}
+
+// Free a run of `count` pointers into the same `page` owned by another thread:
+// the blocks are linked into a chain that is published on the page `xthread_free`
+// list with a single CAS (instead of one CAS per block as in `mi_free_block_delayed_mt`).
+static void mi_free_batch_mt(mi_page_t* page, void** ps, size_t count) {
+  mi_block_t* first = NULL;
+  mi_block_t* last  = NULL;
+  for (size_t i = 0; i < count; i++) {
+    void* const p = ps[i];
+    mi_block_t* const block = _mi_page_ptr_unalign(page, p); // don't check `has_aligned` flag to avoid a race (issue #865)
+    mi_block_check_sampled(page, block);
+    const bool was_guarded = mi_block_check_unguard(page, block, p);
+    // see `mi_free_block_mt`
+    if (!was_guarded) { mi_check_padding(page, block); }
+    mi_stat_free(page, block);
+    mi_track_free_size(block, mi_page_usable_size_of(page,block,was_guarded));
+    _mi_padding_shrink(page, block, sizeof(mi_block_t));
+    #if (MI_DEBUG>0) && !MI_TRACK_ENABLED  && !MI_TSAN
+    if (!mi_page_is_objcache(page)) { memset(block, MI_DEBUG_FREED, mi_usable_size(block)); }
+    #endif
+    mi_block_set_next(page, block, first);
+    if (last == NULL) { last = block; }
+    first = block;
+  }
+  if (first == NULL) return;
+  mi_free_chain_mt(page, first, last);
+}
+
+// Publish a chain of blocks (linked from `first` to `last`) on the `xthread_free` list
+// of a `page` owned by another thread with a single CAS.
+static void mi_free_chain_mt(mi_page_t* page, mi_block_t* first, mi_block_t* last) {
+  mi_thread_free_t tfree = mi_atomic_load_relaxed(&page->xthread_free);
+  while (true) {
+    if mi_unlikely(mi_tf_delayed(tfree) == MI_USE_DELAYED_FREE) {
+      // the page is in the full queue of its heap; push the first block
+      // through the heap delayed free list so the owning heap is notified
+      mi_block_t* const next = (first == last ? NULL : mi_block_next(page, first));
+      mi_free_block_delayed_mt(page, first);
+      if (next == NULL) return;
+      first = next;
+      tfree = mi_atomic_load_relaxed(&page->xthread_free);
+    }
+    else {
+      // usual: append the page thread free list to our chain
+      mi_block_set_next(page, last, mi_tf_block(tfree));
+      if (mi_atomic_cas_weak_release(&page->xthread_free, &tfree, mi_tf_set_block(tfree, first))) return;
+    }
+  }
+}
+
+// Free an array of pointers. Consecutive pointers into the same page are freed
+// together, so this is most effective if `ps` is (mostly) grouped by page (as is the
+// case for blocks allocated with `mi_heap_malloc_batch` for example).
+void mi_free_batch(void** ps, size_t count) mi_attr_noexcept {
+  if (ps == NULL) return;
+  const mi_threadid_t tid = _mi_prim_thread_id();
+  size_t i = 0;
+  while (i < count) {
+    void* const p = ps[i];
+    mi_segment_t* const segment = mi_checked_ptr_segment(p, "mi_free_batch");
+    if mi_unlikely(segment == NULL) { i++; continue; }
+    const bool is_local = (tid == mi_atomic_load_relaxed(&segment->thread_id));
+    if mi_unlikely(segment->kind == MI_SEGMENT_HUGE || (!is_local && mi_atomic_load_relaxed(&segment->thread_id) == 0)) {
+      // huge pages hold only one block, and abandoned segments may be reclaimed on free
+      mi_free(p);
+      i++;
+      continue;
+    }
+
+    // find the run of pointers into the same page
+    mi_page_t* const page = _mi_segment_page_of(segment, p);
+    size_t run = 1;
+    while (i + run < count) {
+      void* const q = ps[i + run];
+      if (q == NULL || _mi_ptr_segment(q) != segment || _mi_segment_page_of(segment, q) != page) break;
+      run++;
+    }
+    if (mi_page_is_monotonic(page)) { /* only released with the heap */ }
+    else if (is_local) { mi_free_batch_local(page, ps + i, run); }
+    else               { mi_free_batch_mt(page, ps + i, run); }
+    i += run;
+  }
+}
+
+
 // return true if successful
 bool _mi_free_delayed_block(mi_block_t* block) {
   // get segment and page
   mi_assert_internal(block!=NULL);
   const mi_segment_t* const segment = _mi_ptr_segment(block);
   mi_assert_internal(_mi_ptr_cookie(segment) == segment->cookie);
-  mi_assert_internal(_mi_thread_id() == segment->thread_id);
   mi_page_t* const page = _mi_segment_page_of(segment, block);
+  mi_assert_internal(_mi_thread_id() == segment->thread_id || _mi_heap_is_per_cpu(mi_page_heap(page)));
 
   // Clear the no-delayed flag so delayed freeing is used again for this page.
   // This must be done before collecting the free lists on this page -- otherwise
@@ -234,7 +385,7 @@ bool _mi_free_delayed_block(mi_block_t* block) {
 // Push a block that is owned by another thread on its page-local thread free
 // list or it's heap delayed free list. Such blocks are later collected by
 // the owning thread in `_mi_free_delayed_block`.
-static void mi_decl_noinline mi_free_block_delayed_mt( mi_page_t* page, mi_block_t* block )
+static void mi_decl_noinline mi_free_block_delayed_mt(mi_page_t* page, mi_block_t* block)
 {
   // Try to put the block on either the page-local thread free list,
   // or the heap delayed free list (if this is the first non-local free in that page)
@@ -324,22 +475,93 @@ static void mi_decl_noinline mi_free_block_mt(mi_page_t* page, mi_segment_t* seg
   }
   else {
     #if (MI_DEBUG>0) && !MI_TRACK_ENABLED  && !MI_TSAN       // note: when tracking, cannot use mi_usable_size with multi-threading
-    memset(block, MI_DEBUG_FREED, mi_usable_size(block));
+    if (!mi_page_is_objcache(page)) { memset(block, MI_DEBUG_FREED, mi_usable_size(block)); }
     #endif
   }
 
   // and finally free the actual block by pushing it on the owning heap
   // thread_delayed free list (or heap delayed free list)
+  if (segment->kind != MI_SEGMENT_HUGE && mi_free_remote_buffered(page, block)) return;
   mi_free_block_delayed_mt(page,block);
 }
 
 
+// ------------------------------------------------------
+// Buffered multi-threaded free
+//
+// When enabled for a thread, the frees of blocks owned by other
+// threads are chained per page in a small table in the thread
+// local data and published with a single CAS per chain. A chain is
+// published when it is full, when its entry is needed for another
+// page, on the next slow path allocation (`page.c:_mi_malloc_generic`),
+// on collect, and when the thread terminates. A buffered block keeps
+// its page alive as the page `used` count is not yet decreased, so
+// all chains are also published every `MI_REMOTE_FREE_FLUSH` buffered
+// frees (as a thread that only frees never takes the slow path).
+// ------------------------------------------------------
+
+static void mi_free_remote_flush_page(mi_remote_free_t* rf, mi_remote_free_page_t* rp) {
+  if (rp->page == NULL) return;
+  mi_assert_internal(rp->first != NULL && rp->count > 0 && rf->count >= rp->count);
+  mi_free_chain_mt(rp->page, rp->first, rp->last);
+  rf->count -= rp->count;
+  rp->page  = NULL;
+  rp->first = NULL;
+  rp->last  = NULL;
+  rp->count = 0;
+}
+
+void _mi_free_remote_flush(mi_tld_t* tld) {
+  mi_remote_free_t* const rf = &tld->remote_free;
+  rf->frees = 0;
+  if (rf->count == 0) return;
+  for (size_t i = 0; i < MI_REMOTE_FREE_PAGES; i++) {
+    mi_free_remote_flush_page(rf, &rf->pages[i]);
+  }
+  mi_assert_internal(rf->count == 0);
+}
+
+// Buffer the free of a (prepared) `block` in a page owned by another thread; returns `false` if not buffered.
+// Frees into pages of heaps that may be destroyed are never buffered, as the owner could destroy
+// the heap (and free the page) before the chain is published.
+static bool mi_free_remote_buffered(mi_page_t* page, mi_block_t* block) {
+  if (page->is_destroyable) return false;  // (constant for the lifetime of the page)
+  mi_heap_t* const heap = mi_prim_get_default_heap();
+  if (heap == (mi_heap_t*)&_mi_heap_empty) return false;  // not initialized or already done
+  mi_remote_free_t* const rf = &heap->tld->remote_free;
+  if mi_unlikely(rf->enabled == 0) {
+    rf->enabled = (mi_option_is_enabled(mi_option_remote_free_buffer) ? 1 : -1);  // cache the option for this thread
+  }
+  if mi_likely(rf->enabled < 0) return false;
+
+  const uintptr_t h = ((uintptr_t)page / sizeof(mi_page_t)) ^ ((uintptr_t)page >> MI_SEGMENT_SHIFT);
+  mi_remote_free_page_t* const rp = &rf->pages[h % MI_REMOTE_FREE_PAGES];
+  if (rp->page != page) {
+    mi_free_remote_flush_page(rf, rp);
+    rp->page = page;
+    rp->last = block;
+  }
+  mi_block_set_next(page, block, rp->first);
+  rp->first = block;
+  rp->count++;
+  rf->count++;
+  if (rp->count >= MI_REMOTE_FREE_BATCH) {
+    mi_free_remote_flush_page(rf, rp);
+  }
+  if mi_unlikely(++rf->frees >= MI_REMOTE_FREE_FLUSH) {
+    _mi_free_remote_flush(heap->tld);
+  }
+  return true;
+}
+
+
 // ------------------------------------------------------
 // Usable size
 // ------------------------------------------------------
 
 // Bytes available in a block
 static size_t mi_decl_noinline mi_page_usable_aligned_size_of(const mi_page_t* page, const void* p) mi_attr_noexcept {
+  if mi_unlikely(mi_page_is_monotonic(page)) return _mi_page_monotonic_usable_size(page, p);  // (always `has_aligned`)
   const mi_block_t* block = _mi_page_ptr_unalign(page, p);
   const bool is_guarded = mi_block_ptr_is_guarded(block,p);
   const size_t size = mi_page_usable_size_of(page, block, is_guarded);
@@ -400,6 +622,17 @@ void mi_free_aligned(void* p, size_t alignment) mi_attr_noexcept {
   mi_free(p);
 }
 
+// free a block allocated from a size class (see `mi_heap_malloc_sc`);
+// release builds need no size information so `sc` is only checked in debug mode.
+void mi_free_sc(void* p, mi_sizeclass_t sc) mi_attr_noexcept {
+  MI_UNUSED_RELEASE(sc);
+  #if MI_DEBUG
+  const mi_page_t* const page = mi_validate_ptr_page(p,"mi_free_sc");
+  mi_assert(p == NULL || page == NULL || _mi_usable_size(p,page) >= sc*MI_INTPTR_SIZE);
+  #endif
+  mi_free(p);
+}
+
 
 // ------------------------------------------------------
 // Check for double free in secure and debug mode
@@ -582,6 +815,22 @@ static void mi_stat_free(const mi_page_t* page, const mi_block_t* block) {
     mi_heap_stat_decrease(heap, malloc_huge, bsize);
   }
 }
+#elif (MI_STAT_LITE)
+static void mi_stat_free(const mi_page_t* page, const mi_block_t* block) {
+  MI_UNUSED(block);
+  mi_heap_t* const heap = mi_prim_get_default_heap();  // don't initialize the thread
+  const size_t bsize = mi_page_usable_block_size(page);
+  const bool is_huge = (bsize > MI_MEDIUM_OBJ_SIZE_MAX);
+  if mi_unlikely(!mi_heap_is_initialized(heap)) {
+    _mi_stats_lite_free_shared(bsize, is_huge);
+  }
+  else if mi_likely(!is_huge) {
+    mi_heap_stat_lite_add(heap, free_normal, bsize);
+  }
+  else {
+    mi_heap_stat_lite_add(heap, free_huge, bsize);
+  }
+}
 #else
 static void mi_stat_free(const mi_page_t* page, const mi_block_t* block) {
   MI_UNUSED(page); MI_UNUSED(block);
@@ -129,6 +129,13 @@ static void mi_heap_collect_ex(mi_heap_t* heap, mi_collect_t collect)
   const bool force = (collect >= MI_FORCE);
   _mi_deferred_free(heap, force);
 
+  // publish buffered frees of blocks owned by other threads (only if the heap belongs to this thread)
+  if (heap->thread_id == _mi_thread_id()) {
+    _mi_free_remote_flush(heap->tld);
+    // and re-determine the numa node of the thread as it may have migrated
+    if (heap->tld->segments.numa_bound < 0) { heap->tld->segments.numa_node = -1; }
+  }
+
   // python/cpython#112532: we may be called from a thread that is not the owner of the heap
   const bool is_main_thread = (_mi_is_main_thread() && heap->thread_id == _mi_thread_id());
 
@@ -241,6 +248,7 @@ void _mi_heap_init(mi_heap_t* heap, mi_tld_t* tld, mi_arena_id_t arena_id, bool
   heap->keys[0] = _mi_heap_random_next(heap);
   heap->keys[1] = _mi_heap_random_next(heap);
   _mi_heap_guarded_init(heap);
+  _mi_heap_profile_init(heap);
   // push on the thread local heaps list
   heap->next = heap->tld->heaps;
   heap->tld->heaps = heap;
@@ -264,10 +272,52 @@ mi_decl_nodiscard mi_heap_t* mi_heap_new(void) {
   return mi_heap_new_ex(0 /* default heap tag */, true /* no reclaim */, _mi_arena_id_none());
 }
 
+mi_decl_nodiscard mi_heap_t* mi_heap_new_on_numa(int numa_node) {
+  const int numa_count = _mi_os_numa_node_count();
+  if (numa_node >= numa_count) {
+    _mi_error_message(EINVAL, "cannot create a heap at numa node %i (there are only %i nodes)\n", numa_node, numa_count);
+    return NULL;
+  }
+  mi_heap_t* heap = mi_heap_new_ex(0 /* default heap tag */, true /* no reclaim */, _mi_arena_id_none());
+  if (heap == NULL) return NULL;
+  heap->numa_node = (numa_node < 0 ? -1 : numa_node);
+  return heap;
+}
+
+// Limit the total size of the pages of a heap. When the heap goes above the `soft_limit` it is collected and
+// the commit pressure handler is called; no fresh pages are allocated when it would go above the (hard) `limit`.
+void mi_heap_set_commit_limit(mi_heap_t* heap, size_t soft_limit, size_t limit) {
+  if (heap == NULL || !mi_heap_is_initialized(heap)) return;
+  heap->commit_soft_limit = soft_limit;
+  heap->commit_limit = limit;
+}
+
+void mi_heap_set_thp(mi_heap_t* heap, int thp) {
+  if (heap == NULL || !mi_heap_is_initialized(heap)) return;
+  heap->thp = (thp < 0 ? -1 : (thp > 0 ? 1 : 0));
+}
+
+mi_decl_nodiscard mi_heap_t* mi_heap_new_monotonic(void) {
+  mi_heap_t* heap = mi_heap_new_ex(0 /* default heap tag */, true /* no reclaim */, _mi_arena_id_none());
+  if (heap == NULL) return NULL;
+  heap->monotonic = true;
+  heap->bump_chunk_size = MI_MONOTONIC_CHUNK_MIN;
+  #if MI_GUARDED
+  mi_heap_guarded_set_sample_rate(heap, 0, 0);  // guarded objects need their own block
+  #endif
+  mi_heap_profile_set_sample_rate(heap, 0);       // blocks are never freed individually
+  return heap;
+}
+
 bool _mi_heap_memid_is_suitable(mi_heap_t* heap, mi_memid_t memid) {
   return _mi_arena_memid_is_suitable(memid, heap->arena_id);
 }
 
+// Return the numa node the heap must allocate from (or -1 if any node is fine)
+int _mi_heap_numa_node(mi_heap_t* heap) {
+  return (heap->numa_node >= 0 ? heap->numa_node : heap->tld->segments.numa_bound);
+}
+
 uintptr_t _mi_heap_random_next(mi_heap_t* heap) {
   return _mi_random_next(&heap->random);
 }
@@ -281,6 +331,9 @@ static void mi_heap_reset_pages(mi_heap_t* heap) {
   _mi_memcpy_aligned(&heap->pages, &_mi_heap_empty.pages, sizeof(heap->pages));
   heap->thread_delayed_free = NULL;
   heap->page_count = 0;
+  heap->pages_size = 0;
+  heap->stat_pages.current = 0;
+  heap->stat_pages_size.current = 0;
 }
 
 // called from `mi_heap_destroy` and `mi_heap_delete` to free the internal heap resources.
@@ -320,7 +373,7 @@ mi_heap_t* _mi_heap_by_tag(mi_heap_t* heap, uint8_t tag) {
     return heap;
   }
   for (mi_heap_t *curr = heap->tld->heaps; curr != NULL; curr = curr->next) {
-    if (curr->tag == tag) {
+    if (curr->tag == tag && !curr->monotonic) {
       return curr;
     }
   }
@@ -340,6 +393,11 @@ static bool _mi_heap_page_destroy(mi_heap_t* heap, mi_page_queue_t* pq, mi_page_
   // ensure no more thread_delayed_free will be added
   _mi_page_use_delayed_free(page, MI_NEVER_DELAYED_FREE, false);
 
+  // forget heap profile samples of blocks that are never freed
+  if mi_unlikely(mi_page_has_sampled(page)) {
+    _mi_heap_profile_page_destroy(page);
+  }
+
   // stats
   const size_t bsize = mi_page_block_size(page);
   if (bsize > MI_MEDIUM_OBJ_SIZE_MAX) {
@@ -458,6 +516,12 @@ static void mi_heap_absorb(mi_heap_t* heap, mi_heap_t* from) {
     from->page_count -= pcount;
   }
   mi_assert_internal(from->page_count == 0);
+  _mi_stat_increase(&heap->stat_pages, (size_t)from->stat_pages.current);
+  _mi_stat_increase(&heap->stat_pages_size, from->pages_size);
+  heap->pages_size += from->pages_size;
+  from->pages_size = 0;
+  from->stat_pages.current = 0;
+  from->stat_pages_size.current = 0;
 
   // and do outstanding delayed frees in the `from` heap
   // note: be careful here as the `heap` field in all those pages no longer point to `from`,
@@ -486,6 +550,13 @@ void mi_heap_delete(mi_heap_t* heap)
   mi_assert_expensive(mi_heap_is_valid(heap));
   if (heap==NULL || !mi_heap_is_initialized(heap)) return;
 
+  if (heap->monotonic) {
+    // objects in a monotonic heap are never freed individually; release all chunks
+    _mi_heap_destroy_pages(heap);
+    mi_heap_free(heap);
+    return;
+  }
+
   mi_heap_t* bheap = heap->tld->heap_backing;
   if (bheap != heap && mi_heaps_are_compatible(bheap,heap)) {
     // transfer still used pages to the backing heap
@@ -777,3 +848,63 @@ bool mi_unsafe_heap_page_is_under_utilized(mi_heap_t* heap, void* p, size_t perc
   if (perc_threshold>=100) return true;
   return (perc_threshold >= ((100UL*page->used) / page->capacity));
 }
+
+
+/* -----------------------------------------------------------
+  Defragmentation
+  `mi_heap_defrag_begin` marks the under-utilized pages of a heap as sparse. Until `mi_heap_defrag_end`
+  no allocations are made in sparse pages, so objects that are moved (reallocated and freed) by the
+  program empty them out and the pages can be returned to the OS.
+----------------------------------------------------------- */
+
+static bool mi_heap_page_defrag_is_sparse(mi_page_t* page, size_t perc_threshold) {
+  _mi_page_free_collect(page, false);  // so `used` is up to date (including blocks freed by other threads)
+  // pages that can still be extended are fresh and never sparse
+  return (page->used > 0 && page->capacity == page->reserved &&
+          page->used < page->capacity && (100*(size_t)page->used) <= perc_threshold*page->capacity);
+}
+
+static bool mi_heap_page_defrag_clear(mi_heap_t* heap, mi_page_queue_t* pq, mi_page_t* page, void* arg1, void* arg2) {
+  MI_UNUSED(heap); MI_UNUSED(pq); MI_UNUSED(arg1); MI_UNUSED(arg2);
+  if (page->is_sparse) { _mi_page_set_sparse(page, false); }
+  return true;
+}
+
+// Start defragmentation of a heap by marking pages with at most `perc_threshold` percent used blocks as sparse.
+// Sparse pages move to the end of their queue so they are not allocated in. Returns the number of sparse pages.
+size_t mi_heap_defrag_begin(mi_heap_t* heap, size_t perc_threshold) mi_attr_noexcept {
+  if (heap==NULL) { heap = mi_prim_get_default_heap(); }
+  if (heap==NULL || !mi_heap_is_initialized(heap)) return 0;
+  _mi_heap_delayed_free_all(heap);  // full pages with blocks freed by other threads move back to their queue
+  size_t count = 0;
+  for (size_t i = 0; i <= MI_BIN_FULL; i++) {
+    // including the full pages, as other threads may have freed many of their blocks
+    mi_page_queue_t* pq = &heap->pages[i];
+    mi_page_t* const last = pq->last;  // sparse pages move behind it and are not visited again
+    mi_page_t* page = pq->first;
+    while (page != NULL) {
+      mi_page_t* const next = page->next;
+      const bool is_sparse = mi_heap_page_defrag_is_sparse(page, perc_threshold);
+      if (is_sparse) { count++; }
+      if (is_sparse != page->is_sparse) { _mi_page_set_sparse(page, is_sparse); }
+      if (page == last) break;
+      page = next;
+    }
+  }
+  return count;
+}
+
+// End defragmentation: sparse pages can be allocated in again.
+void mi_heap_defrag_end(mi_heap_t* heap) mi_attr_noexcept {
+  if (heap==NULL) { heap = mi_prim_get_default_heap(); }
+  if (heap==NULL || !mi_heap_is_initialized(heap)) return;
+  mi_heap_visit_pages(heap, &mi_heap_page_defrag_clear, true, NULL, NULL);
+}
+
+// Should the object at `p` be moved? This is the case if its page is sparse.
+// Should be called by the thread that owns the heap of `p`.
+bool mi_defrag_should_move(const void* p) mi_attr_noexcept {
+  if (p==NULL) return false;
+  const mi_page_t* const page = mi_safe_ptr_page((void*)p);
+  return (page!=NULL && page->is_sparse);
+}
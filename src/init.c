@@ -15,17 +15,19 @@ terms of the MIT license. A copy of the license can be found in the file
 // Empty page used to initialize the small free pages array
 const mi_page_t _mi_page_empty = {
   0,
-  false, false, false, false,
+  false, false, false, false, false,
   0,       // capacity
   0,       // reserved capacity
   { 0 },   // flags
   false,   // is_zero
+  false,   // is_bump
   0,       // retire_expire
   NULL,    // free
   NULL,    // local_free
   0,       // used
   0,       // block size shift
   0,       // heap tag
+  false,   // is_destroyable
   0,       // block_size
   NULL,    // page_start
   #if (MI_PADDING || MI_ENCODE_FREELIST)
@@ -33,8 +35,8 @@ const mi_page_t _mi_page_empty = {
   #endif
   MI_ATOMIC_VAR_INIT(0), // xthread_free
   MI_ATOMIC_VAR_INIT(0), // xheap
-  NULL, NULL
-  , { 0 }  // padding
+  NULL, NULL,
+  NULL     // objcache
 };
 
 #define MI_PAGE_EMPTY() ((mi_page_t*)&_mi_page_empty)
@@ -86,7 +88,9 @@ const mi_page_t _mi_page_empty = {
   { { 0 }, { 0 }, { 0 }, { 0 } }, \
   \
   { MI_INIT74(MI_STAT_COUNT_NULL) }, \
-  { MI_INIT74(MI_STAT_COUNT_NULL) }
+  { MI_INIT74(MI_STAT_COUNT_NULL) }, \
+  { { { 0 } } }, \
+  { { { 0 } } }
 
 
 // Empty slice span queues for every bin
@@ -113,20 +117,31 @@ mi_decl_cache_align const mi_heap_t _mi_heap_empty = {
   NULL,
   MI_ATOMIC_VAR_INIT(NULL),
   0,                // tid
-  0,                // cookie
   0,                // arena id
+  -1,               // numa node
+  -1,               // thp
+  0,                // cookie
   { 0, 0 },         // keys
   { {0}, {0}, 0, true }, // random
   0,                // page count
   MI_BIN_FULL, 0,   // page retired min/max
   0,                // pages_full_size
+  0, 0, 0,          // pages size, commit soft limit and limit
+  { 0, 0, 0 }, { 0, 0, 0 }, // page stats
   0, 0,             // generic count
   NULL,             // next
   false,            // can reclaim
   0,                // tag
+  false,            // monotonic
+  false,            // commit pressure
+  NULL,             // objcache
+  NULL, NULL, NULL, 0,  // bump chunk/next/end/chunk size
   #if MI_GUARDED
   0, 0, 0, 1,       // count is 1 so we never write to it (see `internal.h:mi_heap_malloc_use_guarded`)
   #endif
+  #if MI_HEAP_PROFILE
+  0, PTRDIFF_MAX,   // we never sample from the empty heap (see `internal.h:mi_heap_profile_count`)
+  #endif
   MI_SMALL_PAGES_EMPTY,
   MI_PAGE_QUEUES_EMPTY
 };
@@ -139,8 +154,11 @@ mi_decl_cache_align static const mi_tld_t tld_empty = {
   0,
   false,
   NULL, NULL,
-  { MI_SEGMENT_SPAN_QUEUES_EMPTY, 0, 0, 0, 0, 0, &mi_subproc_default, tld_empty_stats }, // segments
-  { sizeof(mi_stats_t), MI_STAT_VERSION, MI_STATS_NULL }       // stats
+  { MI_SEGMENT_SPAN_QUEUES_EMPTY, 0, 0, 0, 0, 0, &mi_subproc_default, tld_empty_stats, NULL, -1, -1, 0 }, // segments
+  { sizeof(mi_stats_t), MI_STAT_VERSION, MI_STATS_NULL },      // stats
+  NULL,                                                        // stats_lite
+  { 0, 0, 0, { { NULL, NULL, NULL, 0 } } },                    // remote_free
+  NULL                                                         // trace
 };
 
 mi_threadid_t _mi_thread_id(void) mi_attr_noexcept {
@@ -157,28 +175,42 @@ extern mi_decl_hidden mi_heap_t _mi_heap_main;
 static mi_decl_cache_align mi_tld_t tld_main = {
   0, false,
   &_mi_heap_main, & _mi_heap_main,
-  { MI_SEGMENT_SPAN_QUEUES_EMPTY, 0, 0, 0, 0, 0, &mi_subproc_default, &tld_main.stats }, // segments
-  { sizeof(mi_stats_t), MI_STAT_VERSION, MI_STATS_NULL }       // stats
+  { MI_SEGMENT_SPAN_QUEUES_EMPTY, 0, 0, 0, 0, 0, &mi_subproc_default, &tld_main.stats, &_mi_stats_lite_main, -1, -1, 0 }, // segments
+  { sizeof(mi_stats_t), MI_STAT_VERSION, MI_STATS_NULL },      // stats
+  &_mi_stats_lite_main,                                        // stats_lite
+  { 0, 0, 0, { { NULL, NULL, NULL, 0 } } },                    // remote_free
+  NULL                                                         // trace
 };
 
 mi_decl_cache_align mi_heap_t _mi_heap_main = {
   &tld_main,
   MI_ATOMIC_VAR_INIT(NULL),
   0,                // thread id
-  0,                // initial cookie
   0,                // arena id
+  -1,               // numa node
+  -1,               // thp
+  0,                // initial cookie
   { 0, 0 },         // the key of the main heap can be fixed (unlike page keys that need to be secure!)
   { {0x846ca68b}, {0}, 0, true },  // random
   0,                // page count
   MI_BIN_FULL, 0,   // page retired min/max
   0,                // pages_full_size
+  0, 0, 0,          // pages size, commit soft limit and limit
+  { 0, 0, 0 }, { 0, 0, 0 }, // page stats
   0, 0,             // generic count
   NULL,             // next heap
   false,            // can reclaim
   0,                // tag
+  false,            // monotonic
+  false,            // commit pressure
+  NULL,             // objcache
+  NULL, NULL, NULL, 0,  // bump chunk/next/end/chunk size
   #if MI_GUARDED
   0, 0, 0, 0,
   #endif
+  #if MI_HEAP_PROFILE
+  0, PTRDIFF_MAX,
+  #endif
   MI_SMALL_PAGES_EMPTY,
   MI_PAGE_QUEUES_EMPTY
 };
@@ -186,6 +218,7 @@ mi_decl_cache_align mi_heap_t _mi_heap_main = {
 bool _mi_process_is_initialized = false;  // set to `true` in `mi_process_init`.
 
 mi_stats_t _mi_stats_main = { sizeof(mi_stats_t), MI_STAT_VERSION, MI_STATS_NULL };
+mi_stats_lite_t _mi_stats_lite_main = { NULL, MI_ATOMIC_VAR_INIT(1), 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };  // owned by the main thread
 
 #if MI_GUARDED
 mi_decl_export void mi_heap_guarded_set_sample_rate(mi_heap_t* heap, size_t sample_rate, size_t seed) {
@@ -229,6 +262,7 @@ void _mi_heap_guarded_init(mi_heap_t* heap) {
 static void mi_heap_main_init(void) {
   if (_mi_heap_main.cookie == 0) {
     _mi_heap_main.thread_id = _mi_thread_id();
+    tld_main.segments.thread_id = _mi_heap_main.thread_id;
     _mi_heap_main.cookie = 1;
     #if defined(_WIN32) && !defined(MI_SHARED_LIB)
       _mi_random_init_weak(&_mi_heap_main.random);    // prevent allocation failure during bcrypt dll initialization with static linking
@@ -241,6 +275,7 @@ static void mi_heap_main_init(void) {
     mi_lock_init(&mi_subproc_default.abandoned_os_lock);
     mi_lock_init(&mi_subproc_default.abandoned_os_visit_lock);
     _mi_heap_guarded_init(&_mi_heap_main);
+    _mi_heap_profile_init(&_mi_heap_main);
   }
 }
 
@@ -411,12 +446,18 @@ void _mi_tld_init(mi_tld_t* tld, mi_heap_t* bheap) {
   tld->heaps = NULL;
   tld->segments.subproc = &mi_subproc_default;
   tld->segments.stats = &tld->stats;
+  tld->stats_lite = _mi_stats_lite_claim();
+  tld->segments.stats_lite = tld->stats_lite;
+  tld->segments.thread_id = _mi_thread_id();
 }
 
 // Free the thread local default heap (called from `mi_thread_done`)
 static bool _mi_thread_heap_done(mi_heap_t* heap) {
   if (!mi_heap_is_initialized(heap)) return true;
 
+  // publish any buffered frees of other threads' blocks
+  _mi_free_remote_flush(heap->tld);
+
   // reset default heap
   _mi_heap_set_default_direct(_mi_is_main_thread() ? &_mi_heap_main : (mi_heap_t*)&_mi_heap_empty);
 
@@ -447,6 +488,8 @@ static bool _mi_thread_heap_done(mi_heap_t* heap) {
 
   // free if not the main thread
   if (heap != &_mi_heap_main) {
+    _mi_stats_lite_release(heap->tld->stats_lite);
+    _mi_trace_release(heap->tld);
     // the following assertion does not always hold for huge segments as those are always treated
     // as abandoned: one may allocate it in one thread, but deallocate in another in which case
     // the count can be too large or negative. todo: perhaps not count huge segments? see issue #363
@@ -514,6 +557,7 @@ void mi_thread_init(void) mi_attr_noexcept
 
   _mi_stat_increase(&_mi_stats_main.threads, 1);
   mi_atomic_increment_relaxed(&thread_count);
+  mi_usdt_probe1(thread_init, _mi_thread_id());
   //_mi_verbose_message("thread init: 0x%zx\n", _mi_thread_id());
 }
 
@@ -537,6 +581,7 @@ void _mi_thread_done(mi_heap_t* heap)
   // adjust stats
   mi_atomic_decrement_relaxed(&thread_count);
   _mi_stat_decrease(&_mi_stats_main.threads, 1);
+  mi_usdt_probe1(thread_done, heap->thread_id);
 
   // check thread-id as on Windows shutdown with FLS the main (exit) thread may call this on thread-local heaps...
   if (heap->thread_id != _mi_thread_id()) return;
@@ -566,6 +611,165 @@ void mi_thread_set_in_threadpool(void) mi_attr_noexcept {
   // nothing
 }
 
+void mi_thread_set_remote_free_buffered(bool enable) mi_attr_noexcept {
+  mi_heap_t* heap = mi_heap_get_default();  // ensure the thread is initialized
+  if (!mi_heap_is_initialized(heap)) return;
+  heap->tld->remote_free.enabled = (enable ? 1 : -1);
+  if (!enable) { _mi_free_remote_flush(heap->tld); }
+}
+
+bool mi_thread_set_numa_node(int numa_node) mi_attr_noexcept {
+  const int numa_count = _mi_os_numa_node_count();
+  if (numa_node >= numa_count) {
+    _mi_error_message(EINVAL, "cannot bind the thread to numa node %i (there are only %i nodes)\n", numa_node, numa_count);
+    return false;
+  }
+  mi_heap_t* heap = mi_heap_get_default();  // ensure the thread is initialized
+  if (!mi_heap_is_initialized(heap)) return false;
+  mi_segments_tld_t* tld = &heap->tld->segments;
+  tld->numa_bound = (numa_node < 0 ? -1 : numa_node);
+  tld->numa_node  = tld->numa_bound;   // re-determined on demand if unbound
+  return true;
+}
+
+// --------------------------------------------------------
+// Per-cpu heaps
+// With `mi_option_cpu_heaps` enabled, threads do not get their own
+// heap but allocate from a heap that is shared by all threads on the
+// same cpu: the allocation fast path (`alloc.c:_mi_page_malloc_zero`)
+// of a thread without a heap goes directly to `_mi_cpu_heap_malloc`.
+// A thread first claims the heap of its cpu with a restartable sequence
+// that only commits on that cpu (see `prim.c:_mi_prim_cpu_claim`) so no
+// atomic operation is needed; the claim is only contended if the owner
+// was preempted or migrated. Restartable sequences are only available
+// on Linux x86-64 (with glibc 2.35+); on other platforms the option is
+// ignored (with a warning) as a global atomic claim would be contended
+// by every thread that migrates.
+// Frees of blocks in the heap of the current cpu are local (under the
+// claim), while other frees go through the `xthread_free` list as a
+// per-cpu heap has a unique owner id.
+// Threads that use a heap explicitly (like `mi_heap_get_default`), or
+// that re-enter the allocator while they hold a claim (like in a
+// deferred free callback), get their own heap.
+// --------------------------------------------------------
+
+#define MI_CPU_HEAPS_MAX    (1024)
+
+typedef struct mi_cpu_heap_s {
+  _Atomic(uintptr_t) claimed;     // 1 if a thread uses this heap
+  mi_heap_t  heap;
+  mi_tld_t   tld;
+} mi_cpu_heap_t;
+
+static _Atomic(mi_cpu_heap_t*) mi_cpu_heaps;  // = NULL
+static size_t         mi_cpu_heap_count;      // larger than any cpu id
+static bool           mi_cpu_heaps_unsupported;
+mi_decl_hidden bool   _mi_cpu_heaps_active;   // initialized and enabled? (checked on the allocation fast path)
+static mi_decl_thread bool mi_cpu_heap_held;  // does the current thread hold a claim? (to detect re-entrancy)
+
+static bool mi_cpu_heaps_init(void) {
+  if (!mi_option_is_enabled(mi_option_cpu_heaps) || mi_cpu_heaps_unsupported) return false;
+  if (mi_atomic_load_ptr_acquire(mi_cpu_heap_t, &mi_cpu_heaps) != NULL) return true;
+  const int cpu = _mi_prim_cpu_id();
+  size_t count = _mi_prim_cpu_count();
+  if (cpu >= 0 && count <= (size_t)cpu) { count = (size_t)cpu + 1; }
+  // each cpu needs its own heap as the restartable claim only excludes threads on the same cpu
+  _Atomic(uintptr_t) dummy = 0;
+  if (cpu < 0 || count > MI_CPU_HEAPS_MAX || _mi_prim_cpu_claim(&dummy, cpu) < 0) {
+    mi_cpu_heaps_unsupported = true;
+    _mi_warning_message("per-cpu heaps are not supported on this platform (as they need restartable sequences)\n");
+    return false;
+  }
+  mi_memid_t memid;
+  mi_cpu_heap_t* heaps = (mi_cpu_heap_t*)_mi_os_zalloc(count * sizeof(mi_cpu_heap_t), &memid);
+  if (heaps == NULL) return false;
+  // concurrent initializers write the same values
+  mi_cpu_heap_count = count;
+  mi_cpu_heap_t* expected = NULL;
+  if (!mi_atomic_cas_ptr_strong_acq_rel(mi_cpu_heap_t, &mi_cpu_heaps, &expected, heaps)) {
+    _mi_os_free(heaps, count * sizeof(mi_cpu_heap_t), memid);
+    return true;
+  }
+  _mi_verbose_message("using %zu per-cpu heaps\n", count);
+  return true;
+}
+
+// Should threads that did not allocate yet use per-cpu heaps? (the option can be changed while running)
+bool _mi_cpu_heaps_enabled(void) {
+  if mi_likely(!mi_option_is_enabled(mi_option_cpu_heaps)) return false;
+  if mi_unlikely(mi_atomic_load_ptr_relaxed(mi_cpu_heap_t, &mi_cpu_heaps) == NULL && !mi_cpu_heaps_init()) return false;
+  if (!_mi_cpu_heaps_active) { _mi_cpu_heaps_active = true; }
+  return true;
+}
+
+// Called from `options.c:mi_option_set`
+void _mi_cpu_heaps_option_changed(bool enable) {
+  // stop using the fast path right away; it is re-enabled on the next allocation in `_mi_malloc_generic`
+  if (!enable) { _mi_cpu_heaps_active = false; }
+}
+
+static bool mi_cpu_heap_try_claim(mi_cpu_heap_t* ch, int cpu) {
+  return (_mi_prim_cpu_claim(&ch->claimed, cpu) > 0);
+}
+
+// Claim the heap of the current cpu; must be released with `_mi_cpu_heap_release`.
+// Returns NULL if the current thread already holds a claim (i.e. we re-entered the allocator),
+// or if the current cpu has no heap.
+mi_heap_t* _mi_cpu_heap_acquire(void) {
+  mi_cpu_heap_t* const heaps = mi_atomic_load_ptr_acquire(mi_cpu_heap_t, &mi_cpu_heaps);
+  mi_assert_internal(heaps != NULL);
+  if mi_unlikely(mi_cpu_heap_held) return NULL;
+  mi_cpu_heap_t* ch = NULL;
+  size_t ticks = 0;
+  while (ch == NULL) {
+    const int cpu = _mi_prim_cpu_id();
+    if mi_unlikely(cpu < 0 || (size_t)cpu >= mi_cpu_heap_count) return NULL;  // a cpu that came online later
+    if mi_likely(mi_cpu_heap_try_claim(&heaps[cpu], cpu)) {
+      ch = &heaps[cpu];
+    }
+    else {
+      // wait for the owner (or we were just preempted or migrated)
+      mi_atomic_yield_sleep(&ticks, 10);
+    }
+  }
+  mi_cpu_heap_held = true;
+  mi_heap_t* const heap = &ch->heap;
+  if mi_unlikely(heap->tld == NULL) {
+    // initialize on first use
+    _mi_tld_init(&ch->tld, heap);
+    _mi_heap_init(heap, &ch->tld, _mi_arena_id_none(), false /* can reclaim */, 0 /* default tag */);
+    heap->thread_id = (mi_threadid_t)heap;  // unique owner id that never matches a thread id (see `_mi_heap_is_per_cpu`)
+    ch->tld.segments.thread_id = heap->thread_id;
+  }
+  mi_assert_internal(_mi_heap_is_per_cpu(heap));
+  return heap;
+}
+
+// Claim the per-cpu heap with owner id `owner` if it is the heap of the current cpu (for a local free).
+// Returns NULL if `owner` is not a per-cpu heap, if it belongs to another cpu, or if it is in use.
+mi_heap_t* _mi_cpu_heap_try_acquire_owner(mi_threadid_t owner) {
+  mi_cpu_heap_t* const heaps = mi_atomic_load_ptr_acquire(mi_cpu_heap_t, &mi_cpu_heaps);
+  if (heaps == NULL || mi_cpu_heap_held) return NULL;
+  if (owner < (uintptr_t)&heaps[0].heap) return NULL;
+  const uintptr_t ofs = owner - (uintptr_t)&heaps[0].heap;
+  const size_t idx = ofs / sizeof(mi_cpu_heap_t);
+  if (idx >= mi_cpu_heap_count || (ofs % sizeof(mi_cpu_heap_t)) != 0) return NULL;
+  const int cpu = _mi_prim_cpu_id();
+  if (cpu < 0 || (size_t)cpu != idx) return NULL;
+  mi_cpu_heap_t* const ch = &heaps[idx];
+  if (!mi_cpu_heap_try_claim(ch, cpu)) return NULL;
+  mi_cpu_heap_held = true;
+  return &ch->heap;
+}
+
+void _mi_cpu_heap_release(mi_heap_t* heap) {
+  mi_assert_internal(_mi_heap_is_per_cpu(heap));
+  mi_assert_internal(mi_cpu_heap_held);
+  mi_cpu_heap_t* const ch = (mi_cpu_heap_t*)((uint8_t*)heap - offsetof(mi_cpu_heap_t, heap));
+  mi_cpu_heap_held = false;
+  mi_atomic_store_release(&ch->claimed, (uintptr_t)0);
+}
+
 // --------------------------------------------------------
 // Run functions on process init/done, and thread init/done
 // --------------------------------------------------------
@@ -635,6 +839,7 @@ static void mi_process_init_once(void) mi_attr_noexcept {
   _mi_os_init();
   mi_heap_main_init();
   mi_thread_init();
+  _mi_cpu_heaps_enabled();  // initializes the per-cpu heaps if enabled
 
   #if defined(_WIN32)
   // On windows, when building as a static lib the FLS cleanup happens to early for the main thread.
@@ -645,6 +850,7 @@ static void mi_process_init_once(void) mi_attr_noexcept {
 
   mi_stats_reset();  // only call stat reset *after* thread init (or the heap tld == NULL)
   mi_track_init();
+  _mi_heap_profile_process_init();
 
   if (mi_option_is_enabled(mi_option_reserve_huge_os_pages)) {
     size_t pages = mi_option_get_clamp(mi_option_reserve_huge_os_pages, 0, 128*1024);
@@ -690,6 +896,9 @@ static void mi_process_done_once(void) {
   // release any thread specific resources and ensure _mi_thread_done is called on all but the main thread
   _mi_prim_thread_done_auto_done();
 
+  // stop the purge thread (further purges are done by this thread)
+  _mi_purge_thread_done();
+
 
   #ifndef MI_SKIP_COLLECT_ON_EXIT
     #if (MI_DEBUG || !defined(MI_SHARED_LIB))
@@ -0,0 +1,133 @@
+/* ----------------------------------------------------------------------------
+Copyright (c) 2018-2024, Microsoft Research, Daan Leijen
+This is free software; you can redistribute it and/or modify it under the
+terms of the MIT license. A copy of the license can be found in the file
+"LICENSE" at the root of this distribution.
+-----------------------------------------------------------------------------*/
+
+/* -----------------------------------------------------------
+  Object caches
+
+  An object cache allocates constructed objects of a fixed size
+  from its own heap. Each block starts with a small header that
+  holds the free list link (so a free never overwrites the object),
+  followed by the object itself. The heap and each of its pages
+  point to the object cache (`mi_heap_t.objcache` and
+  `mi_page_t.objcache`), so other heaps (even with the same tag)
+  are never affected.
+
+  The constructor runs when a block is carved from a page, i.e.
+  when a page extends its capacity (`page.c:mi_page_extend_free`
+  or `alloc.c:mi_page_bump_block`), and the destructor runs on all
+  carved blocks when the page is returned to its segment
+  (`segment.c:mi_segment_page_clear`). As the object cache is kept
+  in the page, the destructor also runs when an abandoned page is
+  eventually freed by another thread. On `mi_objcache_delete` the
+  destructor runs on all carved blocks of the pages of the heap
+  (which are then no longer object cache pages), so it does not
+  depend on `mi_heap_destroy` (which is `mi_heap_delete` in guarded
+  builds).
+----------------------------------------------------------- */
+
+#include "mimalloc.h"
+#include "mimalloc/internal.h"
+#include "mimalloc/atomic.h"
+
+#define MI_OBJCACHE_HEADER  (MI_MAX_ALIGN_SIZE)   // keep objects aligned
+
+struct mi_objcache_s {
+  mi_heap_t*        heap;     // heap with a unique tag
+  size_t            size;     // object size
+  mi_objcache_fun*  ctor;
+  mi_objcache_fun*  dtor;
+  void*             arg;
+};
+
+static uint8_t* mi_page_object_at(const mi_page_t* page, size_t idx) {
+  return (mi_page_start(page) + (idx * mi_page_block_size(page)) + MI_OBJCACHE_HEADER);
+}
+
+// Construct the objects in `count` freshly carved blocks starting at block index `start`.
+void _mi_objcache_page_carve(mi_page_t* page, size_t start, size_t count) {
+  const mi_objcache_t* const oc = page->objcache;
+  if (oc == NULL || oc->ctor == NULL) return;
+  mi_assert_internal(start + count <= page->capacity);
+  page->free_is_zero = false;  // the free blocks are constructed now
+  for (size_t i = start; i < start + count; i++) {
+    uint8_t* const obj = mi_page_object_at(page, i);
+    mi_track_mem_undefined(obj, oc->size);
+    oc->ctor(obj, oc->arg);
+  }
+}
+
+// Destruct the objects in all carved blocks of a page that is returned to the segment.
+void _mi_objcache_page_free(mi_page_t* page) {
+  const mi_objcache_t* const oc = page->objcache;
+  if (oc == NULL || oc->dtor == NULL) return;
+  for (size_t i = 0; i < page->capacity; i++) {
+    uint8_t* const obj = mi_page_object_at(page, i);
+    mi_track_mem_defined(obj, oc->size);
+    oc->dtor(obj, oc->arg);
+  }
+}
+
+mi_objcache_t* mi_objcache_new(int heap_tag, size_t size, mi_objcache_fun* ctor, mi_objcache_fun* dtor, void* arg) {
+  if (heap_tag <= 0 || heap_tag >= MI_HEAP_TAG_COUNT) {
+    _mi_error_message(EINVAL, "an object cache needs a non-default heap tag (tag %i)\n", heap_tag);
+    return NULL;
+  }
+  if (size > PTRDIFF_MAX - MI_OBJCACHE_HEADER - MI_PADDING_SIZE) {
+    _mi_error_message(EOVERFLOW, "object cache object size is too large (size %zu)\n", size);
+    return NULL;
+  }
+  mi_heap_t* const heap = mi_heap_new_ex(heap_tag, true /* allow destroy */, _mi_arena_id_none());
+  if (heap == NULL) return NULL;
+  #if MI_GUARDED
+  mi_heap_guarded_set_sample_rate(heap, 0, 0);  // guarded blocks are not carved from the cache pages
+  #endif
+  mi_objcache_t* const oc = mi_heap_malloc_tp(heap->tld->heap_backing, mi_objcache_t);
+  if (oc == NULL) {
+    mi_heap_delete(heap);
+    return NULL;
+  }
+  oc->heap = heap;
+  oc->size = size;
+  oc->ctor = ctor;
+  oc->dtor = dtor;
+  oc->arg  = arg;
+  heap->objcache = oc;  // before any page is allocated in this heap
+  return oc;
+}
+
+void mi_objcache_delete(mi_objcache_t* oc) {
+  if (oc == NULL) return;
+  mi_heap_t* const heap = oc->heap;
+  mi_assert_internal(heap->objcache == oc);
+  // destruct all carved blocks (also the ones still in use) and detach the pages from the object cache
+  for (size_t i = 0; i <= MI_BIN_FULL; i++) {
+    for (mi_page_t* page = heap->pages[i].first; page != NULL; page = page->next) {
+      mi_assert_internal(page->objcache == oc);
+      _mi_objcache_page_free(page);
+      page->objcache = NULL;
+    }
+  }
+  heap->objcache = NULL;
+  mi_heap_destroy(heap);
+  mi_free(oc);
+}
+
+mi_decl_nodiscard mi_decl_restrict void* mi_objcache_alloc(mi_objcache_t* oc) mi_attr_noexcept {
+  mi_assert(oc != NULL);
+  uint8_t* const block = (uint8_t*)mi_heap_malloc(oc->heap, MI_OBJCACHE_HEADER + oc->size);
+  if (block == NULL) return NULL;
+  mi_assert_internal(_mi_ptr_page(block)->objcache == oc);
+  return (block + MI_OBJCACHE_HEADER);
+}
+
+void mi_objcache_free(mi_objcache_t* oc, void* p) mi_attr_noexcept {
+  MI_UNUSED(oc);
+  if (p == NULL) return;
+  uint8_t* const block = (uint8_t*)p - MI_OBJCACHE_HEADER;
+  mi_assert(oc == NULL || _mi_ptr_page(block)->objcache == oc);
+  mi_free(block);
+}
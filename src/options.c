@@ -169,13 +169,28 @@ static mi_option_desc_t options[_mi_option_last] =
   { 0,   UNINIT, MI_OPTION(target_segments_per_thread) }, // abandon segments beyond this point, or 0 to disable.
   { 10000, UNINIT, MI_OPTION(generic_collect) },          // collect heaps every N (=10000) generic allocation calls
   { MI_DEFAULT_ALLOW_THP,
-         UNINIT, MI_OPTION(allow_thp) }                 // allow transparent huge pages?
+         UNINIT, MI_OPTION(allow_thp) },                // allow transparent huge pages?
+  { 0,   UNINIT, MI_OPTION(page_bump) },                // bump allocate fresh blocks in a page (instead of extending the free list)
+  { 0,   UNINIT, MI_OPTION(remap_threshold) },          // allocate huge blocks of at least N KiB in a remappable area (=0, disabled) (use `option_get_size`)
+  { 0,   UNINIT, MI_OPTION(remote_free_buffer) },       // buffer frees of blocks owned by other threads (see `mi_thread_set_remote_free_buffered`)
+  { 0,   UNINIT, MI_OPTION(cpu_heaps) },                // allocate from per-cpu heaps (see `init.c:_mi_cpu_heap_acquire`)
+  { 0,   UNINIT, MI_OPTION(commit_limit) },             // fail to commit above N KiB (=0, no limit) (use `option_get_size`)
+  { 0,   UNINIT, MI_OPTION(commit_soft_limit) },        // signal commit pressure above N KiB (=0, no limit) (use `option_get_size`)
+  { 512, UNINIT, MI_OPTION(heap_profile_rate) },        // only used when building with MI_HEAP_PROFILE: sample once per N KiB allocated (use `option_get_size`)
+  { 0,   UNINIT, MI_OPTION(latency_stats) },            // record latency histograms of slow paths (see `stats.c:_mi_stat_latency_record`)
+  { 0,   UNINIT, MI_OPTION(trace_events) },             // events per thread in the flight recorder (see `trace.c`)
+  { 0,   UNINIT, MI_OPTION(trace_dump_on_error) },      // file descriptor to dump the flight recorder to on an error
+  { 0,   UNINIT, MI_OPTION(purge_thread) },             // do delayed purges on a background thread (see `purge.c`)
+  { 0,   UNINIT, MI_OPTION(purge_adaptive) },           // adapt the purge delay to observed reuse (see `purge.c:_mi_purge_delay_adapt`)
+  { 1,   UNINIT, MI_OPTION(purge_delay_min) },          // lower bound of an adaptive purge delay (multiplied by `arena_purge_mult` for arenas)
+  { 1000,UNINIT, MI_OPTION(purge_delay_max) }           // upper bound of an adaptive purge delay (multiplied by `arena_purge_mult` for arenas)
 };
 
 static void mi_option_init(mi_option_desc_t* desc);
 
 static bool mi_option_has_size_in_kib(mi_option_t option) {
-  return (option == mi_option_reserve_os_memory || option == mi_option_arena_reserve);
+  return (option == mi_option_reserve_os_memory || option == mi_option_arena_reserve || option == mi_option_remap_threshold ||
+          option == mi_option_commit_limit || option == mi_option_commit_soft_limit || option == mi_option_heap_profile_rate);
 }
 
 void _mi_options_init(void) {
@@ -291,6 +306,9 @@ void mi_option_set(mi_option_t option, long value) {
   else if (desc->option == mi_option_guarded_max && _mi_option_get_fast(mi_option_guarded_min) > value) {
     mi_option_set(mi_option_guarded_min, value);
   }
+  else if (desc->option == mi_option_cpu_heaps) {
+    _mi_cpu_heaps_option_changed(value != 0);
+  }
 }
 
 void mi_option_set_default(mi_option_t option, long value) {
@@ -587,6 +605,8 @@ void _mi_error_message(int err, const char* fmt, ...) {
   va_start(args, fmt);
   mi_show_error_message(fmt, args);
   va_end(args);
+  // record it in the flight recorder (and dump it if requested)
+  _mi_trace_error(err);
   // and call the error handler which may abort (or return normally)
   if (mi_error_handler != NULL) {
     mi_error_handler(err, mi_atomic_load_ptr_acquire(void,&mi_error_arg));
@@ -40,7 +40,8 @@ static mi_os_mem_config_t mi_os_mem_config = {
   MI_DEFAULT_VIRTUAL_ADDRESS_BITS,
   true,     // has overcommit?  (if true we use MAP_NORESERVE on mmap systems)
   false,    // can we partially free allocated blocks? (on mmap systems we can free anywhere in a mapped range, but on Windows we must free the entire span)
-  true      // has virtual reserve? (if true we can reserve virtual address space without using commit or physical memory)
+  true,     // has virtual reserve? (if true we can reserve virtual address space without using commit or physical memory)
+  false     // has remap? (if true we can move and resize committed memory, e.g. using `mremap`)
 };
 
 bool _mi_os_has_overcommit(void) {
@@ -51,6 +52,10 @@ bool _mi_os_has_virtual_reserve(void) {
   return mi_os_mem_config.has_virtual_reserve;
 }
 
+bool _mi_os_has_remap(void) {
+  return mi_os_mem_config.has_remap;
+}
+
 
 // OS (small) page size
 size_t _mi_os_page_size(void) {
@@ -153,7 +158,9 @@ static void mi_os_free_huge_os_pages(void* p, size_t size);
 static void mi_os_prim_free(void* addr, size_t size, size_t commit_size) {
   mi_assert_internal((size % _mi_os_page_size()) == 0);
   if (addr == NULL) return; // || _mi_os_is_huge_reserved(addr)
+  const mi_nsecs_t latency_start = mi_stat_latency_start();
   int err = _mi_prim_free(addr, size);  // allow size==0 (issue #1041)
+  mi_stat_latency_end(&_mi_stats_main, mi_latency_os_free, latency_start);
   if (err != 0) {
     _mi_warning_message("unable to free OS memory (error: %d (0x%x), size: 0x%zx bytes, address: %p)\n", err, err, size, addr);
   }
@@ -168,7 +175,7 @@ void _mi_os_free_ex(void* addr, size_t size, bool still_committed, mi_memid_t me
     size_t csize = memid.mem.os.size;
     if (csize==0) { csize = _mi_os_good_alloc_size(size); }
     mi_assert_internal(csize >= size);
-    size_t commit_size = (still_committed ? csize : 0);
+    size_t commit_size = (still_committed ? (memid.memkind == MI_MEM_OS_REMAP ? size : csize) : 0);  // a remappable area is only committed up to `size`
     void* base = addr;
     // different base? (due to alignment)
     if (memid.mem.os.base != base) {
@@ -202,6 +209,42 @@ void  _mi_os_free(void* p, size_t size, mi_memid_t memid) {
 }
 
 
+/* -----------------------------------------------------------
+  Commit limits: checked against the `committed` statistic
+  (which is always maintained). Going above the soft limit
+  signals commit pressure (handled in `page.c:mi_heap_commit_pressure`)
+  and we fail to commit above the hard limit.
+-------------------------------------------------------------- */
+
+static _Atomic(size_t) mi_os_commit_pressure; // = 0
+
+// Can we commit `size` more bytes?
+static bool mi_os_commit_limit_check(size_t size) {
+  const size_t limit = mi_option_get_size(mi_option_commit_limit);
+  const size_t soft_limit = mi_option_get_size(mi_option_commit_soft_limit);
+  if mi_likely(limit == 0 && soft_limit == 0) return true;
+  const int64_t current = mi_atomic_loadi64_relaxed((_Atomic(int64_t)*)&_mi_stats_main.committed.current);
+  const size_t committed = (current < 0 ? 0 : (size_t)current);
+  if (limit > 0 && committed + size > limit) {
+    mi_atomic_store_release(&mi_os_commit_pressure, (size_t)1);  // collect to get under the limit again
+    return false;
+  }
+  if (soft_limit > 0 && committed <= soft_limit && committed + size > soft_limit) {
+    mi_atomic_store_release(&mi_os_commit_pressure, (size_t)1);
+  }
+  return true;
+}
+
+bool _mi_os_has_commit_pressure(void) {
+  return (mi_atomic_load_relaxed(&mi_os_commit_pressure) != 0);
+}
+
+// Returns `true` if there was commit pressure (and resets it)
+bool _mi_os_commit_pressure_clear(void) {
+  return (_mi_os_has_commit_pressure() && mi_atomic_exchange_acq_rel(&mi_os_commit_pressure, (size_t)0) != 0);
+}
+
+
 /* -----------------------------------------------------------
    Primitive allocation from the OS.
 -------------------------------------------------------------- */
@@ -214,6 +257,7 @@ static void* mi_os_prim_alloc_at(void* hint_addr, size_t size, size_t try_alignm
   mi_assert_internal(is_large != NULL);
   if (size == 0) return NULL;
   if (!commit) { allow_large = false; }
+  if (commit && !mi_os_commit_limit_check(size)) return NULL;
   if (try_alignment == 0) { try_alignment = 1; } // avoid 0 to ensure there will be no divide by zero when aligning
   
   // try to align along large OS page size for larger allocations
@@ -224,7 +268,9 @@ static void* mi_os_prim_alloc_at(void* hint_addr, size_t size, size_t try_alignm
 
   *is_zero = false;
   void* p = NULL;
+  const mi_nsecs_t latency_start = mi_stat_latency_start();
   int err = _mi_prim_alloc(hint_addr, size, try_alignment, commit, allow_large, is_large, is_zero, &p);
+  mi_stat_latency_end(&_mi_stats_main, mi_latency_os_alloc, latency_start);
   if (err != 0) {
     _mi_warning_message("unable to allocate OS memory (error: %d (0x%x), addr: %p, size: 0x%zx bytes, align: 0x%zx, commit: %d, allow large: %d)\n", err, err, hint_addr, size, try_alignment, commit, allow_large);
   }
@@ -426,6 +472,87 @@ void* _mi_os_alloc_aligned_at_offset(size_t size, size_t alignment, size_t offse
   }
 }
 
+/* -----------------------------------------------------------
+  OS API: remappable memory (`MI_MEM_OS_REMAP`)
+  A remappable area is committed up to its current size and is
+  followed by reserved address space such that it can often grow
+  in place. Otherwise it is moved into a new (larger) reservation
+  using `_mi_prim_remap` which moves the page table entries
+  instead of copying the memory.
+----------------------------------------------------------- */
+
+// reserve address space for twice the committed size
+static size_t mi_os_remap_reserve_size(size_t size) {
+  return (size > SIZE_MAX/2 ? size : 2*size);
+}
+
+// Allocate a committed area of `size` bytes that can be resized later on using `_mi_os_remap`.
+void* _mi_os_alloc_remappable(size_t size, size_t alignment, mi_memid_t* memid) {
+  *memid = _mi_memid_none();
+  if (size == 0 || !_mi_os_has_remap()) return NULL;
+  size = _mi_align_up(size, _mi_os_page_size());
+  void* p = _mi_os_alloc_aligned(mi_os_remap_reserve_size(size), alignment, false /* commit */, false /* allow large */, memid);
+  if (p == NULL) return NULL;
+  mi_assert_internal(memid->mem.os.base == p);
+  if (!_mi_os_commit(p, size, NULL)) {
+    _mi_os_free_ex(p, memid->mem.os.size, false /* still committed */, *memid);
+    *memid = _mi_memid_none();
+    return NULL;
+  }
+  memid->memkind = MI_MEM_OS_REMAP;
+  memid->initially_committed = true;
+  return p;
+}
+
+// Resize a remappable area `p` of `size` committed bytes to `newsize` bytes.
+// Returns the (possibly moved) area, or NULL if this failed (in which case `p` is unchanged).
+void* _mi_os_remap(void* p, size_t size, size_t newsize, size_t alignment, mi_memid_t* memid) {
+  mi_assert_internal(memid->memkind == MI_MEM_OS_REMAP && memid->mem.os.base == p);
+  mi_assert_internal((size % _mi_os_page_size()) == 0);
+  if (memid->memkind != MI_MEM_OS_REMAP || newsize == 0) return NULL;
+  newsize = _mi_align_up(newsize, _mi_os_page_size());
+  if (newsize <= size) {
+    // shrink: decommit the tail (which becomes part of the reserved space)
+    if (newsize < size) { _mi_os_decommit((uint8_t*)p + newsize, size - newsize); }
+    return p;
+  }
+  if (newsize <= memid->mem.os.size) {
+    // grow in place into the reserved space
+    if (!_mi_os_commit((uint8_t*)p + size, newsize - size, NULL)) return NULL;
+    return p;
+  }
+
+  // otherwise move to a new reservation
+  if (!mi_os_commit_limit_check(newsize - size)) return NULL;
+  mi_memid_t newmemid;
+  void* const newp = _mi_os_alloc_aligned(mi_os_remap_reserve_size(newsize), alignment, false /* commit */, false /* allow large */, &newmemid);
+  if (newp == NULL) return NULL;
+  mi_assert_internal(newmemid.mem.os.base == newp);
+  // we remap over the full reservation and protect the part beyond `newsize` again; this keeps the area
+  // a single mapping such that it can still be moved as a whole after it grows in place later on
+  // (as a moved mapping cannot merge with a separately committed part of the new reservation)
+  const size_t reserve_size = newmemid.mem.os.size;
+  const int err = _mi_prim_remap(p, size, newp, reserve_size);
+  if (err != 0) {
+    _mi_warning_message("unable to remap OS memory (error: %d (0x%x), address: %p, size: 0x%zx bytes, new address: %p, new size: 0x%zx bytes)\n", err, err, p, size, newp, reserve_size);
+    _mi_os_free_ex(newp, reserve_size, false /* still committed */, newmemid);
+    return NULL;
+  }
+  if (reserve_size > newsize) { _mi_os_protect((uint8_t*)newp + newsize, reserve_size - newsize); }
+  // the committed part of the old area is unmapped now (and may be reused by another mapping already),
+  // so only release the remaining reservation after it
+  mi_os_prim_free((uint8_t*)p + size, memid->mem.os.size - size, 0);
+  mi_os_stat_decrease(reserved, size);
+  mi_os_stat_decrease(committed, size);
+  mi_os_stat_increase(committed, newsize);
+  newmemid.memkind = MI_MEM_OS_REMAP;
+  newmemid.initially_committed = memid->initially_committed;
+  newmemid.initially_zero = memid->initially_zero;
+  *memid = newmemid;
+  return newp;
+}
+
+
 /* -----------------------------------------------------------
   OS memory API: reset, commit, decommit, protect, unprotect.
 ----------------------------------------------------------- */
@@ -462,10 +589,13 @@ bool _mi_os_commit_ex(void* addr, size_t size, bool* is_zero, size_t stat_size)
   size_t csize;
   void* start = mi_os_page_align_areax(false /* conservative? */, addr, size, &csize);
   if (csize == 0) return true;
+  if (!mi_os_commit_limit_check(stat_size)) return false;
 
   // commit
   bool os_is_zero = false;
+  const mi_nsecs_t latency_start = mi_stat_latency_start();
   int err = _mi_prim_commit(start, csize, &os_is_zero);
+  mi_stat_latency_end(&_mi_stats_main, mi_latency_os_commit, latency_start);
   if (err != 0) {
     _mi_warning_message("cannot commit OS memory (error: %d (0x%x), address: %p, size: 0x%zx bytes)\n", err, err, start, csize);
     return false;
@@ -480,6 +610,8 @@ bool _mi_os_commit_ex(void* addr, size_t size, bool* is_zero, size_t stat_size)
              else { mi_track_mem_undefined(start,csize); }
   #endif
   mi_os_stat_increase(committed, stat_size);  // use size for precise commit vs. decommit
+  mi_usdt_probe2(os_commit, start, csize);
+  mi_trace_record(mi_trace_os_commit, start, csize, 0);
   return true;
 }
 
@@ -497,13 +629,17 @@ static bool mi_os_decommit_ex(void* addr, size_t size, bool* needs_recommit, siz
 
   // decommit
   *needs_recommit = true;
+  const mi_nsecs_t latency_start = mi_stat_latency_start();
   int err = _mi_prim_decommit(start,csize,needs_recommit);
+  mi_stat_latency_end(&_mi_stats_main, mi_latency_os_decommit, latency_start);
   if (err != 0) {
     _mi_warning_message("cannot decommit OS memory (error: %d (0x%x), address: %p, size: 0x%zx bytes)\n", err, err, start, csize);
   }
   else if (*needs_recommit) {   
     mi_os_stat_decrease(committed, stat_size);
   }
+  mi_usdt_probe2(os_decommit, start, csize);
+  mi_trace_record(mi_trace_os_decommit, start, csize, 0);
   mi_assert_internal(err == 0);
   return (err == 0);
 }
@@ -557,19 +693,23 @@ bool _mi_os_purge_ex(void* p, size_t size, bool allow_reset, size_t stat_size)
   mi_os_stat_counter_increase(purge_calls, 1);
   mi_os_stat_counter_increase(purged, size);
 
+  const mi_nsecs_t latency_start = mi_stat_latency_start();
+  bool needs_recommit = false;  // needs no recommit after a reset
   if (mi_option_is_enabled(mi_option_purge_decommits) &&   // should decommit?
       !_mi_preloading())                                   // don't decommit during preloading (unsafe)
   {
-    bool needs_recommit = true;
+    needs_recommit = true;
     mi_os_decommit_ex(p, size, &needs_recommit, stat_size);
-    return needs_recommit;
   }
   else {
     if (allow_reset) {  // this can sometimes be not allowed if the range is not fully committed
       _mi_os_reset(p, size);
     }
-    return false;  // needs no recommit
   }
+  mi_stat_latency_end(&_mi_stats_main, mi_latency_os_purge, latency_start);
+  mi_usdt_probe3(os_purge, p, size, needs_recommit);
+  mi_trace_record(mi_trace_os_purge, p, size, (needs_recommit ? 1 : 0));
+  return needs_recommit;
 }
 
 // either resets or decommits memory, returns true if the memory needs
@@ -604,6 +744,24 @@ bool _mi_os_unprotect(void* addr, size_t size) {
   return mi_os_protectx(addr, size, false);
 }
 
+// Advise to back a region with transparent huge pages (if `enable`), or to never do so.
+bool _mi_os_set_thp(void* addr, size_t size, bool enable) {
+  if (addr == NULL || size == 0) return false;
+  if (enable && !mi_option_is_enabled(mi_option_allow_thp)) return false;  // disabled for the whole process
+  int err = _mi_prim_set_thp(addr, size, enable);
+  if (err != 0 && err != ENOSYS) {
+    _mi_warning_message("cannot %s transparent huge pages (error: %d (0x%x), address: %p, size: 0x%zx bytes)\n", (enable ? "enable" : "disable"), err, err, addr, size);
+  }
+  return (err == 0);
+}
+
+// Undo `_mi_os_set_thp` for memory that is not returned to the OS (like arena memory that may be reused for another heap):
+// there is no neutral advice, so restore the one that fresh OS memory gets (see `unix_mmap`).
+void _mi_os_reset_thp(void* addr, size_t size) {
+  if (!mi_option_is_enabled(mi_option_allow_thp)) return;  // disabled for the whole process, so avoiding is the default
+  _mi_os_set_thp(addr, size, true);
+}
+
 
 
 /* ----------------------------------------------------------------------------
@@ -779,3 +937,24 @@ int _mi_os_numa_node(void) {
     return mi_os_numa_node_get();
   }
 }
+
+// Bind a range of OS memory to a numa node (used for OS memory of numa bound heaps).
+// Returns `true` if the range was bound.
+bool _mi_os_numa_bind(void* addr, size_t size, int numa_node) {
+  if (numa_node < 0 || _mi_os_numa_node_count() <= 1 || addr == NULL || size == 0) return false;
+  int err = _mi_prim_numa_bind(addr, size, numa_node);
+  if (err != 0) {
+    if (err != ENOSYS) { _mi_warning_message("failed to bind memory to numa node %d (error: %d (0x%x), address: %p, size: 0x%zx bytes)\n", numa_node, err, err, addr, size); }
+    return false;
+  }
+  return true;
+}
+
+// Undo `_mi_os_numa_bind` for memory that is not returned to the OS (like arena memory that may be reused for another node)
+void _mi_os_numa_unbind(void* addr, size_t size) {
+  if (addr == NULL || size == 0) return;
+  int err = _mi_prim_numa_bind(addr, size, -1);
+  if (err != 0 && err != ENOSYS) {
+    _mi_warning_message("failed to unbind memory from its numa node (error: %d (0x%x), address: %p, size: 0x%zx bytes)\n", err, err, addr, size);
+  }
+}
@@ -184,7 +184,7 @@ static inline void mi_heap_queue_first_update(mi_heap_t* heap, const mi_page_que
   if (size > MI_SMALL_SIZE_MAX) return;
 
   mi_page_t* page = pq->first;
-  if (pq->first == NULL) page = (mi_page_t*)&_mi_page_empty;
+  if (pq->first == NULL || pq->first->is_sparse) page = (mi_page_t*)&_mi_page_empty;  // never allocate directly in sparse pages
 
   // find index in the right direct page array
   const size_t idx = _mi_wsize_from_size(size);
@@ -239,6 +239,11 @@ static void mi_page_queue_remove(mi_page_queue_t* queue, mi_page_t* page) {
     mi_heap_queue_first_update(heap,queue);
   }
   heap->page_count--;
+  const size_t psize = page->reserved * mi_page_block_size(page);
+  mi_assert_internal(heap->pages_size >= psize);
+  heap->pages_size -= psize;
+  _mi_stat_decrease(&heap->stat_pages, 1);
+  _mi_stat_decrease(&heap->stat_pages_size, psize);
   page->next = NULL;
   page->prev = NULL;
   // mi_atomic_store_ptr_release(mi_atomic_cast(void*, &page->heap), NULL);
@@ -276,6 +281,10 @@ static void mi_page_queue_push(mi_heap_t* heap, mi_page_queue_t* queue, mi_page_
   // update direct
   mi_heap_queue_first_update(heap, queue);
   heap->page_count++;
+  const size_t psize = page->reserved * mi_page_block_size(page);
+  heap->pages_size += psize;
+  _mi_stat_increase(&heap->stat_pages, 1);
+  _mi_stat_increase(&heap->stat_pages_size, psize);
 
   // [specbot Q-NEW-1] first/last must be both null or both non-null (L1, O(1))
   mi_assert_internal((queue->first == NULL) == (queue->last == NULL));
@@ -305,6 +314,14 @@ static bool mi_page_queue_is_consistent(const mi_page_queue_t* queue) {
 }
 #endif
 
+// Update the links to a page in the queue after its page info moved to another address (for remapped huge pages).
+static void mi_page_queue_relink(mi_page_queue_t* queue, mi_page_t* page) {
+  mi_assert_internal(queue->block_size > MI_SMALL_SIZE_MAX);  // no `pages_free_direct` entries to update
+  if (page->prev != NULL) { page->prev->next = page; } else { queue->first = page; }
+  if (page->next != NULL) { page->next->prev = page; } else { queue->last = page; }
+  mi_assert_expensive(mi_page_queue_is_consistent(queue));
+}
+
 static void mi_page_queue_move_to_front(mi_heap_t* heap, mi_page_queue_t* queue, mi_page_t* page) {
   mi_assert_internal(mi_page_heap(page) == heap);
   mi_assert_internal(mi_page_queue_contains(queue, page));
@@ -314,6 +331,22 @@ static void mi_page_queue_move_to_front(mi_heap_t* heap, mi_page_queue_t* queue,
   mi_assert_internal(queue->first == page);
 }
 
+// Move a page to the end of its queue (so it is only used if no page in front of it has free space)
+static void mi_page_queue_move_to_back(mi_heap_t* heap, mi_page_queue_t* queue, mi_page_t* page) {
+  mi_assert_internal(mi_page_heap(page) == heap);
+  mi_assert_internal(mi_page_queue_contains(queue, page));
+  if (queue->last == page) return;
+  mi_assert_internal(page->next != NULL);
+  page->next->prev = page->prev;
+  if (page->prev != NULL) { page->prev->next = page->next; }
+                     else { queue->first = page->next; mi_heap_queue_first_update(heap, queue); }
+  page->prev = queue->last;
+  page->next = NULL;
+  queue->last->next = page;
+  queue->last = page;
+  mi_assert_expensive(mi_page_queue_is_consistent(queue));
+}
+
 static void mi_page_queue_enqueue_from_ex(mi_page_queue_t* to, mi_page_queue_t* from, bool enqueue_at_end, mi_page_t* page) {
   mi_assert_internal(page != NULL);
   mi_assert_expensive(mi_page_queue_contains(from, page));
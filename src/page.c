@@ -294,6 +294,8 @@ void _mi_page_reclaim(mi_heap_t* heap, mi_page_t* page) {
   mi_assert_internal(_mi_page_segment(page)->kind != MI_SEGMENT_HUGE);
   #endif
 
+  page->is_sparse = false;  // not part of the defragmentation of the new heap
+  mi_usdt_probe3(page_reclaim, page, mi_page_block_size(page), heap);
   // TODO: push on full queue immediately if it is full?
   mi_page_queue_t* pq = mi_page_queue(heap, mi_page_block_size(page));
   mi_page_queue_push(heap, pq, page);
@@ -307,6 +309,9 @@ static mi_page_t* mi_page_fresh_alloc(mi_heap_t* heap, mi_page_queue_t* pq, size
   mi_assert_internal(mi_heap_contains_queue(heap, pq));
   mi_assert_internal(page_alignment > 0 || block_size > MI_MEDIUM_OBJ_SIZE_MAX || block_size == pq->block_size);
   #endif
+  if mi_unlikely(heap->commit_limit > 0 && heap->pages_size + block_size > heap->commit_limit) {
+    return NULL;  // at the commit limit of the heap
+  }
   mi_page_t* page = _mi_segment_page_alloc(heap, block_size, page_alignment, &heap->tld->segments);
   if (page == NULL) {
     // this may be out-of-memory, or an abandoned page was reclaimed (and in our queue)
@@ -323,7 +328,15 @@ static mi_page_t* mi_page_fresh_alloc(mi_heap_t* heap, mi_page_queue_t* pq, size
   mi_page_init(heap, page, full_block_size, heap->tld);
   mi_heap_stat_increase(heap, pages, 1);
   mi_heap_stat_increase(heap, page_bins[_mi_page_stats_bin(page)], 1);
-  if (pq != NULL) { mi_page_queue_push(heap, pq, page); }
+  mi_heap_stat_lite_add(heap, pages, 1);
+  mi_usdt_probe3(page_fresh, page, mi_page_block_size(page), _mi_page_stats_bin(page));
+  if (pq != NULL) {
+    const size_t pages_size = heap->pages_size;
+    mi_page_queue_push(heap, pq, page);
+    if mi_unlikely(heap->commit_soft_limit > 0 && pages_size <= heap->commit_soft_limit && heap->pages_size > heap->commit_soft_limit) {
+      heap->commit_pressure = true;  // handled at the next generic allocation
+    }
+  }
   mi_assert_expensive(_mi_page_is_valid(page));
   return page;
 }
@@ -394,6 +407,21 @@ void _mi_page_unfull(mi_page_t* page) {
   mi_page_queue_enqueue_from_full(pq, pqfull, page);
 }
 
+// Mark a page as sparse during defragmentation (see `mi_heap_defrag_begin`), or clear the mark again.
+// Sparse pages are moved to the end of their (non-full) queue and are never the direct allocation target.
+void _mi_page_set_sparse(mi_page_t* page, bool sparse) {
+  mi_heap_t* heap = mi_page_heap(page);
+  if (sparse && mi_page_is_in_full(page)) {
+    _mi_page_unfull(page);  // enqueues at the end
+  }
+  mi_page_queue_t* pq = mi_page_queue_of(page);
+  page->is_sparse = sparse;
+  if (sparse) {
+    mi_page_queue_move_to_back(heap, pq, page);
+  }
+  mi_heap_queue_first_update(heap, pq);
+}
+
 static void mi_page_to_full(mi_page_t* page, mi_page_queue_t* pq) {
   mi_assert_internal(pq == mi_page_queue_of(page));
   mi_assert_internal(!mi_page_immediate_available(page));
@@ -404,6 +432,12 @@ static void mi_page_to_full(mi_page_t* page, mi_page_queue_t* pq) {
   _mi_page_free_collect(page,false);  // try to collect right away in case another thread freed just before MI_USE_DELAYED_FREE was set
 }
 
+// Move a page without available blocks to the full queue (if it is not already there).
+void _mi_page_to_full(mi_page_t* page) {
+  if (!mi_page_is_in_full(page)) {
+    mi_page_to_full(page, mi_page_queue_of(page));
+  }
+}
 
 // Abandon a page with used blocks at the end of a thread.
 // Note: only call if it is ensured that no references exist from
@@ -420,6 +454,7 @@ void _mi_page_abandon(mi_page_t* page, mi_page_queue_t* pq) {
   // remove from our page list
   mi_segments_tld_t* segments_tld = &pheap->tld->segments;
   mi_page_queue_remove(pq, page);
+  mi_usdt_probe2(page_abandon, page, mi_page_block_size(page));
 
   // page is no longer associated with our heap
   mi_assert_internal(mi_page_thread_free_flag(page)==MI_NEVER_DELAYED_FREE);
@@ -468,14 +503,16 @@ void _mi_page_free(mi_page_t* page, mi_page_queue_t* pq, bool force) {
   mi_assert_internal(mi_page_all_free(page));
   mi_assert_internal(mi_page_thread_free_flag(page)!=MI_DELAYED_FREEING);
 
-  // no more aligned blocks in here
+  // no more aligned (or sampled) blocks in here
   mi_page_set_has_aligned(page, false);
+  mi_page_set_has_sampled(page, false);
 
   // remove from the page list
   // (no need to do _mi_heap_delayed_free first as all blocks are already free)
   mi_heap_t* heap = mi_page_heap(page);
   mi_segments_tld_t* segments_tld = &heap->tld->segments;
   mi_page_queue_remove(pq, page);
+  mi_usdt_probe2(page_free, page, mi_page_block_size(page));
 
   // and free it  
   mi_page_set_heap(page,NULL);
@@ -495,8 +532,10 @@ void _mi_page_retire(mi_page_t* page) mi_attr_noexcept {
   mi_assert_internal(page != NULL);
   mi_assert_expensive(_mi_page_is_valid(page));
   mi_assert_internal(mi_page_all_free(page));
+  mi_usdt_probe2(page_retire, page, mi_page_block_size(page));
 
   mi_page_set_has_aligned(page, false);
+  mi_page_set_has_sampled(page, false);
 
   // don't retire too often..
   // (or we end up retiring and re-allocating most of the time)
@@ -663,7 +702,10 @@ static mi_decl_noinline void mi_page_free_list_extend( mi_page_t* const page, co
 // We do at most `MI_MAX_EXTEND` to avoid touching too much memory
 // Note: we also experimented with "bump" allocation on the first
 // allocations but this did not speed up any benchmark (due to an
-// extra test in malloc? or cache effects?)
+// extra test in malloc? or cache effects?). It is now available
+// as an opt-in page mode (`mi_option_page_bump`): in that case we
+// only link a single block and further blocks are bump allocated in
+// `alloc.c:mi_page_malloc_bump` once the free list is exhausted.
 static bool mi_page_extend_free(mi_heap_t* heap, mi_page_t* page, mi_tld_t* tld) {
   mi_assert_expensive(mi_page_is_valid_init(page));
   #if (MI_SECURE<=2)
@@ -689,6 +731,10 @@ static bool mi_page_extend_free(mi_heap_t* heap, mi_page_t* page, mi_tld_t* tld)
     // the `lean` benchmark tests this. Going from 1 to 8 increases rss by 50%.
     extend = max_extend;
   }
+  if (page->is_bump) {
+    // the rest of the capacity is bump allocated
+    extend = 1;
+  }
 
   mi_assert_internal(extend > 0 && extend + page->capacity <= page->reserved);
   mi_assert_internal(extend < (1UL<<16));
@@ -703,6 +749,9 @@ static bool mi_page_extend_free(mi_heap_t* heap, mi_page_t* page, mi_tld_t* tld)
   // enable the new free list
   page->capacity += (uint16_t)extend;
   mi_stat_increase(tld->stats.page_committed, extend * bsize);
+  if mi_unlikely(mi_page_is_objcache(page)) {
+    _mi_objcache_page_carve(page, page->capacity - extend, extend);
+  }
   mi_assert_expensive(mi_page_is_valid_init(page));
   return true;
 }
@@ -715,6 +764,8 @@ static void mi_page_init(mi_heap_t* heap, mi_page_t* page, size_t block_size, mi
   mi_assert_internal(block_size > 0);
   // set fields
   mi_page_set_heap(page, heap);
+  page->objcache = heap->objcache;
+  page->is_destroyable = heap->no_reclaim;
   page->block_size = block_size;
   size_t page_size;
   page->page_start = _mi_segment_page_start(segment, page, &page_size);
@@ -729,6 +780,9 @@ static void mi_page_init(mi_heap_t* heap, mi_page_t* page, size_t block_size, mi
   page->keys[1] = _mi_heap_random_next(heap);
   #endif
   page->free_is_zero = page->is_zero_init;
+  #if (MI_SECURE<2)
+  page->is_bump = (page->reserved > 1 && mi_option_is_enabled(mi_option_page_bump));
+  #endif
   #if MI_DEBUG>2
   if (page->is_zero_init) {
     mi_track_mem_defined(page->page_start, page_size);
@@ -803,6 +857,12 @@ static mi_page_t* mi_page_queue_find_free_ex(mi_heap_t* heap, mi_page_queue_t* p
     // collect freed blocks by us and other threads
     _mi_page_free_collect(page, false);
 
+    // during defragmentation we do not allocate in sparse pages so they can empty out
+    if mi_unlikely(page->is_sparse) {
+      page = next;
+      continue;
+    }
+
   #if MI_MAX_CANDIDATE_SEARCH > 1
     // search up to N pages for a best candidate
 
@@ -893,7 +953,7 @@ static inline mi_page_t* mi_find_free_page(mi_heap_t* heap, size_t size) {
 
   // check the first page: we even do this with candidate search or otherwise we re-search every time
   mi_page_t* page = pq->first;
-  if (page != NULL) {
+  if (page != NULL && !page->is_sparse) {
    #if (MI_SECURE>=2) // in secure mode, we extend half the time to increase randomness
     if (page->capacity < page->reserved && ((_mi_heap_random_next(heap) & 1) == 1)) {
       mi_page_extend_free(heap, page, heap->tld);
@@ -943,6 +1003,45 @@ void mi_register_deferred_free(mi_deferred_free_fun* fn, void* arg) mi_attr_noex
 }
 
 
+/* -----------------------------------------------------------
+  Commit pressure: when a heap goes above its soft commit limit, or the
+  process goes above `mi_option_commit_soft_limit`, we collect and call
+  the registered commit pressure handler at the next generic allocation.
+----------------------------------------------------------- */
+
+static _Atomic(void*) commit_pressure_fun; // is `mi_commit_pressure_fun*`
+static _Atomic(void*) commit_pressure_arg;
+
+static void mi_commit_pressure_call(mi_heap_t* heap, mi_heap_t* limited_heap, size_t committed, size_t limit) {
+  mi_commit_pressure_fun* const fun = (mi_commit_pressure_fun*)mi_atomic_load_ptr_acquire(void,&commit_pressure_fun);
+  if (fun != NULL && !heap->tld->recurse) {
+    heap->tld->recurse = true;
+    void* const arg = mi_atomic_load_ptr_acquire(void,&commit_pressure_arg);
+    fun(limited_heap, committed, limit, arg);
+    heap->tld->recurse = false;
+  }
+}
+
+static void mi_heap_commit_pressure(mi_heap_t* heap) {
+  if (heap->commit_pressure) {
+    heap->commit_pressure = false;
+    mi_heap_collect(heap, true /* force */);
+    mi_commit_pressure_call(heap, heap, heap->pages_size, heap->commit_soft_limit);
+  }
+  // process wide pressure is handled by a thread with its own heaps (as collection can abandon segments)
+  if (!_mi_heap_is_per_cpu(heap) && _mi_os_commit_pressure_clear()) {
+    mi_collect_reduce(0);  // collect and abandon segments above the target
+    const size_t committed = (size_t)mi_atomic_loadi64_relaxed((_Atomic(int64_t)*)&_mi_stats_main.committed.current);
+    mi_commit_pressure_call(heap, NULL, committed, mi_option_get_size(mi_option_commit_soft_limit));
+  }
+}
+
+void mi_register_commit_pressure(mi_commit_pressure_fun* fn, void* arg) mi_attr_noexcept {
+  mi_atomic_store_ptr_release(void,&commit_pressure_arg, arg);
+  mi_atomic_store_ptr_release(void,&commit_pressure_fun, (void*)fn);
+}
+
+
 /* -----------------------------------------------------------
   General allocation
 ----------------------------------------------------------- */
@@ -988,10 +1087,29 @@ static mi_page_t* mi_large_huge_page_alloc(mi_heap_t* heap, size_t size, size_t
       _mi_stat_increase(&heap->tld->stats.malloc_huge, bsize);
       _mi_stat_counter_increase(&heap->tld->stats.malloc_huge_count, 1);
     }
+    mi_usdt_probe3(huge_alloc, page, bsize, page_alignment);
   }
   return page;
 }
 
+// Grow the block of a huge page in a remappable segment (see `segment.c:_mi_segment_huge_page_remap`).
+// If the page moved, it is relinked in its (full) page queue at the new address.
+mi_page_t* _mi_page_huge_remap(mi_page_t* page, size_t block_size) {
+  mi_assert_internal(mi_page_is_huge(page) && mi_page_is_in_full(page));
+  mi_heap_t* const heap = mi_page_heap(page);
+  mi_page_queue_t* const pq = mi_page_queue_of(page);
+  const size_t old_size = mi_page_block_size(page);
+  mi_page_t* const newpage = _mi_segment_huge_page_remap(page, block_size, &heap->tld->segments);
+  if (newpage == NULL) return NULL;
+  if (newpage != page) {
+    mi_page_queue_relink(pq, newpage);
+  }
+  heap->pages_full_size += (mi_page_block_size(newpage) - old_size);
+  heap->pages_size += (mi_page_block_size(newpage) - old_size);
+  _mi_stat_increase(&heap->stat_pages_size, mi_page_block_size(newpage) - old_size);
+  return newpage;
+}
+
 
 // Allocate a page
 // Note: in debug mode the size includes MI_PADDING_SIZE and might have overflowed.
@@ -1016,6 +1134,110 @@ static mi_page_t* mi_find_page(mi_heap_t* heap, size_t size, size_t huge_alignme
   }
 }
 
+/* -----------------------------------------------------------
+  Monotonic heaps only bump allocate. Objects are allocated in chunks
+  that are single large blocks in the heap; the pages of these chunks are
+  marked as monotonic so `mi_free` ignores pointers into them and they are
+  only released as a whole when the heap is destroyed (see `heap.c`).
+  Each chunk starts with a map of the object boundaries (see `mi_monotonic_mark`).
+  The common case of bumping in the current chunk is inlined in `alloc.c:mi_heap_monotonic_bump`.
+----------------------------------------------------------- */
+
+// Size of the boundary map at the start of a chunk that covers `size` bytes (including the map)
+static size_t mi_monotonic_map_size(size_t size) {
+  const size_t bits = (size / MI_MAX_ALIGN_SIZE) + 1;  // including the boundary at the end
+  return _mi_align_up(_mi_divide_up(bits, MI_SIZE_BITS) * MI_SIZE_SIZE, MI_MAX_ALIGN_SIZE);
+}
+
+// Clear the boundary map of a fresh chunk and return the start of the first object
+static uint8_t* mi_monotonic_chunk_init(uint8_t* chunk, size_t map_size) {
+  _mi_memzero_aligned(chunk, map_size);
+  mi_monotonic_mark(chunk, chunk + map_size);
+  return (chunk + map_size);
+}
+
+// Allocate a fresh chunk of at least `size` bytes (including padding) as a single block.
+static uint8_t* mi_heap_monotonic_chunk_alloc(mi_heap_t* heap, size_t size, size_t* chunk_size) {
+  mi_page_t* page = mi_find_page(heap, size, 0);
+  if mi_unlikely(page == NULL) {
+    _mi_error_message(ENOMEM, "unable to allocate memory for a monotonic heap (%zu bytes)\n", size - MI_PADDING_SIZE);
+    return NULL;
+  }
+  uint8_t* const chunk = (uint8_t*)_mi_page_malloc(heap, page, size);
+  mi_assert_internal(chunk != NULL && page->reserved == 1);
+  if (page->reserved == page->used) {
+    mi_page_to_full(page, mi_page_queue_of(page));
+  }
+  // interior pointers need to be unaligned (for `mi_usable_size`), and `mi_free` should ignore them
+  mi_page_set_has_aligned(page, true);
+  page->flags.x.is_monotonic = true;
+  *chunk_size = mi_page_usable_block_size(page);
+  return chunk;
+}
+
+static mi_decl_noinline void* mi_heap_monotonic_malloc(mi_heap_t* heap, size_t size, bool zero, size_t* usable) mi_attr_noexcept {
+  mi_assert_internal(heap->monotonic);
+  const size_t req_size = size - MI_PADDING_SIZE;  // correct for padding_size in case of an overflow on `size`
+  if mi_unlikely(req_size > MI_MAX_ALLOC_SIZE) {
+    _mi_error_message(EOVERFLOW, "allocation request is too large (%zu bytes)\n", req_size);
+    return NULL;
+  }
+  const size_t asize = _mi_align_up(req_size == 0 ? 1 : req_size, MI_MAX_ALIGN_SIZE);
+  uint8_t* p;
+  if mi_likely(asize <= (size_t)(heap->bump_end - heap->bump_next)) {
+    // bump allocate in the current chunk
+    p = heap->bump_next;
+    heap->bump_next += asize;
+    mi_monotonic_mark(heap->bump_chunk, heap->bump_next);
+  }
+  else {
+    if (heap->bump_chunk_size == 0) { heap->bump_chunk_size = MI_MONOTONIC_CHUNK_MIN; }
+    size_t chunk_size;
+    if (asize > heap->bump_chunk_size/4) {
+      // large objects get their own chunk (and we keep bumping in the current one);
+      // the map covers twice the object size which is enough to include the map itself
+      const size_t map_size = mi_monotonic_map_size(2*asize);
+      uint8_t* const chunk = mi_heap_monotonic_chunk_alloc(heap, map_size + asize + MI_PADDING_SIZE, &chunk_size);
+      if (chunk == NULL) return NULL;
+      p = mi_monotonic_chunk_init(chunk, map_size);
+      mi_monotonic_mark(chunk, p + asize);
+    }
+    else {
+      // start a new chunk; the remainder of the previous one is wasted
+      uint8_t* const chunk = mi_heap_monotonic_chunk_alloc(heap, heap->bump_chunk_size, &chunk_size);
+      if (chunk == NULL) return NULL;
+      p = mi_monotonic_chunk_init(chunk, mi_monotonic_map_size(chunk_size));
+      heap->bump_chunk = chunk;
+      heap->bump_next  = p + asize;
+      heap->bump_end   = chunk + chunk_size;
+      mi_monotonic_mark(chunk, heap->bump_next);
+      if (heap->bump_chunk_size < MI_MONOTONIC_CHUNK_MAX) { heap->bump_chunk_size *= 2; }
+    }
+  }
+  if (usable != NULL) { *usable = asize; }
+  if (zero) { _mi_memzero_aligned(p, asize); }
+  return p;
+}
+
+// The usable size of an object at (or inside) `p` in a chunk of a monotonic heap: up to the next object boundary.
+size_t _mi_page_monotonic_usable_size(const mi_page_t* page, const void* p) {
+  mi_assert_internal(mi_page_is_monotonic(page));
+  const uint8_t* const chunk = (const uint8_t*)_mi_page_ptr_unalign(page, p);
+  const size_t* const map = (const size_t*)chunk;
+  const size_t ofs = (size_t)((const uint8_t*)p - chunk);
+  const size_t i = ofs / MI_MAX_ALIGN_SIZE;
+  size_t idx = i / MI_SIZE_BITS;
+  size_t bits = map[idx] & ~(((size_t)2 << (i % MI_SIZE_BITS)) - 1);  // boundaries after `i`
+  while (bits == 0) {  // the end of each object is marked
+    idx++;
+    bits = map[idx];
+  }
+  const size_t end = (idx*MI_SIZE_BITS + mi_ctz(bits)) * MI_MAX_ALIGN_SIZE;
+  mi_assert_internal(end > ofs);
+  return (end - ofs);
+}
+
+
 // Generic allocation routine if the fast path (`alloc.c:mi_page_malloc`) does not succeed.
 // Note: in debug mode the size includes MI_PADDING_SIZE and might have overflowed.
 // The `huge_alignment` is normally 0 but is set to a multiple of MI_SLICE_SIZE for
@@ -1026,11 +1248,24 @@ void* _mi_malloc_generic(mi_heap_t* heap, size_t size, bool zero, size_t huge_al
 
   // initialize if necessary
   if mi_unlikely(!mi_heap_is_initialized(heap)) {
+    if (_mi_cpu_heaps_enabled()) { return _mi_cpu_heap_malloc(size, zero, huge_alignment, usable); }
     heap = mi_heap_get_default(); // calls mi_thread_init
     if mi_unlikely(!mi_heap_is_initialized(heap)) { return NULL; }
   }
   mi_assert_internal(mi_heap_is_initialized(heap));
 
+  // monotonic heaps do not use the page queues for allocation
+  if mi_unlikely(heap->monotonic && huge_alignment == 0) {
+    return mi_heap_monotonic_malloc(heap, size, zero, usable);
+  }
+  const mi_nsecs_t latency_start = mi_stat_latency_start();
+  mi_trace_record(mi_trace_malloc_generic, NULL, size, _mi_bin(size));
+
+  // publish buffered frees of blocks owned by other threads
+  if mi_unlikely(heap->tld->remote_free.count > 0) {
+    _mi_free_remote_flush(heap->tld);
+  }
+
   // do administrative tasks every N generic mallocs
   if mi_unlikely(++heap->generic_count >= 100) {
     heap->generic_collect_count += heap->generic_count;
@@ -1038,6 +1273,9 @@ void* _mi_malloc_generic(mi_heap_t* heap, size_t size, bool zero, size_t huge_al
     // call potential deferred free routines
     _mi_deferred_free(heap, false);
 
+    // start the purge thread if enabled
+    _mi_purge_thread_maybe_start();
+
     // free delayed frees from other threads (but skip contended ones)
     _mi_heap_delayed_free_partial(heap);
 
@@ -1049,6 +1287,11 @@ void* _mi_malloc_generic(mi_heap_t* heap, size_t size, bool zero, size_t huge_al
     }
   }
 
+  // collect if we went above a soft commit limit
+  if mi_unlikely(heap->commit_pressure || _mi_os_has_commit_pressure()) {
+    mi_heap_commit_pressure(heap);
+  }
+
   // find (or allocate) a page of the right size
   mi_page_t* page = mi_find_page(heap, size, huge_alignment);
   if mi_unlikely(page == NULL) { // first time out of memory, try to collect and retry the allocation once more
@@ -1059,6 +1302,7 @@ void* _mi_malloc_generic(mi_heap_t* heap, size_t size, bool zero, size_t huge_al
   if mi_unlikely(page == NULL) { // out of memory
     const size_t req_size = size - MI_PADDING_SIZE;  // correct for padding_size in case of an overflow on `size`
     _mi_error_message(ENOMEM, "unable to allocate memory (%zu bytes)\n", req_size);
+    mi_stat_latency_end(&heap->tld->stats, mi_latency_malloc_generic, latency_start);
     return NULL;
   }
 
@@ -1073,5 +1317,6 @@ void* _mi_malloc_generic(mi_heap_t* heap, size_t size, bool zero, size_t huge_al
   if (page->reserved == page->used) {
     mi_page_to_full(page, mi_page_queue_of(page));
   }
+  mi_stat_latency_end(&heap->tld->stats, mi_latency_malloc_generic, latency_start);
   return p;
 }
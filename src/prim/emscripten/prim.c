@@ -55,6 +55,7 @@ void _mi_prim_mem_init( mi_os_mem_config_t* config) {
   config->has_overcommit = false;
   config->has_partial_free = false;
   config->has_virtual_reserve = false;
+  config->has_remap = false;
 }
 
 extern void emmalloc_free(void*);
@@ -126,6 +127,16 @@ int _mi_prim_protect(void* addr, size_t size, bool protect) {
   return 0;
 }
 
+int _mi_prim_remap(void* addr, size_t size, void* newaddr, size_t newsize) {
+  MI_UNUSED(addr); MI_UNUSED(size); MI_UNUSED(newaddr); MI_UNUSED(newsize);
+  return ENOSYS;
+}
+
+int _mi_prim_set_thp(void* addr, size_t size, bool enable) {
+  MI_UNUSED(addr); MI_UNUSED(size); MI_UNUSED(enable);
+  return ENOSYS;
+}
+
 
 //---------------------------------------------
 // Huge pages and NUMA nodes
@@ -146,6 +157,33 @@ size_t _mi_prim_numa_node_count(void) {
   return 1;
 }
 
+int _mi_prim_numa_bind(void* addr, size_t size, int numa_node) {
+  MI_UNUSED(addr); MI_UNUSED(size); MI_UNUSED(numa_node);
+  return ENOSYS;
+}
+
+int _mi_prim_cpu_id(void) {
+  return -1;
+}
+
+size_t _mi_prim_cpu_count(void) {
+  return 0;
+}
+
+int _mi_prim_cpu_claim(_Atomic(uintptr_t)* claim, int cpu) {
+  MI_UNUSED(claim); MI_UNUSED(cpu);
+  return -1;
+}
+
+size_t _mi_prim_stack_trace(void** frames, size_t max_frames, size_t skip) {
+  MI_UNUSED(frames); MI_UNUSED(max_frames); MI_UNUSED(skip);
+  return 0;
+}
+
+void _mi_prim_out_mappings(mi_output_fun* out, void* arg) {
+  MI_UNUSED(out); MI_UNUSED(arg);
+}
+
 
 //----------------------------------------------------------------
 // Clock
@@ -157,6 +195,12 @@ mi_msecs_t _mi_prim_clock_now(void) {
   return emscripten_date_now();
 }
 
+#include <emscripten/emscripten.h>  // emscripten_get_now
+
+mi_nsecs_t _mi_prim_clock_nsecs(void) {
+  return (mi_nsecs_t)(emscripten_get_now() * 1000000.0);
+}
+
 
 //----------------------------------------------------------------
 // Process info
@@ -179,6 +223,18 @@ void _mi_prim_out_stderr( const char* msg) {
   emscripten_console_error(msg);
 }
 
+bool _mi_prim_write(int fd, const void* buf, size_t size) {
+  const uint8_t* p = (const uint8_t*)buf;
+  while (size > 0) {
+    const ssize_t n = write(fd, p, size);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    p += n;
+    size -= (size_t)n;
+  }
+  return true;
+}
+
 
 //----------------------------------------------------------------
 // Environment
@@ -251,3 +307,29 @@ void _mi_prim_thread_associate_default_heap(mi_heap_t* heap) {
 
 }
 #endif
+
+
+//----------------------------------------------------------------
+// Purge thread (not supported)
+//----------------------------------------------------------------
+
+bool _mi_prim_purge_thread_start(void (*fun)(void)) {
+  MI_UNUSED(fun);
+  return false;
+}
+
+void _mi_prim_purge_thread_wait(mi_msecs_t timeout) {
+  MI_UNUSED(timeout);
+}
+
+void _mi_prim_purge_thread_signal(void) {
+  // nothing
+}
+
+void _mi_prim_purge_thread_join(void) {
+  // nothing
+}
+
+void _mi_prim_purge_thread_atfork(void (*prepare)(void), void (*parent)(void), void (*child)(void)) {
+  MI_UNUSED(prepare); MI_UNUSED(parent); MI_UNUSED(child);
+}
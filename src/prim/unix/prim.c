@@ -65,6 +65,10 @@ terms of the MIT license. A copy of the license can be found in the file
   #include <sys/syscall.h>
 #endif
 
+#if defined(__linux__) && defined(MI_HAS_SYSCALL_H) && defined(SYS_mremap) && defined(MREMAP_MAYMOVE) && defined(MREMAP_FIXED)
+  #define MI_HAS_MREMAP
+#endif
+
 #if !defined(MADV_DONTNEED) && defined(POSIX_MADV_DONTNEED)  // QNX
 #define MADV_DONTNEED  POSIX_MADV_DONTNEED
 #endif
@@ -199,6 +203,9 @@ void _mi_prim_mem_init( mi_os_mem_config_t* config )
   config->has_overcommit = unix_detect_overcommit();
   config->has_partial_free = true;    // mmap can free in parts
   config->has_virtual_reserve = true; // todo: check if this true for NetBSD?  (for anonymous mmap with PROT_NONE)
+  #if defined(MI_HAS_MREMAP)
+  config->has_remap = true;
+  #endif
 
   // disable transparent huge pages for this process?
   #if (defined(__linux__) || defined(__ANDROID__)) && defined(PR_GET_THP_DISABLE)
@@ -527,6 +534,28 @@ int _mi_prim_protect(void* start, size_t size, bool protect) {
   return err;
 }
 
+int _mi_prim_remap(void* addr, size_t size, void* newaddr, size_t newsize) {
+  #if defined(MI_HAS_MREMAP)
+  // move the page table entries (instead of copying) and extend with zero'd pages; this replaces the reserved range at `newaddr`
+  void* p = (void*)syscall(SYS_mremap, addr, size, newsize, MREMAP_MAYMOVE | MREMAP_FIXED, newaddr);
+  if (p == MAP_FAILED) return errno;
+  mi_assert_internal(p == newaddr);
+  return 0;
+  #else
+  MI_UNUSED(addr); MI_UNUSED(size); MI_UNUSED(newaddr); MI_UNUSED(newsize);
+  return ENOSYS;
+  #endif
+}
+
+int _mi_prim_set_thp(void* addr, size_t size, bool enable) {
+  #if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+  return unix_madvise(addr, size, (enable ? MADV_HUGEPAGE : MADV_NOHUGEPAGE));
+  #else
+  MI_UNUSED(addr); MI_UNUSED(size); MI_UNUSED(enable);
+  return ENOSYS;
+  #endif
+}
+
 
 
 //---------------------------------------------
@@ -608,6 +637,26 @@ size_t _mi_prim_numa_node_count(void) {
   return (node+1);
 }
 
+#define MI_NUMA_MASK_BITS  (256)   // at most 256 nodes (as in `_mi_prim_numa_node_count`)
+
+int _mi_prim_numa_bind(void* addr, size_t size, int numa_node) {
+  #if defined(MI_HAS_SYSCALL_H) && defined(SYS_mbind)
+    unsigned long numa_mask[MI_NUMA_MASK_BITS / (8*sizeof(unsigned long))];
+    if (numa_node < 0) {
+      const long err = syscall(SYS_mbind, addr, size, 0 /* MPOL_DEFAULT */, NULL, 0, 0);
+      return (err == 0 ? 0 : errno);
+    }
+    if (numa_node >= MI_NUMA_MASK_BITS) return EINVAL;
+    _mi_memzero(numa_mask, sizeof(numa_mask));
+    numa_mask[numa_node / (8*sizeof(unsigned long))] = (1UL << (numa_node % (8*sizeof(unsigned long))));
+    const long err = syscall(SYS_mbind, addr, size, 1 /* MPOL_PREFERRED */, numa_mask, MI_NUMA_MASK_BITS, 0);
+    return (err == 0 ? 0 : errno);
+  #else
+    MI_UNUSED(addr); MI_UNUSED(size); MI_UNUSED(numa_node);
+    return ENOSYS;
+  #endif
+}
+
 #elif defined(__FreeBSD__) && __FreeBSD_version >= 1200000
 
 size_t _mi_prim_numa_node(void) {
@@ -628,6 +677,11 @@ size_t _mi_prim_numa_node_count(void) {
   return ndomains;
 }
 
+int _mi_prim_numa_bind(void* addr, size_t size, int numa_node) {
+  MI_UNUSED(addr); MI_UNUSED(size); MI_UNUSED(numa_node);
+  return ENOSYS;
+}
+
 #elif defined(__DragonFly__)
 
 size_t _mi_prim_numa_node(void) {
@@ -643,6 +697,11 @@ size_t _mi_prim_numa_node_count(void) {
   return nvirtcoresperphys * ncpus;
 }
 
+int _mi_prim_numa_bind(void* addr, size_t size, int numa_node) {
+  MI_UNUSED(addr); MI_UNUSED(size); MI_UNUSED(numa_node);
+  return ENOSYS;
+}
+
 #else
 
 size_t _mi_prim_numa_node(void) {
@@ -653,8 +712,166 @@ size_t _mi_prim_numa_node_count(void) {
   return 1;
 }
 
+int _mi_prim_numa_bind(void* addr, size_t size, int numa_node) {
+  MI_UNUSED(addr); MI_UNUSED(size); MI_UNUSED(numa_node);
+  return ENOSYS;
+}
+
+#endif
+
+//---------------------------------------------
+// Current cpu
+//---------------------------------------------
+
+#if defined(__linux__)
+
+#if defined(__GLIBC__) && defined(__has_include) && defined(__has_builtin)
+#if __has_include(<sys/rseq.h>) && __has_builtin(__builtin_thread_pointer)
+  #include <sys/rseq.h>     // glibc 2.35+ registers an rseq area for each thread
+  #define MI_HAS_RSEQ
+#endif
+#endif
+
+int _mi_prim_cpu_id(void) {
+  #if defined(MI_HAS_RSEQ)
+  if (__rseq_size > 0) {
+    // the kernel keeps the current cpu up-to-date in the rseq area (so no system call is needed)
+    const struct rseq* rs = (const struct rseq*)((uint8_t*)__builtin_thread_pointer() + __rseq_offset);
+    const int32_t cpu = (int32_t)(*((volatile const uint32_t*)&rs->cpu_id));
+    if (cpu >= 0) return cpu;
+  }
+  #endif
+  #if defined(MI_HAS_SYSCALL_H) && defined(SYS_getcpu)
+  unsigned cpu = 0;
+  if (syscall(SYS_getcpu, &cpu, NULL, NULL) == 0 && cpu <= INT_MAX) return (int)cpu;
+  #endif
+  return -1;
+}
+
+size_t _mi_prim_cpu_count(void) {
+  // parse `/sys/devices/system/cpu/possible` (like `0-63`) as `sysconf` may allocate
+  char buf[128];
+  const int fd = mi_prim_open("/sys/devices/system/cpu/possible", O_RDONLY);
+  if (fd < 0) return 0;
+  const ssize_t n = mi_prim_read(fd, buf, sizeof(buf));
+  mi_prim_close(fd);
+  // the count is one more than the last cpu index in the list
+  size_t count = 0;
+  size_t idx = 0;
+  for (ssize_t i = 0; i < n; i++) {
+    const char c = buf[i];
+    if (c >= '0' && c <= '9') { idx = 10*idx + (size_t)(c - '0'); count = idx + 1; }
+                         else { idx = 0; }
+  }
+  return count;
+}
+
+#if defined(MI_HAS_RSEQ) && defined(__x86_64__) && (RSEQ_SIG == 0x53053053)
+int _mi_prim_cpu_claim(_Atomic(uintptr_t)* claim, int cpu) {
+  if (__rseq_size == 0) return -1;
+  struct rseq* rs = (struct rseq*)((uint8_t*)__builtin_thread_pointer() + __rseq_offset);
+  // The critical section runs from label 1 up to and including the commit store (label 2) and
+  // is described by the `struct rseq_cs` at label 3. If the thread is preempted, migrated, or
+  // signaled inside the section, the kernel continues at the abort handler (label 4) instead,
+  // which is preceded by the signature that glibc registered (see `librseq`).
+  __asm__ __volatile__ goto (
+    ".pushsection __rseq_cs, \"aw\"\n\t"
+    ".balign 32\n\t"
+    "3:\n\t"
+    ".long 0x0, 0x0\n\t"                      // version, flags
+    ".quad 1f, (2f - 1f), 4f\n\t"             // start, post-commit offset, abort
+    ".popsection\n\t"
+    "leaq 3b(%%rip), %%rax\n\t"
+    "movq %%rax, %[rseq_cs]\n\t"
+    "1:\n\t"
+    "cmpl %[cpu], %[cpu_id]\n\t"
+    "jnz %l[failed]\n\t"
+    "cmpq $0, %[claim]\n\t"
+    "jnz %l[failed]\n\t"
+    "movq $1, %[claim]\n\t"                  // commit
+    "2:\n\t"
+    ".pushsection __rseq_failure, \"ax\"\n\t"
+    ".byte 0x0f, 0xb9, 0x3d\n\t"
+    ".long 0x53053053\n\t"                    // RSEQ_SIG
+    "4:\n\t"
+    "jmp %l[failed]\n\t"
+    ".popsection\n\t"
+    : /* no outputs */
+    : [rseq_cs] "m" (rs->rseq_cs), [cpu_id] "m" (rs->cpu_id), [cpu] "r" (cpu),
+      [claim] "m" (*((volatile uintptr_t*)claim))
+    : "memory", "cc", "rax"
+    : failed);
+  return 1;
+failed:
+  return 0;
+}
+#else
+int _mi_prim_cpu_claim(_Atomic(uintptr_t)* claim, int cpu) {
+  MI_UNUSED(claim); MI_UNUSED(cpu);
+  return -1;
+}
+#endif
+
+#else
+
+int _mi_prim_cpu_id(void) {
+  return -1;
+}
+
+size_t _mi_prim_cpu_count(void) {
+  return 0;
+}
+
+int _mi_prim_cpu_claim(_Atomic(uintptr_t)* claim, int cpu) {
+  MI_UNUSED(claim); MI_UNUSED(cpu);
+  return -1;
+}
+
+#endif
+
+
+//---------------------------------------------
+// Stack traces (for heap profiling)
+//---------------------------------------------
+
+#if defined(__GLIBC__) || defined(__APPLE__)
+#include <execinfo.h>   // backtrace
+
+mi_decl_noinline size_t _mi_prim_stack_trace(void** frames, size_t max_frames, size_t skip) {
+  // note: the first call to `backtrace` may allocate (as it loads the unwinder), see `profile.c:_mi_heap_profile_process_init`
+  void* buf[64 + 16];
+  skip++;  // skip our own frame
+  if (max_frames == 0 || skip >= 16) return 0;
+  if (max_frames > 64) { max_frames = 64; }
+  const int n = backtrace(buf, (int)(max_frames + skip));
+  if (n <= (int)skip) return 0;
+  const size_t count = (size_t)n - skip;
+  _mi_memcpy(frames, buf + skip, count * sizeof(void*));
+  return count;
+}
+#else
+size_t _mi_prim_stack_trace(void** frames, size_t max_frames, size_t skip) {
+  MI_UNUSED(frames); MI_UNUSED(max_frames); MI_UNUSED(skip);
+  return 0;
+}
 #endif
 
+void _mi_prim_out_mappings(mi_output_fun* out, void* arg) {
+  #if defined(__linux__)
+  const int fd = mi_prim_open("/proc/self/maps", O_RDONLY);
+  if (fd < 0) return;
+  char buf[256];
+  ssize_t n;
+  while ((n = mi_prim_read(fd, buf, sizeof(buf) - 1)) > 0) {
+    buf[n] = 0;
+    _mi_fputs(out, arg, NULL, buf);
+  }
+  mi_prim_close(fd);
+  #else
+  MI_UNUSED(out); MI_UNUSED(arg);
+  #endif
+}
+
 // ----------------------------------------------------------------
 // Clock
 // ----------------------------------------------------------------
@@ -694,6 +911,22 @@ mi_msecs_t _mi_prim_clock_now(void) {
   return mi_prim_clock_now_lowres();  
 }
 
+mi_nsecs_t _mi_prim_clock_nsecs(void) {
+  // note: `clock_gettime` on a monotonic clock is usually serviced by the vDSO without a system call
+  #if defined(CLOCK_REALTIME) || defined(CLOCK_MONOTONIC)
+    #ifdef CLOCK_MONOTONIC
+    const clockid_t clockid = CLOCK_MONOTONIC;
+    #else
+    const clockid_t clockid = CLOCK_REALTIME;
+    #endif
+    struct timespec t;
+    if (clock_gettime(clockid,&t) == 0) {
+      return ((mi_nsecs_t)t.tv_sec * 1000000000L) + (mi_nsecs_t)t.tv_nsec;
+    }
+  #endif
+  return mi_prim_clock_now_lowres() * 1000000L;
+}
+
 
 //----------------------------------------------------------------
 // Process info
@@ -781,6 +1014,18 @@ void _mi_prim_out_stderr( const char* msg ) {
   fputs(msg,stderr);
 }
 
+bool _mi_prim_write(int fd, const void* buf, size_t size) {
+  const uint8_t* p = (const uint8_t*)buf;
+  while (size > 0) {
+    const ssize_t n = write(fd, p, size);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    p += n;
+    size -= (size_t)n;
+  }
+  return true;
+}
+
 
 //----------------------------------------------------------------
 // Environment
@@ -968,3 +1213,130 @@ void _mi_prim_thread_associate_default_heap(mi_heap_t* heap) {
 }
 
 #endif
+
+
+//----------------------------------------------------------------
+// Purge thread
+//----------------------------------------------------------------
+
+#if defined(MI_USE_PTHREADS)
+
+#include <signal.h>   // sigfillset, pthread_sigmask
+
+static pthread_t       mi_purge_thread;
+static pthread_mutex_t mi_purge_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  mi_purge_cond  = PTHREAD_COND_INITIALIZER;
+static bool            mi_purge_signaled;       // protected by `mi_purge_mutex`
+static void          (*mi_purge_fun)(void);
+static void          (*mi_purge_child_fun)(void);
+
+static void* mi_purge_thread_main(void* arg) {
+  MI_UNUSED(arg);
+  mi_purge_fun();
+  return NULL;
+}
+
+// the clock of `mi_purge_cond` for timed waits (protected by `mi_purge_mutex`)
+static clockid_t       mi_purge_clock = CLOCK_REALTIME;
+
+static void mi_purge_cond_init(void) {
+  // use the monotonic clock where possible so adjusting the real-time clock does not affect the wait
+  #if defined(CLOCK_MONOTONIC) && !defined(__APPLE__)
+  pthread_condattr_t attr;
+  if (pthread_condattr_init(&attr) != 0) return;
+  if (pthread_condattr_setclock(&attr, CLOCK_MONOTONIC) == 0 && pthread_cond_init(&mi_purge_cond, &attr) == 0) {
+    mi_purge_clock = CLOCK_MONOTONIC;
+  }
+  pthread_condattr_destroy(&attr);
+  #endif
+}
+
+bool _mi_prim_purge_thread_start(void (*fun)(void)) {
+  mi_purge_fun = fun;
+  pthread_mutex_lock(&mi_purge_mutex);  // (as it may be signaled already)
+  mi_purge_signaled = false;
+  mi_purge_cond_init();
+  pthread_mutex_unlock(&mi_purge_mutex);
+  // start with all signals blocked so signals meant for the application are never delivered to the purge thread
+  sigset_t all;
+  sigset_t current;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &current);
+  const int err = pthread_create(&mi_purge_thread, NULL, &mi_purge_thread_main, NULL);
+  pthread_sigmask(SIG_SETMASK, &current, NULL);
+  return (err == 0);
+}
+
+void _mi_prim_purge_thread_wait(mi_msecs_t timeout) {
+  pthread_mutex_lock(&mi_purge_mutex);
+  if (!mi_purge_signaled) {
+    if (timeout < 0) {
+      pthread_cond_wait(&mi_purge_cond, &mi_purge_mutex);
+    }
+    else {
+      struct timespec t;
+      clock_gettime(mi_purge_clock, &t);
+      t.tv_sec  += (time_t)(timeout / 1000);
+      t.tv_nsec += (long)(timeout % 1000) * 1000000L;
+      if (t.tv_nsec >= 1000000000L) {
+        t.tv_sec++;
+        t.tv_nsec -= 1000000000L;
+      }
+      pthread_cond_timedwait(&mi_purge_cond, &mi_purge_mutex, &t);
+    }
+  }
+  mi_purge_signaled = false;
+  pthread_mutex_unlock(&mi_purge_mutex);
+}
+
+void _mi_prim_purge_thread_signal(void) {
+  pthread_mutex_lock(&mi_purge_mutex);
+  mi_purge_signaled = true;
+  pthread_cond_signal(&mi_purge_cond);
+  pthread_mutex_unlock(&mi_purge_mutex);
+}
+
+void _mi_prim_purge_thread_join(void) {
+  pthread_join(mi_purge_thread, NULL);
+}
+
+static void mi_prim_purge_thread_atfork_child(void) {
+  // the purge thread may have been waiting at the fork; re-initialize (as we do not own the mutex)
+  const pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+  const pthread_cond_t  cond  = PTHREAD_COND_INITIALIZER;
+  memcpy(&mi_purge_mutex, &mutex, sizeof(mutex));
+  memcpy(&mi_purge_cond, &cond, sizeof(cond));
+  mi_purge_clock = CLOCK_REALTIME;  // (until the purge thread is started again)
+  mi_purge_signaled = false;
+  if (mi_purge_child_fun != NULL) { mi_purge_child_fun(); }
+}
+
+void _mi_prim_purge_thread_atfork(void (*prepare)(void), void (*parent)(void), void (*child)(void)) {
+  mi_purge_child_fun = child;
+  pthread_atfork(prepare, parent, &mi_prim_purge_thread_atfork_child);
+}
+
+#else
+
+bool _mi_prim_purge_thread_start(void (*fun)(void)) {
+  MI_UNUSED(fun);
+  return false;
+}
+
+void _mi_prim_purge_thread_wait(mi_msecs_t timeout) {
+  MI_UNUSED(timeout);
+}
+
+void _mi_prim_purge_thread_signal(void) {
+  // nothing
+}
+
+void _mi_prim_purge_thread_join(void) {
+  // nothing
+}
+
+void _mi_prim_purge_thread_atfork(void (*prepare)(void), void (*parent)(void), void (*child)(void)) {
+  MI_UNUSED(prepare); MI_UNUSED(parent); MI_UNUSED(child);
+}
+
+#endif
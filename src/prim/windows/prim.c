@@ -135,6 +135,7 @@ void _mi_prim_mem_init( mi_os_mem_config_t* config )
   config->has_overcommit = false;
   config->has_partial_free = false;
   config->has_virtual_reserve = true;
+  config->has_remap = false;
   // get the page size
   SYSTEM_INFO si;
   GetSystemInfo(&si);
@@ -386,6 +387,16 @@ int _mi_prim_protect(void* addr, size_t size, bool protect) {
   return (ok ? 0 : (int)GetLastError());
 }
 
+int _mi_prim_remap(void* addr, size_t size, void* newaddr, size_t newsize) {
+  MI_UNUSED(addr); MI_UNUSED(size); MI_UNUSED(newaddr); MI_UNUSED(newsize);
+  return ERROR_NOT_SUPPORTED;
+}
+
+int _mi_prim_set_thp(void* addr, size_t size, bool enable) {
+  MI_UNUSED(addr); MI_UNUSED(size); MI_UNUSED(enable);
+  return ENOSYS;
+}
+
 
 //---------------------------------------------
 // Huge page allocation
@@ -492,6 +503,39 @@ size_t _mi_prim_numa_node_count(void) {
   return ((size_t)numa_max + 1);
 }
 
+int _mi_prim_numa_bind(void* addr, size_t size, int numa_node) {
+  // todo: on Windows the numa node can only be given at allocation time (`VirtualAllocExNuma`)
+  MI_UNUSED(addr); MI_UNUSED(size); MI_UNUSED(numa_node);
+  return ENOSYS;
+}
+
+int _mi_prim_cpu_id(void) {
+  return -1;  // todo: use `GetCurrentProcessorNumberEx`?
+}
+
+size_t _mi_prim_cpu_count(void) {
+  return 0;
+}
+
+int _mi_prim_cpu_claim(_Atomic(uintptr_t)* claim, int cpu) {
+  MI_UNUSED(claim); MI_UNUSED(cpu);
+  return -1;
+}
+
+
+//----------------------------------------------------------------
+// Stack traces (for heap profiling)
+//----------------------------------------------------------------
+
+mi_decl_noinline size_t _mi_prim_stack_trace(void** frames, size_t max_frames, size_t skip) {
+  if (max_frames > 62) { max_frames = 62; }  // limit for Windows XP/Server 2003
+  return (size_t)CaptureStackBackTrace((DWORD)(skip + 1), (DWORD)max_frames, frames, NULL);
+}
+
+void _mi_prim_out_mappings(mi_output_fun* out, void* arg) {
+  MI_UNUSED(out); MI_UNUSED(arg);  // todo: enumerate loaded modules
+}
+
 
 //----------------------------------------------------------------
 // Clock
@@ -514,6 +558,20 @@ mi_msecs_t _mi_prim_clock_now(void) {
   return mi_to_msecs(t);
 }
 
+mi_nsecs_t _mi_prim_clock_nsecs(void) {
+  static LARGE_INTEGER freq; // = 0
+  if (freq.QuadPart == 0LL) {
+    QueryPerformanceFrequency(&freq);
+    if (freq.QuadPart == 0) freq.QuadPart = 1;
+  }
+  LARGE_INTEGER t;
+  QueryPerformanceCounter(&t);
+  // split to avoid overflow of `t * 10^9`
+  const LONGLONG secs = t.QuadPart / freq.QuadPart;
+  const LONGLONG rem  = t.QuadPart % freq.QuadPart;
+  return ((mi_nsecs_t)secs * 1000000000LL) + (mi_nsecs_t)((rem * 1000000000LL) / freq.QuadPart);
+}
+
 
 //----------------------------------------------------------------
 // Process Info
@@ -602,6 +660,20 @@ void _mi_prim_out_stderr( const char* msg )
   }
 }
 
+#include <io.h>  // _write
+
+bool _mi_prim_write(int fd, const void* buf, size_t size) {
+  const uint8_t* p = (const uint8_t*)buf;
+  while (size > 0) {
+    const unsigned int chunk = (size > 0x40000000 ? 0x40000000 : (unsigned int)size);
+    const int n = _write(fd, p, chunk);
+    if (n <= 0) return false;
+    p += n;
+    size -= (size_t)n;
+  }
+  return true;
+}
+
 
 //----------------------------------------------------------------
 // Environment
@@ -1065,6 +1137,58 @@ static void NTAPI mi_win_main(PVOID module, DWORD reason, LPVOID reserved) {
 #error "define windows process and thread auto initialization"
 #endif
 
+//----------------------------------------------------------------
+// Purge thread
+//----------------------------------------------------------------
+
+static HANDLE             mi_purge_thread;
+static SRWLOCK            mi_purge_mutex = SRWLOCK_INIT;
+static CONDITION_VARIABLE mi_purge_cond  = CONDITION_VARIABLE_INIT;
+static bool               mi_purge_signaled;   // protected by `mi_purge_mutex`
+static void             (*mi_purge_fun)(void);
+
+static DWORD WINAPI mi_purge_thread_main(LPVOID arg) {
+  MI_UNUSED(arg);
+  mi_purge_fun();
+  return 0;
+}
+
+bool _mi_prim_purge_thread_start(void (*fun)(void)) {
+  mi_purge_fun = fun;
+  mi_purge_signaled = false;
+  mi_purge_thread = CreateThread(NULL, 0, &mi_purge_thread_main, NULL, 0, NULL);
+  return (mi_purge_thread != NULL);
+}
+
+void _mi_prim_purge_thread_wait(mi_msecs_t timeout) {
+  AcquireSRWLockExclusive(&mi_purge_mutex);
+  if (!mi_purge_signaled) {
+    SleepConditionVariableSRW(&mi_purge_cond, &mi_purge_mutex, (timeout < 0 ? INFINITE : (DWORD)timeout), 0);
+  }
+  mi_purge_signaled = false;
+  ReleaseSRWLockExclusive(&mi_purge_mutex);
+}
+
+void _mi_prim_purge_thread_signal(void) {
+  AcquireSRWLockExclusive(&mi_purge_mutex);
+  mi_purge_signaled = true;
+  ReleaseSRWLockExclusive(&mi_purge_mutex);
+  WakeConditionVariable(&mi_purge_cond);
+}
+
+void _mi_prim_purge_thread_join(void) {
+  if (mi_purge_thread == NULL) return;
+  // bounded wait as the thread cannot exit while we hold the loader lock (when a DLL is unloaded)
+  WaitForSingleObject(mi_purge_thread, 1000);
+  CloseHandle(mi_purge_thread);
+  mi_purge_thread = NULL;
+}
+
+void _mi_prim_purge_thread_atfork(void (*prepare)(void), void (*parent)(void), void (*child)(void)) {
+  // no fork on Windows
+  MI_UNUSED(prepare); MI_UNUSED(parent); MI_UNUSED(child);
+}
+
 // ----------------------------------------------------
 // Communicate with the redirection module on Windows
 // ----------------------------------------------------
@@ -0,0 +1,428 @@
+/* ----------------------------------------------------------------------------
+Copyright (c) 2018-2024, Microsoft Research, Daan Leijen
+This is free software; you can redistribute it and/or modify it under the
+terms of the MIT license. A copy of the license can be found in the file
+"LICENSE" at the root of this distribution.
+-----------------------------------------------------------------------------*/
+
+/* -----------------------------------------------------------
+  Sampling heap profiler (when building with `MI_HEAP_PROFILE=1`)
+
+  Each heap counts down the allocated bytes on the allocation
+  fast path (`internal.h:mi_heap_profile_count`), and once the
+  count goes below zero, the call stack of that allocation is
+  captured and the countdown is reset to a random interval
+  around the sample rate. A sample represents about
+  `sample_rate / size` allocations of its size.
+
+  Samples are aggregated per call stack in a "site". The sampled
+  blocks that are still live are kept in a fixed size table that
+  is divided in buckets of one cache line. A page that contains
+  a sampled block has its `has_sampled` flag set so `mi_free`
+  takes the generic path where we check (without taking the lock)
+  whether the block is in its bucket. The flag is cleared once
+  all blocks in the page are free (or the page is destroyed).
+
+  A live sample also records its allocation time, and when it is
+  freed, its lifetime is counted in the `lifetime_bins` histogram
+  of its size bin in the main statistics.
+----------------------------------------------------------- */
+
+#include "mimalloc.h"
+#include "mimalloc/internal.h"
+#include "mimalloc/atomic.h"
+#include "mimalloc/prim.h"
+
+#if MI_HEAP_PROFILE
+
+#define MI_PROFILE_MAX_FRAMES     (32)
+#define MI_PROFILE_SITE_BUCKETS   (4096)                              // hash buckets for the sites
+#define MI_PROFILE_SITE_CHUNK     (64*MI_KiB)                         // sites are allocated in chunks and never freed
+#define MI_PROFILE_LIVE_SHIFT     (16)
+#define MI_PROFILE_LIVE_COUNT     ((size_t)1 << MI_PROFILE_LIVE_SHIFT)  // at most 64K live samples (32GiB live at the default rate)
+#define MI_PROFILE_LIVE_BUCKET    (8)                                 // probe 8 slots (one cache line on 64-bit)
+
+// Sample counts: the raw samples and the estimated allocations they represent
+typedef struct mi_profile_count_s {
+  int64_t samples;
+  int64_t sampled_bytes;
+  int64_t count;
+  int64_t bytes;
+} mi_profile_count_t;
+
+// A call site
+typedef struct mi_profile_site_s {
+  struct mi_profile_site_s* next;         // list of all sites
+  struct mi_profile_site_s* hnext;        // next site in the same hash bucket
+  uintptr_t           hash;
+  size_t              frame_count;
+  void*               frames[MI_PROFILE_MAX_FRAMES];  // return addresses, innermost first
+  mi_profile_count_t  live;
+  mi_profile_count_t  alloc;
+} mi_profile_site_t;
+
+// A live sample
+typedef struct mi_profile_live_s {
+  mi_profile_site_t*  site;
+  size_t              size;               // requested size
+  size_t              count;              // estimated number of allocations of this size
+  size_t              bin;                // size bin of the page (see `page-queue.c:_mi_page_stats_bin`)
+  mi_msecs_t          start;              // allocation time
+} mi_profile_live_t;
+
+// The live samples. The block addresses are separate so a lookup only touches one cache line.
+typedef struct mi_profile_table_s {
+  _Atomic(uintptr_t)  blocks[MI_PROFILE_LIVE_COUNT];
+  mi_profile_live_t   live[MI_PROFILE_LIVE_COUNT];
+} mi_profile_table_t;
+
+static mi_lock_t                    mi_profile_lock = MI_LOCK_INITIALIZER;   // protects all sites and live samples
+static _Atomic(mi_profile_table_t*) mi_profile_table;                        // allocated on the first sample
+static mi_profile_site_t*           mi_profile_site_buckets[MI_PROFILE_SITE_BUCKETS];
+static mi_profile_site_t*           mi_profile_sites;                        // all sites (newest first)
+static size_t                       mi_profile_site_count;
+static uint8_t*                     mi_profile_chunk;                        // current chunk to allocate sites from
+static uint8_t*                     mi_profile_chunk_end;
+static _Atomic(size_t)              mi_profile_rate;                         // last non-zero sample rate (for the pprof header)
+
+
+/* -----------------------------------------------------------
+  Sampling
+----------------------------------------------------------- */
+
+static uintptr_t mi_profile_frames_hash(void* const* frames, size_t frame_count) {
+  uintptr_t h = (uintptr_t)frame_count;
+  for (size_t i = 0; i < frame_count; i++) {
+    h = (h ^ (uintptr_t)frames[i]) * (uintptr_t)0x9E3779B97F4A7C15ULL;
+    h ^= (h >> 29);
+  }
+  return h;
+}
+
+static size_t mi_profile_block_bucket(uintptr_t block) {
+  const uint64_t h = (uint64_t)(block >> 3) * 0x9E3779B97F4A7C15ULL;
+  return ((size_t)(h >> (64 - MI_PROFILE_LIVE_SHIFT)) & ~(size_t)(MI_PROFILE_LIVE_BUCKET - 1));
+}
+
+static void mi_profile_count_add(mi_profile_count_t* c, size_t size, size_t count, int64_t sign) {
+  c->samples       += sign;
+  c->sampled_bytes += sign * (int64_t)size;
+  c->count         += sign * (int64_t)count;
+  c->bytes         += sign * (int64_t)(count * size);
+}
+
+// Find or create the site of a call stack (with the lock held)
+static mi_profile_site_t* mi_profile_site_get(void* const* frames, size_t frame_count) {
+  const uintptr_t hash = mi_profile_frames_hash(frames, frame_count);
+  mi_profile_site_t** bucket = &mi_profile_site_buckets[hash % MI_PROFILE_SITE_BUCKETS];
+  for (mi_profile_site_t* site = *bucket; site != NULL; site = site->hnext) {
+    if (site->hash == hash && site->frame_count == frame_count &&
+        memcmp(site->frames, frames, frame_count * sizeof(void*)) == 0) {
+      return site;
+    }
+  }
+  // allocate a fresh site
+  if (mi_profile_chunk + sizeof(mi_profile_site_t) > mi_profile_chunk_end) {
+    mi_memid_t memid;
+    uint8_t* const chunk = (uint8_t*)_mi_os_zalloc(MI_PROFILE_SITE_CHUNK, &memid);
+    if (chunk == NULL) return NULL;
+    mi_profile_chunk = chunk;
+    mi_profile_chunk_end = chunk + MI_PROFILE_SITE_CHUNK;
+  }
+  mi_profile_site_t* const site = (mi_profile_site_t*)mi_profile_chunk;
+  mi_profile_chunk += sizeof(mi_profile_site_t);
+  site->hash = hash;
+  site->frame_count = frame_count;
+  _mi_memcpy(site->frames, frames, frame_count * sizeof(void*));
+  site->hnext = *bucket;
+  *bucket = site;
+  site->next = mi_profile_sites;
+  mi_profile_sites = site;
+  mi_profile_site_count++;
+  return site;
+}
+
+// Record a sample; returns `true` if the block is tracked as a live sample
+static bool mi_profile_add(mi_block_t* block, void* const* frames, size_t frame_count, size_t size, size_t count, size_t bin) {
+  const mi_msecs_t start = _mi_clock_now();
+  bool is_live = false;
+  mi_lock(&mi_profile_lock) {
+    mi_profile_table_t* table = mi_atomic_load_ptr_relaxed(mi_profile_table_t, &mi_profile_table);
+    if (table == NULL) {
+      mi_memid_t memid;
+      table = (mi_profile_table_t*)_mi_os_zalloc(sizeof(mi_profile_table_t), &memid);
+      mi_atomic_store_ptr_release(mi_profile_table_t, &mi_profile_table, table);
+    }
+    mi_profile_site_t* const site = mi_profile_site_get(frames, frame_count);
+    if (site != NULL) {
+      mi_profile_count_add(&site->alloc, size, count, 1);
+      // find a free slot in the bucket of the block (or do not track the block if the bucket is full)
+      const size_t bucket = mi_profile_block_bucket((uintptr_t)block);
+      for (size_t i = bucket; table != NULL && i < bucket + MI_PROFILE_LIVE_BUCKET; i++) {
+        if (mi_atomic_load_relaxed(&table->blocks[i]) == 0) {
+          table->live[i].site  = site;
+          table->live[i].size  = size;
+          table->live[i].count = count;
+          table->live[i].bin   = bin;
+          table->live[i].start = start;
+          mi_atomic_store_release(&table->blocks[i], (uintptr_t)block);
+          mi_profile_count_add(&site->live, size, count, 1);
+          is_live = true;
+          break;
+        }
+      }
+    }
+  }
+  return is_live;
+}
+
+// Lifetime histogram bucket: below 1ms, and then in powers of 4 milli-seconds
+static size_t mi_profile_lifetime_bucket(mi_msecs_t lifetime) {
+  if (lifetime < 1) return 0;
+  const size_t bucket = 1 + mi_bsr((size_t)lifetime)/2;
+  return (bucket < MI_STAT_LIFETIME_BUCKETS ? bucket : MI_STAT_LIFETIME_BUCKETS - 1);
+}
+
+// Remove a live sample (with the lock held); `ended` is false if the block just moved
+static void mi_profile_remove_at(mi_profile_table_t* table, size_t i, bool ended) {
+  mi_profile_live_t* const live = &table->live[i];
+  mi_profile_count_add(&live->site->live, live->size, live->count, -1);
+  if (ended) {
+    const size_t bucket = mi_profile_lifetime_bucket(_mi_clock_now() - live->start);
+    _mi_stat_counter_increase(&_mi_stats_main.lifetime_bins[live->bin][bucket], live->count);
+  }
+  mi_atomic_store_relaxed(&table->blocks[i], (uintptr_t)0);
+}
+
+static ptrdiff_t mi_profile_next_countdown(mi_heap_t* heap, size_t sample_rate) {
+  if (sample_rate == 0 || sample_rate >= PTRDIFF_MAX/2) return PTRDIFF_MAX;
+  return (ptrdiff_t)(_mi_heap_random_next(heap) % (2*sample_rate));  // uniform with an average of `sample_rate`
+}
+
+// Called from `mi_heap_profile_count` when the countdown goes below zero
+mi_decl_noinline void _mi_heap_profile_sample(mi_heap_t* heap, mi_page_t* page, mi_block_t* block, size_t size) {
+  const size_t sample_rate = heap->profile_sample_rate;
+  if (sample_rate == 0) {
+    heap->profile_countdown = PTRDIFF_MAX;
+    return;
+  }
+  heap->profile_countdown = PTRDIFF_MAX;  // do not sample allocations made while capturing the stack
+  void* frames[MI_PROFILE_MAX_FRAMES];
+  const size_t frame_count = _mi_prim_stack_trace(frames, MI_PROFILE_MAX_FRAMES, 1 /* skip this function */);
+
+  // estimate the number of allocations this sample represents
+  const size_t usize = (size > MI_PADDING_SIZE ? size - MI_PADDING_SIZE : 1);
+  const size_t count = (usize >= sample_rate ? 1 : sample_rate / usize);
+  if (mi_profile_add(block, frames, frame_count, usize, count, _mi_page_stats_bin(page))) {
+    mi_page_set_has_sampled(page, true);
+  }
+  heap->profile_countdown = mi_profile_next_countdown(heap, sample_rate);
+}
+
+// Called on free when the page of `block` contains sampled blocks
+void _mi_heap_profile_free(const mi_block_t* block) {
+  mi_profile_table_t* const table = mi_atomic_load_ptr_acquire(mi_profile_table_t, &mi_profile_table);
+  if (table == NULL) return;
+  const size_t bucket = mi_profile_block_bucket((uintptr_t)block);
+  for (size_t i = bucket; i < bucket + MI_PROFILE_LIVE_BUCKET; i++) {
+    if (mi_atomic_load_relaxed(&table->blocks[i]) == (uintptr_t)block) {
+      // the block can only be freed once, so the slot cannot change until we remove it
+      mi_lock(&mi_profile_lock) {
+        mi_profile_remove_at(table, i, true);
+      }
+      return;
+    }
+  }
+}
+
+// Called when a block in a `has_sampled` page moved to `newblock` (see `alloc.c:mi_page_huge_remap`)
+void _mi_heap_profile_move(const mi_block_t* block, const mi_block_t* newblock) {
+  mi_profile_table_t* const table = mi_atomic_load_ptr_acquire(mi_profile_table_t, &mi_profile_table);
+  if (table == NULL) return;
+  const size_t bucket = mi_profile_block_bucket((uintptr_t)block);
+  const size_t newbucket = mi_profile_block_bucket((uintptr_t)newblock);
+  mi_lock(&mi_profile_lock) {
+    for (size_t i = bucket; i < bucket + MI_PROFILE_LIVE_BUCKET; i++) {
+      if (mi_atomic_load_relaxed(&table->blocks[i]) != (uintptr_t)block) continue;
+      // re-insert at the new address (or stop tracking it if its bucket is full)
+      for (size_t j = newbucket; j < newbucket + MI_PROFILE_LIVE_BUCKET; j++) {
+        if (mi_atomic_load_relaxed(&table->blocks[j]) == 0) {
+          table->live[j] = table->live[i];
+          mi_profile_count_add(&table->live[j].site->live, table->live[j].size, table->live[j].count, 1);
+          mi_atomic_store_release(&table->blocks[j], (uintptr_t)newblock);
+          break;
+        }
+      }
+      mi_profile_remove_at(table, i, false);
+      break;
+    }
+  }
+}
+
+// Forget the samples of all blocks in a page that is destroyed (`mi_heap_destroy`)
+void _mi_heap_profile_page_destroy(const mi_page_t* page) {
+  mi_profile_table_t* const table = mi_atomic_load_ptr_acquire(mi_profile_table_t, &mi_profile_table);
+  if (table == NULL) return;
+  size_t psize;
+  const uintptr_t start = (uintptr_t)_mi_segment_page_start(_mi_page_segment(page), page, &psize);
+  const uintptr_t end = start + psize;
+  mi_lock(&mi_profile_lock) {
+    for (size_t i = 0; i < MI_PROFILE_LIVE_COUNT; i++) {
+      const uintptr_t block = mi_atomic_load_relaxed(&table->blocks[i]);
+      if (block >= start && block < end) { mi_profile_remove_at(table, i, true); }
+    }
+  }
+}
+
+
+/* -----------------------------------------------------------
+  Sample rate
+----------------------------------------------------------- */
+
+void mi_heap_profile_set_sample_rate(mi_heap_t* heap, size_t sample_rate) {
+  if (heap == NULL || !mi_heap_is_initialized(heap)) return;
+  heap->profile_sample_rate = sample_rate;
+  heap->profile_countdown = mi_profile_next_countdown(heap, sample_rate);
+  if (sample_rate != 0) { mi_atomic_store_relaxed(&mi_profile_rate, sample_rate); }
+}
+
+void _mi_heap_profile_init(mi_heap_t* heap) {
+  mi_heap_profile_set_sample_rate(heap, mi_option_get_size(mi_option_heap_profile_rate));
+}
+
+// Called at process initialization
+void _mi_heap_profile_process_init(void) {
+  if (mi_option_get(mi_option_heap_profile_rate) <= 0) return;
+  // capture a stack once as the first call may allocate (to load the unwinder);
+  // we disable sampling meanwhile so we do not try to capture a stack recursively.
+  mi_heap_t* const heap = mi_prim_get_default_heap();
+  const ptrdiff_t countdown = heap->profile_countdown;
+  if (mi_heap_is_initialized(heap)) { heap->profile_countdown = PTRDIFF_MAX; }
+  void* frames[1];
+  _mi_prim_stack_trace(frames, 1, 0);
+  if (mi_heap_is_initialized(heap)) { heap->profile_countdown = countdown; }
+}
+
+void mi_heap_profile_reset(void) mi_attr_noexcept {
+  mi_lock(&mi_profile_lock) {
+    for (mi_profile_site_t* site = mi_profile_sites; site != NULL; site = site->next) {
+      site->alloc = site->live;  // the live samples stay allocated
+    }
+  }
+}
+
+
+/* -----------------------------------------------------------
+  Output
+----------------------------------------------------------- */
+
+// Append to a line buffer
+static void mi_profile_buf_printf(char* buf, size_t bufsize, size_t* len, const char* fmt, ...) {
+  if (*len >= bufsize) return;
+  va_list args;
+  va_start(args, fmt);
+  const int n = _mi_vsnprintf(buf + *len, bufsize - *len, fmt, args);
+  va_end(args);
+  if (n > 0) { *len += (size_t)n; }
+  if (*len >= bufsize) { *len = bufsize - 1; }
+}
+
+static void mi_profile_print_site(const mi_profile_site_t* site, mi_heap_profile_format_t format, mi_output_fun* out, void* arg) {
+  char buf[32 + 20*MI_PROFILE_MAX_FRAMES + 64];
+  size_t len = 0;
+  if (format == mi_heap_profile_pprof) {
+    if (site->alloc.samples == 0) return;
+    mi_profile_buf_printf(buf, sizeof(buf), &len, "%lld: %lld [%lld: %lld] @",
+                          (long long)site->live.samples, (long long)site->live.sampled_bytes,
+                          (long long)site->alloc.samples, (long long)site->alloc.sampled_bytes);
+    for (size_t i = 0; i < site->frame_count; i++) {
+      mi_profile_buf_printf(buf, sizeof(buf), &len, " 0x%zx", (size_t)site->frames[i]);
+    }
+    mi_profile_buf_printf(buf, sizeof(buf), &len, "\n");
+  }
+  else {
+    const int64_t bytes = (format == mi_heap_profile_collapsed_live ? site->live.bytes : site->alloc.bytes);
+    if (bytes <= 0) return;
+    // root first
+    for (size_t i = site->frame_count; i > 0; i--) {
+      mi_profile_buf_printf(buf, sizeof(buf), &len, "%s0x%zx", (i == site->frame_count ? "" : ";"), (size_t)site->frames[i-1]);
+    }
+    if (site->frame_count == 0) { mi_profile_buf_printf(buf, sizeof(buf), &len, "[unknown]"); }
+    mi_profile_buf_printf(buf, sizeof(buf), &len, " %lld\n", (long long)bytes);
+  }
+  _mi_fputs(out, arg, NULL, buf);
+}
+
+void mi_heap_profile_print_out(mi_heap_profile_format_t format, mi_output_fun* out, void* arg) mi_attr_noexcept {
+  // copy the sites so we do not hold the lock while calling `out` (which may allocate)
+  mi_profile_site_t* sites = NULL;
+  size_t count = 0;
+  size_t size = 0;
+  mi_memid_t memid = _mi_memid_none();
+  mi_lock(&mi_profile_lock) {
+    if (mi_profile_site_count > 0) {
+      size = mi_profile_site_count * sizeof(mi_profile_site_t);
+      sites = (mi_profile_site_t*)_mi_os_alloc(size, &memid);
+      for (mi_profile_site_t* site = mi_profile_sites; sites != NULL && site != NULL; site = site->next) {
+        sites[count++] = *site;
+      }
+    }
+  }
+  if (format == mi_heap_profile_pprof) {
+    mi_profile_count_t live  = { 0, 0, 0, 0 };
+    mi_profile_count_t alloc = { 0, 0, 0, 0 };
+    for (size_t i = 0; i < count; i++) {
+      live.samples  += sites[i].live.samples;  live.sampled_bytes  += sites[i].live.sampled_bytes;
+      alloc.samples += sites[i].alloc.samples; alloc.sampled_bytes += sites[i].alloc.sampled_bytes;
+    }
+    _mi_fprintf(out, arg, "heap profile: %lld: %lld [%lld: %lld] @ heap_v2/%zu\n",
+                (long long)live.samples, (long long)live.sampled_bytes,
+                (long long)alloc.samples, (long long)alloc.sampled_bytes, mi_atomic_load_relaxed(&mi_profile_rate));
+  }
+  for (size_t i = 0; i < count; i++) {
+    mi_profile_print_site(&sites[i], format, out, arg);
+  }
+  if (format == mi_heap_profile_pprof) {
+    _mi_fputs(out, arg, NULL, "\nMAPPED_LIBRARIES:\n");
+    _mi_prim_out_mappings(out, arg);
+  }
+  if (sites != NULL) { _mi_os_free(sites, size, memid); }
+}
+
+#else
+
+void _mi_heap_profile_sample(mi_heap_t* heap, mi_page_t* page, mi_block_t* block, size_t size) {
+  MI_UNUSED(heap); MI_UNUSED(page); MI_UNUSED(block); MI_UNUSED(size);
+}
+
+void _mi_heap_profile_free(const mi_block_t* block) {
+  MI_UNUSED(block);
+}
+
+void _mi_heap_profile_move(const mi_block_t* block, const mi_block_t* newblock) {
+  MI_UNUSED(block); MI_UNUSED(newblock);
+}
+
+void _mi_heap_profile_page_destroy(const mi_page_t* page) {
+  MI_UNUSED(page);
+}
+
+void mi_heap_profile_set_sample_rate(mi_heap_t* heap, size_t sample_rate) {
+  MI_UNUSED(heap); MI_UNUSED(sample_rate);
+}
+
+void _mi_heap_profile_init(mi_heap_t* heap) {
+  MI_UNUSED(heap);
+}
+
+void _mi_heap_profile_process_init(void) {
+}
+
+void mi_heap_profile_reset(void) mi_attr_noexcept {
+}
+
+void mi_heap_profile_print_out(mi_heap_profile_format_t format, mi_output_fun* out, void* arg) mi_attr_noexcept {
+  MI_UNUSED(format); MI_UNUSED(out); MI_UNUSED(arg);
+}
+
+#endif
@@ -0,0 +1,307 @@
+/* ----------------------------------------------------------------------------
+Copyright (c) 2018-2024, Microsoft Research, Daan Leijen
+This is free software; you can redistribute it and/or modify it under the
+terms of the MIT license. A copy of the license can be found in the file
+"LICENSE" at the root of this distribution.
+-----------------------------------------------------------------------------*/
+
+/* -----------------------------------------------------------
+  Background purge thread (with `mi_option_purge_thread`)
+
+  Delayed purges are usually done by the threads that allocate and
+  free (in `segment.c:mi_segment_try_purge` and `arena.c:mi_arenas_try_purge`)
+  which puts the decommit (or reset) calls on their slow paths.
+  With the purge thread, these threads only schedule purges: a
+  segment with scheduled purges is posted to the purge thread, and
+  arena purges (which are already thread safe) are left to it as well.
+  The purge thread sleeps until the earliest expiration (so the
+  `purge_delay` and `arena_purge_mult` delays stay the same) and
+  then purges everything that expired.
+
+  The purge and commit masks of a segment are usually only accessed
+  by its owning thread; for a segment that uses the purge thread these
+  are protected by the `purge_lock` of the segment. The list of posted
+  segments is protected by `mi_purge_lock`, but that is not held while
+  purging: a pass walks the list with a cursor and purges one segment
+  at a time outside of the lock. A segment that is freed while it is
+  being purged waits for that purge to finish.
+
+  The thread is started on an allocation slow path once the option is
+  enabled (and again in a forked child), and it is stopped in
+  `mi_process_done`.
+
+  With `mi_option_purge_adaptive` each segment and arena also keeps its
+  own purge delay (see `_mi_purge_delay_adapt`).
+----------------------------------------------------------- */
+
+#include "mimalloc.h"
+#include "mimalloc/internal.h"
+#include "mimalloc/atomic.h"
+#include "mimalloc/prim.h"
+
+typedef enum mi_purge_thread_state_e {
+  MI_PURGE_THREAD_OFF,       // not started (yet)
+  MI_PURGE_THREAD_STARTING,
+  MI_PURGE_THREAD_RUNNING,
+  MI_PURGE_THREAD_STOPPING,
+  MI_PURGE_THREAD_DISABLED   // could not be started, or the process is done
+} mi_purge_thread_state_t;
+
+static _Atomic(uintptr_t)  mi_purge_state;          // = MI_PURGE_THREAD_OFF
+static _Atomic(mi_msecs_t) mi_purge_wakeup;         // time the purge thread wakes up (or 0 if it only wakes up when signaled)
+static mi_lock_t           mi_purge_lock = MI_LOCK_INITIALIZER;
+static mi_segment_t*       mi_purge_segments;       // posted segments (protected by `mi_purge_lock`)
+static mi_segment_t*       mi_purge_cursor;         // the next segment to visit in the current pass (protected by `mi_purge_lock`)
+static mi_segment_t*       mi_purge_current;        // the segment being purged (protected by `mi_purge_lock`)
+static bool                mi_purge_busy;           // is a purge pass in progress? (protected by `mi_purge_lock`)
+
+
+/* -----------------------------------------------------------
+  Posting purges
+----------------------------------------------------------- */
+
+bool _mi_purge_thread_is_running(void) {
+  return (mi_atomic_load_relaxed(&mi_purge_state) == MI_PURGE_THREAD_RUNNING);
+}
+
+// A purge was scheduled that expires at `expire`: signal the purge thread if it would wake up later.
+void _mi_purge_thread_wakeup(mi_msecs_t expire) {
+  const uintptr_t state = mi_atomic_load_relaxed(&mi_purge_state);
+  if (state != MI_PURGE_THREAD_STARTING && state != MI_PURGE_THREAD_RUNNING) return;
+  const mi_msecs_t wakeup = mi_atomic_loadi64_acquire(&mi_purge_wakeup);
+  if (wakeup == 0 || expire < wakeup) {
+    _mi_prim_purge_thread_signal();
+  }
+}
+
+static bool mi_purge_segment_is_linked(const mi_segment_t* segment) {
+  return (segment->purge_prev != NULL || mi_purge_segments == segment);
+}
+
+static void mi_purge_segment_unlink(mi_segment_t* segment) {
+  if (mi_purge_cursor == segment) { mi_purge_cursor = segment->purge_next; }
+  if (segment->purge_prev != NULL) { segment->purge_prev->purge_next = segment->purge_next; }
+                              else { mi_purge_segments = segment->purge_next; }
+  if (segment->purge_next != NULL) { segment->purge_next->purge_prev = segment->purge_prev; }
+  segment->purge_next = NULL;
+  segment->purge_prev = NULL;
+}
+
+// Called by the owning thread after setting `segment->purge_posted`
+void _mi_purge_segment_post(mi_segment_t* segment, mi_msecs_t expire) {
+  mi_assert_internal(segment->purge_background);
+  mi_lock(&mi_purge_lock) {
+    // it may still be linked if the purge thread did not yet unlink it after its last purge
+    if (!mi_purge_segment_is_linked(segment)) {
+      segment->purge_prev = NULL;
+      segment->purge_next = mi_purge_segments;
+      if (mi_purge_segments != NULL) { mi_purge_segments->purge_prev = segment; }
+      mi_purge_segments = segment;
+    }
+  }
+  _mi_purge_thread_wakeup(expire);
+}
+
+// Called before a segment is freed (this waits if the segment is being purged)
+void _mi_purge_segment_remove(mi_segment_t* segment) {
+  mi_assert_internal(segment->purge_background);
+  size_t ticks = 0;
+  mi_lock_acquire(&mi_purge_lock);
+  while (mi_purge_current == segment) {
+    mi_lock_release(&mi_purge_lock);
+    mi_atomic_yield_sleep(&ticks, 10);
+    mi_lock_acquire(&mi_purge_lock);
+  }
+  if (mi_purge_segment_is_linked(segment)) {
+    mi_purge_segment_unlink(segment);
+  }
+  mi_lock_release(&mi_purge_lock);
+}
+
+
+/* -----------------------------------------------------------
+  The purge thread
+----------------------------------------------------------- */
+
+// Purge everything that expired.
+// Returns the earliest expiration of the remaining scheduled purges (or 0 if there are none).
+static mi_msecs_t mi_purge_expired(void) {
+  mi_msecs_t next = 0;
+  mi_lock(&mi_purge_lock) {
+    mi_purge_busy = true;
+    mi_purge_cursor = mi_purge_segments;
+  }
+  while (true) {
+    // take the next segment; while it is the current one it cannot be freed
+    mi_segment_t* segment = NULL;
+    mi_lock(&mi_purge_lock) {
+      segment = mi_purge_cursor;
+      if (segment != NULL) {
+        mi_purge_cursor = segment->purge_next;
+        mi_purge_current = segment;
+      }
+    }
+    if (segment == NULL) break;
+
+    // purge outside of `mi_purge_lock` (so posting and freeing segments is not blocked)
+    const mi_msecs_t expire = _mi_segment_purge_expired(segment);
+    mi_lock(&mi_purge_lock) {
+      mi_purge_current = NULL;
+      if (expire == 0) {
+        // nothing left to purge: unlink, unless the owner posted it again in the meantime
+        bool posted = false;
+        mi_lock(&segment->purge_lock) { posted = segment->purge_posted; }
+        if (!posted) { mi_purge_segment_unlink(segment); }
+      }
+    }
+    if (expire != 0 && (next == 0 || expire < next)) {
+      next = expire;
+    }
+  }
+  const mi_msecs_t arenas_expire = _mi_arenas_purge_expired();
+  if (arenas_expire != 0 && (next == 0 || arenas_expire < next)) {
+    next = arenas_expire;
+  }
+  mi_lock(&mi_purge_lock) {
+    mi_purge_busy = false;
+  }
+  return next;
+}
+
+static void mi_purge_thread_run(void) {
+  while (mi_atomic_load_acquire(&mi_purge_state) != MI_PURGE_THREAD_STOPPING) {
+    // any purge scheduled during the pass signals us (and the signal is not lost)
+    mi_atomic_storei64_release(&mi_purge_wakeup, (mi_msecs_t)0);
+    const mi_msecs_t next = mi_purge_expired();
+    mi_msecs_t timeout = -1;
+    if (next != 0) {
+      mi_atomic_storei64_release(&mi_purge_wakeup, next);
+      timeout = next - _mi_clock_now();
+      if (timeout < 1) { timeout = 1; }
+    }
+    _mi_prim_purge_thread_wait(timeout);
+  }
+}
+
+
+/* -----------------------------------------------------------
+  Start and stop
+----------------------------------------------------------- */
+
+static void mi_purge_atfork_prepare(void) {
+  // ensure no purge pass is in progress (as that takes the `purge_lock` of segments)
+  size_t ticks = 0;
+  mi_lock_acquire(&mi_purge_lock);
+  while (mi_purge_busy) {
+    mi_lock_release(&mi_purge_lock);
+    mi_atomic_yield_sleep(&ticks, 10);
+    mi_lock_acquire(&mi_purge_lock);
+  }
+}
+
+static void mi_purge_atfork_parent(void) {
+  mi_lock_release(&mi_purge_lock);
+}
+
+static void mi_purge_atfork_child(void) {
+  // only the forking thread exists in the child: the `purge_lock` of a segment owned by another
+  // thread may have been held at the fork (and stays locked) so we no longer purge those segments.
+  // We reset their purge state directly (without the lock) so they are consistent with being unlinked.
+  const mi_threadid_t tid = _mi_thread_id();
+  mi_segment_t* segment = mi_purge_segments;
+  while (segment != NULL) {
+    mi_segment_t* const next = segment->purge_next;
+    const mi_threadid_t owner = mi_atomic_load_relaxed(&segment->thread_id);
+    if (owner != tid && owner != 0) {
+      mi_purge_segment_unlink(segment);
+      segment->purge_posted = false;
+      segment->purge_expire = 0;
+    }
+    segment = next;
+  }
+  mi_lock_release(&mi_purge_lock);
+  // the purge thread does not exist in the child: start it again on an allocation slow path
+  // (our posted segments stay posted)
+  const uintptr_t state = mi_atomic_load_relaxed(&mi_purge_state);
+  if (state == MI_PURGE_THREAD_STARTING || state == MI_PURGE_THREAD_RUNNING) {
+    mi_atomic_store_release(&mi_purge_state, (uintptr_t)MI_PURGE_THREAD_OFF);
+  }
+  else if (state == MI_PURGE_THREAD_STOPPING) {
+    mi_atomic_store_release(&mi_purge_state, (uintptr_t)MI_PURGE_THREAD_DISABLED);
+  }
+  mi_atomic_storei64_release(&mi_purge_wakeup, (mi_msecs_t)0);
+}
+
+// called regularly from `_mi_malloc_generic` where it is safe to create a thread
+// (as that may allocate and re-enter the allocator)
+void _mi_purge_thread_maybe_start(void) {
+  if mi_likely(mi_atomic_load_relaxed(&mi_purge_state) != MI_PURGE_THREAD_OFF) return;
+  if (!mi_option_is_enabled(mi_option_purge_thread) || mi_option_get(mi_option_purge_delay) <= 0) return;
+  if (_mi_preloading()) return;
+  uintptr_t expected = MI_PURGE_THREAD_OFF;
+  if (!mi_atomic_cas_strong_acq_rel(&mi_purge_state, &expected, (uintptr_t)MI_PURGE_THREAD_STARTING)) return;
+
+  static bool atfork_registered = false;  // only once (and not again in a forked child)
+  if (!atfork_registered) {
+    atfork_registered = true;
+    _mi_prim_purge_thread_atfork(&mi_purge_atfork_prepare, &mi_purge_atfork_parent, &mi_purge_atfork_child);
+  }
+  if (_mi_prim_purge_thread_start(&mi_purge_thread_run)) {
+    mi_atomic_store_release(&mi_purge_state, (uintptr_t)MI_PURGE_THREAD_RUNNING);
+    _mi_verbose_message("purge thread started\n");
+  }
+  else {
+    mi_atomic_store_release(&mi_purge_state, (uintptr_t)MI_PURGE_THREAD_DISABLED);
+    _mi_warning_message("unable to start the purge thread (purging stays on the allocating threads)\n");
+  }
+}
+
+// called from `mi_process_done`
+void _mi_purge_thread_done(void) {
+  uintptr_t expected = MI_PURGE_THREAD_RUNNING;
+  if (!mi_atomic_cas_strong_acq_rel(&mi_purge_state, &expected, (uintptr_t)MI_PURGE_THREAD_STOPPING)) {
+    // not running; ensure it is no longer started
+    expected = MI_PURGE_THREAD_OFF;
+    mi_atomic_cas_strong_acq_rel(&mi_purge_state, &expected, (uintptr_t)MI_PURGE_THREAD_DISABLED);
+    return;
+  }
+  _mi_prim_purge_thread_signal();
+  _mi_prim_purge_thread_join();
+  mi_atomic_store_release(&mi_purge_state, (uintptr_t)MI_PURGE_THREAD_DISABLED);
+  _mi_verbose_message("purge thread stopped\n");
+}
+
+
+/* -----------------------------------------------------------
+  Adaptive purge delay (with `mi_option_purge_adaptive`)
+
+  A fixed delay that is too short makes us decommit and commit
+  the same memory repeatedly under bursty load, while a delay that
+  is too long keeps the rss high after a spike. With the adaptive
+  delay, segments and arenas remember when they last purged. If
+  that memory is used again within four times the delay (so a few
+  times longer delay would have avoided the purge) the delay is
+  doubled, and if it is still unused at the next purge the delay is
+  shortened by a quarter.
+----------------------------------------------------------- */
+
+bool _mi_purge_is_adaptive(void) {
+  return (mi_option_is_enabled(mi_option_purge_adaptive) && mi_option_get(mi_option_purge_delay) > 0);
+}
+
+// Is memory that was purged at `purged_at` reused soon enough to lengthen the delay?
+bool _mi_purge_reused_soon(mi_msecs_t purged_at, mi_msecs_t delay) {
+  return (_mi_clock_now() - purged_at <= 4*delay);
+}
+
+// Return the new delay after purged memory was `reused` soon after a purge (or not);
+// the delay stays within `mult` times the `purge_delay_min` and `purge_delay_max` bounds.
+mi_msecs_t _mi_purge_delay_adapt(mi_msecs_t delay, bool reused, long mult) {
+  mi_msecs_t lo = mi_option_get_clamp(mi_option_purge_delay_min, 1, 1000000) * mult;
+  mi_msecs_t hi = mi_option_get_clamp(mi_option_purge_delay_max, 1, 1000000) * mult;
+  if (hi < lo) { hi = lo; }
+  delay = (reused ? 2*delay : delay - delay/4);
+  if (delay < lo) return lo;
+  if (delay > hi) return hi;
+  return delay;
+}
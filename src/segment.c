@@ -271,8 +271,10 @@ static bool mi_segment_is_valid(mi_segment_t* segment, mi_segments_tld_t* tld) {
   mi_assert_internal(segment != NULL);
   mi_assert_internal(_mi_ptr_cookie(segment) == segment->cookie);
   mi_assert_internal(segment->abandoned <= segment->used);
-  mi_assert_internal(segment->thread_id == 0 || segment->thread_id == _mi_thread_id());
-  mi_assert_internal(mi_commit_mask_all_set(&segment->commit_mask, &segment->purge_mask)); // can only decommit committed blocks
+  mi_assert_internal(segment->thread_id == 0 || segment->thread_id == tld->thread_id);
+  mi_lock_maybe(&segment->purge_lock, segment->purge_background) {  // the purge thread may be purging concurrently
+    mi_assert_internal(mi_commit_mask_all_set(&segment->commit_mask, &segment->purge_mask)); // can only decommit committed blocks
+  }
 
   // [specbot S-NEW-1] segment must have at least one slice (L1, O(1))
   mi_assert_internal(segment->segment_slices > 0);
@@ -406,18 +408,29 @@ reuse and avoid setting/clearing guard pages in secure mode.
 ------------------------------------------------------------------------------- */
 
 static void mi_segments_track_size(long segment_size, mi_segments_tld_t* tld) {
-  if (segment_size>=0) _mi_stat_increase(&tld->stats->segments,1);
-                  else _mi_stat_decrease(&tld->stats->segments,1);
+  if (segment_size>=0) { _mi_stat_increase(&tld->stats->segments,1); mi_stat_lite_add(tld->stats_lite->segments,1); }
+                  else { _mi_stat_decrease(&tld->stats->segments,1); mi_stat_lite_add(tld->stats_lite->segments_freed,1); }
   tld->count += (segment_size >= 0 ? 1 : -1);
   if (tld->count > tld->peak_count) tld->peak_count = tld->count;
   tld->current_size += segment_size;
   if (tld->current_size > tld->peak_size) tld->peak_size = tld->current_size;
 }
 
+// only advise on huge pages for memory we allocated from the OS ourselves (and not in user provided arenas)
+// as we need to restore the advice when the memory returns to an arena (see `mi_segment_os_free`)
+static bool mi_segment_thp_advisable(int thp, mi_memid_t memid) {
+  return (thp >= 0 && !memid.is_pinned && _mi_arena_memid_is_os_backed(memid));
+}
+
 static void mi_segment_os_free(mi_segment_t* segment, mi_segments_tld_t* tld) {
+  if (segment->purge_background) {
+    _mi_purge_segment_remove(segment);  // after this, the purge thread no longer accesses this segment
+    mi_lock_done(&segment->purge_lock);
+  }
   segment->thread_id = 0;
   _mi_segment_map_freed_at(segment);
   mi_segments_track_size(-((long)mi_segment_size(segment)),tld);
+  mi_usdt_probe2(segment_free, segment, mi_segment_size(segment));
   if (segment->was_reclaimed) {
     tld->reclaim_count--;
     segment->was_reclaimed = false;
@@ -435,6 +448,14 @@ static void mi_segment_os_free(mi_segment_t* segment, mi_segments_tld_t* tld) {
   // mi_segment_try_purge(segment,true,tld->stats);
 
   const size_t size = mi_segment_size(segment);
+  if (segment->numa_bound && !mi_memkind_is_os(segment->memid.memkind)) {
+    // the memory stays in an arena: remove the binding so it can be used for other heaps (and nodes)
+    _mi_os_numa_unbind(segment, size);
+  }
+  if (mi_segment_thp_advisable(segment->thp, segment->memid) && !mi_memkind_is_os(segment->memid.memkind)) {
+    // likewise, restore the default huge page advice
+    _mi_os_reset_thp(segment, size);
+  }
   const size_t csize = _mi_commit_mask_committed_size(&segment->commit_mask, size);
 
   _mi_arena_free(segment, mi_segment_size(segment), csize, segment->memid);
@@ -456,19 +477,24 @@ static void mi_segment_commit_mask(mi_segment_t* segment, bool conservative, uin
   size_t pstart = (p - (uint8_t*)segment);
   mi_assert_internal(pstart + size <= segsize);
 
+  // segments backed by transparent huge pages commit and purge in whole huge OS pages
+  // so a purge never splits a huge page (and a commit can be backed by one)
+  const bool   use_thp = (segment->thp > 0);
   size_t start;
   size_t end;
   if (conservative) {
     // decommit conservative
-    start = _mi_align_up(pstart, MI_COMMIT_SIZE);
-    end   = _mi_align_down(pstart + size, MI_COMMIT_SIZE);
+    const size_t unit = (use_thp ? MI_THP_COMMIT_SIZE : MI_COMMIT_SIZE);
+    start = _mi_align_up(pstart, unit);
+    end   = _mi_align_down(pstart + size, unit);
     mi_assert_internal(start >= segstart);
     mi_assert_internal(end <= segsize);
   }
   else {
     // commit liberal
-    start = _mi_align_down(pstart, MI_MINIMAL_COMMIT_SIZE);
-    end   = _mi_align_up(pstart + size, MI_MINIMAL_COMMIT_SIZE);
+    const size_t unit = (use_thp ? MI_THP_COMMIT_SIZE : MI_MINIMAL_COMMIT_SIZE);
+    start = _mi_align_down(pstart, unit);
+    end   = _mi_align_up(pstart + size, unit);
   }
   if (pstart >= segstart && start < segstart) {  // note: the mask is also calculated for an initial commit of the info area
     start = segstart;
@@ -477,7 +503,8 @@ static void mi_segment_commit_mask(mi_segment_t* segment, bool conservative, uin
     end = segsize;
   }
 
-  mi_assert_internal(start <= pstart && (pstart + size) <= end);
+  mi_assert_internal(conservative ? (pstart <= start && end <= (pstart + size)) || end <= start
+                                   : (start <= pstart && (pstart + size) <= end));
   mi_assert_internal(start % MI_COMMIT_SIZE==0 && end % MI_COMMIT_SIZE == 0);
   *start_p   = (uint8_t*)segment + start;
   *full_size = (end > start ? end - start : 0);
@@ -494,6 +521,27 @@ static void mi_segment_commit_mask(mi_segment_t* segment, bool conservative, uin
   mi_commit_mask_create(bitidx, bitcount, cm);
 }
 
+// the current purge delay of a segment (which can differ per segment with `mi_option_purge_adaptive`)
+static mi_msecs_t mi_segment_purge_delay(const mi_segment_t* segment) {
+  if (segment->purge_delay > 0 && mi_option_is_enabled(mi_option_purge_adaptive)) return segment->purge_delay;
+  return mi_option_get(mi_option_purge_delay);
+}
+
+// with `mi_option_purge_adaptive`: the range at `p` is used again; lengthen the purge delay if this
+// reuses memory of the last delayed purge soon after that purge (see `purge.c:_mi_purge_delay_adapt`)
+static void mi_segment_purge_note_reuse(mi_segment_t* segment, uint8_t* p, size_t size) {
+  uint8_t* start = NULL;
+  size_t   full_size = 0;
+  mi_commit_mask_t mask;
+  mi_segment_commit_mask(segment, false /* conservative? */, p, size, &start, &full_size, &mask);
+  if (!mi_commit_mask_any_set(&segment->purged_mask, &mask)) return;
+  const mi_msecs_t delay = mi_segment_purge_delay(segment);
+  if (_mi_purge_reused_soon(segment->purged_at, delay)) {
+    segment->purge_delay = _mi_purge_delay_adapt(delay, true /* reused */, 1);
+  }
+  segment->purged_at = 0;  // only once per purge
+}
+
 static bool mi_segment_commit(mi_segment_t* segment, uint8_t* p, size_t size) {
   mi_assert_internal(mi_commit_mask_all_set(&segment->commit_mask, &segment->purge_mask));
 
@@ -516,7 +564,7 @@ static bool mi_segment_commit(mi_segment_t* segment, uint8_t* p, size_t size) {
 
   // increase purge expiration when using part of delayed purges -- we assume more allocations are coming soon.
   if (mi_commit_mask_any_set(&segment->purge_mask, &mask)) {
-    segment->purge_expire = _mi_clock_now() + mi_option_get(mi_option_purge_delay);
+    segment->purge_expire = _mi_clock_now() + mi_segment_purge_delay(segment);
   }
 
   // always clear any delayed purges in our range (as they are either committed now)
@@ -525,11 +573,17 @@ static bool mi_segment_commit(mi_segment_t* segment, uint8_t* p, size_t size) {
 }
 
 static bool mi_segment_ensure_committed(mi_segment_t* segment, uint8_t* p, size_t size) {
-  mi_assert_internal(mi_commit_mask_all_set(&segment->commit_mask, &segment->purge_mask));
-  // note: assumes commit_mask is always full for huge segments as otherwise the commit mask bits can overflow
-  if (mi_commit_mask_is_full(&segment->commit_mask) && mi_commit_mask_is_empty(&segment->purge_mask)) return true; // fully committed
-  mi_assert_internal(segment->kind != MI_SEGMENT_HUGE);
-  return mi_segment_commit(segment, p, size);
+  bool ok = true;
+  mi_lock_maybe(&segment->purge_lock, segment->purge_background) {  // the purge thread may be purging concurrently
+    mi_assert_internal(mi_commit_mask_all_set(&segment->commit_mask, &segment->purge_mask));
+    if mi_unlikely(segment->purged_at != 0) { mi_segment_purge_note_reuse(segment, p, size); }
+    // note: assumes commit_mask is always full for huge segments as otherwise the commit mask bits can overflow
+    if (!mi_commit_mask_is_full(&segment->commit_mask) || !mi_commit_mask_is_empty(&segment->purge_mask)) { // not fully committed
+      mi_assert_internal(segment->kind != MI_SEGMENT_HUGE);
+      ok = mi_segment_commit(segment, p, size);
+    }
+  }
+  return ok;
 }
 
 static bool mi_segment_purge(mi_segment_t* segment, uint8_t* p, size_t size) {
@@ -561,47 +615,76 @@ static bool mi_segment_purge(mi_segment_t* segment, uint8_t* p, size_t size) {
   return true;
 }
 
+// register a range in the purge mask for a delayed purge.
+// returns `true` if the previously scheduled purges are long expired and should be purged right away.
+static bool mi_segment_delay_purge(mi_segment_t* segment, uint8_t* p, size_t size) {
+  uint8_t* start = NULL;
+  size_t   full_size = 0;
+  mi_commit_mask_t mask;
+  mi_segment_commit_mask(segment, true /*conservative*/, p, size, &start, &full_size, &mask);
+  if (mi_commit_mask_is_empty(&mask) || full_size==0) return false;
+
+  // update delayed commit
+  mi_assert_internal(segment->purge_expire > 0 || mi_commit_mask_is_empty(&segment->purge_mask));
+  mi_commit_mask_t cmask;
+  mi_commit_mask_create_intersect(&segment->commit_mask, &mask, &cmask);  // only purge what is committed; span_free may try to decommit more
+  mi_commit_mask_set(&segment->purge_mask, &cmask);
+  mi_msecs_t now = _mi_clock_now();
+  if (segment->purge_expire == 0) {
+    // no previous purgess, initialize now
+    segment->purge_expire = now + mi_segment_purge_delay(segment);
+  }
+  else if (segment->purge_expire <= now) {
+    // previous purge mask already expired
+    if (segment->purge_expire + mi_option_get(mi_option_purge_extend_delay) <= now) {
+      return true;
+    }
+    else {
+      segment->purge_expire = now + mi_option_get(mi_option_purge_extend_delay); // (mi_option_get(mi_option_purge_delay) / 8); // wait a tiny bit longer in case there is a series of free's
+    }
+  }
+  else {
+    // previous purge mask is not yet expired, increase the expiration by a bit.
+    segment->purge_expire += mi_option_get(mi_option_purge_extend_delay);
+  }
+  return false;
+}
+
 static void mi_segment_schedule_purge(mi_segment_t* segment, uint8_t* p, size_t size) {
   if (!segment->allow_purge) return;
 
-  if (mi_option_get(mi_option_purge_delay) == 0) {
-    mi_segment_purge(segment, p, size);
-  }
-  else {
-    // register for future purge in the purge mask
-    uint8_t* start = NULL;
-    size_t   full_size = 0;
-    mi_commit_mask_t mask;
-    mi_segment_commit_mask(segment, true /*conservative*/, p, size, &start, &full_size, &mask);
-    if (mi_commit_mask_is_empty(&mask) || full_size==0) return;
-
-    // update delayed commit
-    mi_assert_internal(segment->purge_expire > 0 || mi_commit_mask_is_empty(&segment->purge_mask));
-    mi_commit_mask_t cmask;
-    mi_commit_mask_create_intersect(&segment->commit_mask, &mask, &cmask);  // only purge what is committed; span_free may try to decommit more
-    mi_commit_mask_set(&segment->purge_mask, &cmask);
-    mi_msecs_t now = _mi_clock_now();
-    if (segment->purge_expire == 0) {
-      // no previous purgess, initialize now
-      segment->purge_expire = now + mi_option_get(mi_option_purge_delay);
-    }
-    else if (segment->purge_expire <= now) {
-      // previous purge mask already expired
-      if (segment->purge_expire + mi_option_get(mi_option_purge_extend_delay) <= now) {
-        mi_segment_try_purge(segment, true);
-      }
-      else {
-        segment->purge_expire = now + mi_option_get(mi_option_purge_extend_delay); // (mi_option_get(mi_option_purge_delay) / 8); // wait a tiny bit longer in case there is a series of free's
+  if mi_unlikely(!segment->purge_background && segment->kind == MI_SEGMENT_NORMAL && _mi_purge_thread_is_running()) {
+    // from now on leave delayed purges to the purge thread (as we own the segment it cannot be posted yet)
+    mi_lock_init(&segment->purge_lock);
+    segment->purge_background = true;
+  }
+
+  if (segment->purge_background) {
+    // only schedule, and post the segment to the purge thread if it was not yet posted
+    bool       post = false;
+    bool       expired = false;
+    mi_msecs_t expire = 0;
+    mi_lock(&segment->purge_lock) {
+      expired = mi_segment_delay_purge(segment, p, size);
+      expire = segment->purge_expire;
+      if (expire != 0 && !segment->purge_posted) {
+        segment->purge_posted = true;
+        post = true;
       }
     }
-    else {
-      // previous purge mask is not yet expired, increase the expiration by a bit.
-      segment->purge_expire += mi_option_get(mi_option_purge_extend_delay);
-    }
+    if (post) { _mi_purge_segment_post(segment, expire); }
+    else if (expired) { _mi_purge_thread_wakeup(expire); }
+  }
+  else if (mi_option_get(mi_option_purge_delay) == 0) {
+    mi_segment_purge(segment, p, size);
+  }
+  else if (mi_segment_delay_purge(segment, p, size)) {
+    mi_segment_try_purge(segment, true);
   }
 }
 
-static void mi_segment_try_purge(mi_segment_t* segment, bool force) {
+// purge the scheduled ranges if they are expired (or if `force` is set)
+static void mi_segment_purge_scheduled(mi_segment_t* segment, bool force) {
   if (!segment->allow_purge || segment->purge_expire == 0 || mi_commit_mask_is_empty(&segment->purge_mask)) return;
   mi_msecs_t now = _mi_clock_now();
   if (!force && now < segment->purge_expire) return;
@@ -610,6 +693,15 @@ static void mi_segment_try_purge(mi_segment_t* segment, bool force) {
   segment->purge_expire = 0;
   mi_commit_mask_create_empty(&segment->purge_mask);
 
+  if (!force && segment->kind != MI_SEGMENT_HUGE && _mi_purge_is_adaptive()) {
+    // the previous delayed purge was not reused (see `mi_segment_purge_note_reuse`): shorten the delay
+    if (segment->purged_at != 0) {
+      segment->purge_delay = _mi_purge_delay_adapt(mi_segment_purge_delay(segment), false /* reused */, 1);
+    }
+    segment->purged_at = now;
+    segment->purged_mask = mask;
+  }
+
   size_t idx;
   size_t count;
   mi_commit_mask_foreach(&mask, idx, count) {
@@ -624,10 +716,53 @@ static void mi_segment_try_purge(mi_segment_t* segment, bool force) {
   mi_assert_internal(mi_commit_mask_is_empty(&segment->purge_mask));
 }
 
+static void mi_segment_try_purge(mi_segment_t* segment, bool force) {
+  if (segment->purge_background) {
+    // leave it to the purge thread; if forced, let the scheduled purges expire right away
+    if (!force) return;
+    mi_msecs_t expire = 0;
+    mi_lock(&segment->purge_lock) {
+      if (segment->purge_expire != 0) {
+        expire = segment->purge_expire = _mi_clock_now();
+      }
+    }
+    if (expire != 0) { _mi_purge_thread_wakeup(expire); }
+  }
+  else {
+    mi_segment_purge_scheduled(segment, force);
+  }
+}
+
+// called by the purge thread for a posted segment (see `purge.c`)
+// returns the expiration of the remaining scheduled purges, or 0 if there are none (and the segment is no longer posted)
+mi_msecs_t _mi_segment_purge_expired(mi_segment_t* segment) {
+  mi_assert_internal(segment->purge_background && segment->purge_posted);
+  mi_msecs_t expire = 0;
+  mi_lock(&segment->purge_lock) {
+    mi_segment_purge_scheduled(segment, false);
+    if (mi_commit_mask_is_empty(&segment->purge_mask)) {
+      segment->purge_expire = 0;
+      segment->purge_posted = false;
+    }
+    else {
+      expire = segment->purge_expire;
+    }
+  }
+  return expire;
+}
+
 // called from `mi_heap_collect_ex`
 // this can be called per-page so it is important that try_purge has fast exit path
 void _mi_segment_collect(mi_segment_t* segment, bool force) {
-  mi_segment_try_purge(segment, force);
+  if (force && segment->purge_background) {
+    // an explicit forced collection purges right away (instead of leaving it to the purge thread)
+    mi_lock(&segment->purge_lock) {
+      mi_segment_purge_scheduled(segment, true);
+    }
+  }
+  else {
+    mi_segment_try_purge(segment, force);
+  }
 }
 
 /* -----------------------------------------------------------
@@ -738,26 +873,8 @@ static mi_slice_t* mi_segment_span_free_coalesce(mi_slice_t* slice, mi_segments_
    Page allocation
 ----------------------------------------------------------- */
 
-// Note: may still return NULL if committing the memory failed
-static mi_page_t* mi_segment_span_allocate(mi_segment_t* segment, size_t slice_index, size_t slice_count) {
-  mi_assert_internal(slice_index < segment->slice_entries);
-  mi_slice_t* const slice = &segment->slices[slice_index];
-  mi_assert_internal(slice->block_size==0 || slice->block_size==1);
-
-  // commit before changing the slice data
-  if (!mi_segment_ensure_committed(segment, _mi_segment_page_start_from_slice(segment, slice, 0, NULL), slice_count * MI_SEGMENT_SLICE_SIZE)) {
-    return NULL;  // commit failed!
-  }
-
-  // convert the slices to a page
-  slice->slice_offset = 0;
-  slice->slice_count = (uint32_t)slice_count;
-  mi_assert_internal(slice->slice_count == slice_count);
-  const size_t bsize = slice_count * MI_SEGMENT_SLICE_SIZE;
-  slice->block_size = bsize;
-  mi_page_t*  page = mi_slice_to_page(slice);
-  mi_assert_internal(mi_page_block_size(page) == bsize);
-
+// Set the slice back pointers of a used span of `slice_count` slices starting at `slice`.
+static void mi_segment_span_set_back_offsets(mi_segment_t* segment, mi_slice_t* slice, size_t slice_index, size_t slice_count) {
   // set slice back pointers for the first MI_MAX_SLICE_OFFSET_COUNT entries
   size_t extra = slice_count-1;
   if (extra > MI_MAX_SLICE_OFFSET_COUNT) extra = MI_MAX_SLICE_OFFSET_COUNT;
@@ -780,15 +897,59 @@ static mi_page_t* mi_segment_span_allocate(mi_segment_t* segment, size_t slice_i
     last->slice_count = 0;
     last->block_size = 1;
   }
+}
+
+// Note: may still return NULL if committing the memory failed
+static mi_page_t* mi_segment_span_allocate(mi_segment_t* segment, size_t slice_index, size_t slice_count) {
+  mi_assert_internal(slice_index < segment->slice_entries);
+  mi_slice_t* const slice = &segment->slices[slice_index];
+  mi_assert_internal(slice->block_size==0 || slice->block_size==1);
+
+  // commit before changing the slice data
+  if (!mi_segment_ensure_committed(segment, _mi_segment_page_start_from_slice(segment, slice, 0, NULL), slice_count * MI_SEGMENT_SLICE_SIZE)) {
+    return NULL;  // commit failed!
+  }
+
+  // convert the slices to a page
+  slice->slice_offset = 0;
+  slice->slice_count = (uint32_t)slice_count;
+  mi_assert_internal(slice->slice_count == slice_count);
+  const size_t bsize = slice_count * MI_SEGMENT_SLICE_SIZE;
+  slice->block_size = bsize;
+  mi_page_t*  page = mi_slice_to_page(slice);
+  mi_assert_internal(mi_page_block_size(page) == bsize);
+  mi_segment_span_set_back_offsets(segment, slice, slice_index, slice_count);
 
   // and initialize the page
   page->is_committed = true;
   page->is_zero_init = segment->free_is_zero;
   page->is_huge = (segment->kind == MI_SEGMENT_HUGE);
+  page->is_sparse = false;
   segment->used++;
   return page;
 }
 
+/* -----------------------------------------------------------
+   NUMA affinity
+----------------------------------------------------------- */
+
+// The numa node of the thread: either the node it is bound to, or the (cached) current node
+static int mi_segments_tld_numa_node(mi_segments_tld_t* tld) {
+  if (tld->numa_bound >= 0) return tld->numa_bound;
+  if mi_unlikely(tld->numa_node < 0) { tld->numa_node = _mi_os_numa_node(); }
+  return tld->numa_node;
+}
+
+// Is the segment located at the given numa node? (where a negative node matches any)
+static bool mi_segment_is_numa_suitable(const mi_segment_t* segment, int numa_node) {
+  return (numa_node < 0 || segment->numa_node < 0 || segment->numa_node == numa_node);
+}
+
+// Does the segment follow the given transparent huge page policy? (where a negative policy matches any)
+static bool mi_segment_is_thp_suitable(const mi_segment_t* segment, int thp) {
+  return (thp < 0 || segment->thp == thp);
+}
+
 static void mi_segment_slice_split(mi_segment_t* segment, mi_slice_t* slice, size_t slice_count, mi_segments_tld_t* tld) {
   mi_assert_internal(_mi_ptr_segment(slice) == segment);
   mi_assert_internal(slice->slice_count >= slice_count);
@@ -801,7 +962,7 @@ static void mi_segment_slice_split(mi_segment_t* segment, mi_slice_t* slice, siz
   slice->slice_count = (uint32_t)slice_count;
 }
 
-static mi_page_t* mi_segments_page_find_and_allocate(size_t slice_count, mi_arena_id_t req_arena_id, mi_segments_tld_t* tld) {
+static mi_page_t* mi_segments_page_find_and_allocate(size_t slice_count, mi_arena_id_t req_arena_id, int req_numa_node, int req_thp, mi_segments_tld_t* tld) {
   mi_assert_internal(slice_count*MI_SEGMENT_SLICE_SIZE <= MI_LARGE_OBJ_SIZE_MAX);
   // search from best fit up
   mi_span_queue_t* sq = mi_span_queue_for(slice_count, tld);
@@ -811,7 +972,7 @@ static mi_page_t* mi_segments_page_find_and_allocate(size_t slice_count, mi_aren
       if (slice->slice_count >= slice_count) {
         // found one
         mi_segment_t* segment = _mi_ptr_segment(slice);
-        if (_mi_arena_memid_is_suitable(segment->memid, req_arena_id)) {
+        if (_mi_arena_memid_is_suitable(segment->memid, req_arena_id) && mi_segment_is_numa_suitable(segment, req_numa_node) && mi_segment_is_thp_suitable(segment, req_thp)) {
           // found a suitable page span
           mi_span_queue_delete(sq, slice);
 
@@ -836,17 +997,77 @@ static mi_page_t* mi_segments_page_find_and_allocate(size_t slice_count, mi_aren
 }
 
 
+/* -----------------------------------------------------------
+   Large page resize
+   A large page holds a single block that spans its slices.
+   It can grow in place by claiming (a part of) the adjacent
+   free span, or shrink by splitting off its tail slices which
+   are then coalesced with any following free span.
+----------------------------------------------------------- */
+
+// Try to resize a large page in place to hold a block of at least `block_size` bytes.
+// On success the block extends to the end of the page (and its block size is updated).
+bool _mi_segment_large_page_resize(mi_page_t* page, size_t block_size, mi_segments_tld_t* tld) {
+  mi_segment_t* const segment = _mi_page_segment(page);
+  mi_assert_internal(segment->kind != MI_SEGMENT_HUGE);
+  mi_assert_internal(page->reserved == 1 && page->used == 1);
+  mi_assert_internal(block_size > MI_MEDIUM_OBJ_SIZE_MAX && block_size <= MI_LARGE_OBJ_SIZE_MAX);
+  if (segment->thread_id != _mi_thread_id()) return false;
+
+  mi_slice_t* const slice = mi_page_to_slice(page);
+  const size_t slice_index = mi_slice_index(slice);
+  const size_t slice_count = slice->slice_count;
+  const size_t new_count = _mi_divide_up(block_size, MI_SEGMENT_SLICE_SIZE);
+  if (new_count > slice_count) {
+    // grow: claim the start of the next span if it is free and large enough
+    mi_slice_t* const next = slice + slice_count;
+    if (next >= mi_segment_slices_end(segment) || next->block_size != 0) return false;
+    mi_assert_internal(next->slice_count > 0 && next->slice_offset == 0);
+    const size_t next_count = next->slice_count;
+    const size_t extra = new_count - slice_count;
+    if (next_count < extra) return false;
+    if (!mi_segment_ensure_committed(segment, mi_slice_start(next), extra * MI_SEGMENT_SLICE_SIZE)) return false;
+    mi_segment_span_remove_from_queue(next, tld);
+    if (next_count > extra) {
+      mi_segment_span_free(segment, slice_index + new_count, next_count - extra, false /* don't purge left-over part */, tld);
+    }
+    slice->slice_count = (uint32_t)new_count;
+    mi_segment_span_set_back_offsets(segment, slice, slice_index, new_count);
+  }
+  else if (new_count < slice_count) {
+    // shrink: split off the tail and coalesce it with a following free span
+    slice->slice_count = (uint32_t)new_count;
+    mi_segment_span_set_back_offsets(segment, slice, slice_index, new_count);
+    mi_slice_t* const tail = slice + new_count;
+    tail->slice_count = (uint32_t)(slice_count - new_count);
+    tail->slice_offset = 0;
+    tail->block_size = 0;
+    mi_segment_span_free_coalesce(tail, tld);
+  }
+
+  // the block now spans the full page
+  const size_t old_bsize = mi_page_block_size(page);
+  const size_t new_bsize = new_count * MI_SEGMENT_SLICE_SIZE;
+  mi_assert_internal(_mi_segment_page_start_from_slice(segment, slice, new_bsize, NULL) == mi_page_start(page));
+  page->block_size = new_bsize;
+  page->block_size_shift = (_mi_is_power_of_two(new_bsize) ? (uint8_t)mi_ctz(new_bsize) : 0);
+  if (new_bsize > old_bsize) { _mi_stat_increase(&tld->stats->page_committed, new_bsize - old_bsize); }
+                        else { _mi_stat_decrease(&tld->stats->page_committed, old_bsize - new_bsize); }
+  mi_assert_expensive(mi_segment_is_valid(segment, tld));
+  return true;
+}
+
 /* -----------------------------------------------------------
    Segment allocation
 ----------------------------------------------------------- */
 
-static mi_segment_t* mi_segment_os_alloc( size_t required, size_t page_alignment, bool eager_delayed, mi_arena_id_t req_arena_id,
+static mi_segment_t* mi_segment_os_alloc( size_t required, size_t page_alignment, bool eager_delayed, mi_arena_id_t req_arena_id, int req_numa_node, int req_thp,
                                           size_t* psegment_slices, size_t* pinfo_slices,
-                                          bool commit, mi_segments_tld_t* tld)
+                                          bool commit, bool remappable, mi_segments_tld_t* tld)
 
 {
   mi_memid_t memid;
-  bool   allow_large = (!eager_delayed && (MI_SECURE == 0)); // only allow large OS pages once we are no longer lazy
+  bool   allow_large = (!eager_delayed && (MI_SECURE == 0) && req_thp != 0); // only allow large OS pages once we are no longer lazy (and huge pages are not avoided)
   size_t align_offset = 0;
   size_t alignment = MI_SEGMENT_ALIGN;
 
@@ -863,10 +1084,29 @@ static mi_segment_t* mi_segment_os_alloc( size_t required, size_t page_alignment
   }
 
   const size_t segment_size = (*psegment_slices) * MI_SEGMENT_SLICE_SIZE;
-  mi_segment_t* segment = (mi_segment_t*)_mi_arena_alloc_aligned(segment_size, alignment, align_offset, commit, allow_large, req_arena_id, &memid);
+  mi_segment_t* segment = NULL;
+  if (remappable) {
+    mi_assert_internal(page_alignment == 0);
+    segment = (mi_segment_t*)_mi_os_alloc_remappable(segment_size, alignment, &memid);
+  }
+  const int numa_node = (req_numa_node >= 0 ? req_numa_node : mi_segments_tld_numa_node(tld));
+  if (segment == NULL) {
+    segment = (mi_segment_t*)_mi_arena_alloc_aligned(segment_size, alignment, align_offset, commit, allow_large, req_arena_id, numa_node, &memid);
+  }
   if (segment == NULL) {
     return NULL;  // failed to allocate
   }
+  const int arena_numa_node = _mi_arena_memid_numa_node(memid);
+  bool numa_bound = false;
+  if (req_numa_node >= 0 && arena_numa_node < 0) {
+    // bind memory without numa affinity (from the OS or a generic arena) to the requested node before it is touched
+    numa_bound = _mi_os_numa_bind(segment, segment_size, req_numa_node);
+  }
+  const bool thp_advised = mi_segment_thp_advisable(req_thp, memid);
+  if (thp_advised) {
+    // advise on transparent huge pages before the memory is touched
+    _mi_os_set_thp(segment, segment_size, req_thp > 0);
+  }
 
   // ensure metadata part of the segment is committed
   mi_commit_mask_t commit_mask;
@@ -880,6 +1120,8 @@ static mi_segment_t* mi_segment_os_alloc( size_t required, size_t page_alignment
     mi_commit_mask_create(0, commit_needed, &commit_mask);
     mi_assert_internal(commit_needed*MI_COMMIT_SIZE >= (*pinfo_slices)*MI_SEGMENT_SLICE_SIZE);
     if (!_mi_os_commit(segment, commit_needed*MI_COMMIT_SIZE, NULL)) {
+      if (numa_bound && !mi_memkind_is_os(memid.memkind)) { _mi_os_numa_unbind(segment, segment_size); }
+      if (thp_advised && !mi_memkind_is_os(memid.memkind)) { _mi_os_reset_thp(segment, segment_size); }
       _mi_arena_free(segment,segment_size,0,memid);
       return NULL;
     }
@@ -891,21 +1133,31 @@ static mi_segment_t* mi_segment_os_alloc( size_t required, size_t page_alignment
   segment->allow_purge = segment->allow_decommit && (mi_option_get(mi_option_purge_delay) >= 0);
   segment->segment_size = segment_size;
   segment->subproc = tld->subproc;
+  segment->numa_node = (arena_numa_node >= 0 ? arena_numa_node : numa_node);
+  segment->numa_bound = numa_bound;
+  segment->thp = (memid.is_pinned ? -1 : req_thp);
   segment->commit_mask = commit_mask;
   segment->purge_expire = 0;
   segment->free_is_zero = memid.initially_zero;
   mi_commit_mask_create_empty(&segment->purge_mask);
+  segment->purge_background = false;  // set on the first scheduled purge if the purge thread is running
+  segment->purge_delay = 0;
+  segment->purged_at = 0;
+  mi_commit_mask_create_empty(&segment->purged_mask);
 
   mi_segments_track_size((long)(segment_size), tld);
   _mi_segment_map_allocated_at(segment);
+  mi_usdt_probe3(segment_alloc, segment, segment_size, (required == 0 ? MI_SEGMENT_NORMAL : MI_SEGMENT_HUGE));
+  mi_trace_record(mi_trace_segment_alloc, segment, segment_size, (required == 0 ? MI_SEGMENT_NORMAL : MI_SEGMENT_HUGE));
   return segment;
 }
 
 
 // Allocate a segment from the OS aligned to `MI_SEGMENT_SIZE` .
-static mi_segment_t* mi_segment_alloc(size_t required, size_t page_alignment, mi_arena_id_t req_arena_id, mi_segments_tld_t* tld, mi_page_t** huge_page)
+static mi_segment_t* mi_segment_alloc(size_t required, size_t page_alignment, mi_arena_id_t req_arena_id, int req_numa_node, int req_thp, bool remappable, mi_segments_tld_t* tld, mi_page_t** huge_page)
 {
   mi_assert_internal((required==0 && huge_page==NULL) || (required>0 && huge_page != NULL));
+  mi_assert_internal(!remappable || required>0);
 
   // calculate needed sizes first
   size_t info_slices;
@@ -920,8 +1172,8 @@ static mi_segment_t* mi_segment_alloc(size_t required, size_t page_alignment, mi
   bool commit = eager || (required > 0);
 
   // Allocate the segment from the OS
-  mi_segment_t* segment = mi_segment_os_alloc(required, page_alignment, eager_delay, req_arena_id,
-                                              &segment_slices, &info_slices, commit, tld);
+  mi_segment_t* segment = mi_segment_os_alloc(required, page_alignment, eager_delay, req_arena_id, req_numa_node, req_thp,
+                                              &segment_slices, &info_slices, commit, remappable, tld);
   if (segment == NULL) return NULL;
 
   // zero the segment info? -- not always needed as it may be zero initialized from the OS
@@ -936,7 +1188,7 @@ static mi_segment_t* mi_segment_alloc(size_t required, size_t page_alignment, mi
   const size_t slice_entries = (segment_slices > MI_SLICES_PER_SEGMENT ? MI_SLICES_PER_SEGMENT : segment_slices);
   segment->segment_slices = segment_slices;
   segment->segment_info_slices = info_slices;
-  segment->thread_id = _mi_thread_id();
+  segment->thread_id = tld->thread_id;
   segment->cookie = _mi_ptr_cookie(segment);
   segment->slice_entries = slice_entries;
   segment->kind = (required == 0 ? MI_SEGMENT_NORMAL : MI_SEGMENT_HUGE);
@@ -1032,10 +1284,16 @@ static mi_slice_t* mi_segment_page_clear(mi_page_t* page, mi_segments_tld_t* tld
   mi_segment_t* segment = _mi_ptr_segment(page);
   mi_assert_internal(segment->used > 0);
 
+  // destruct object cache blocks before the page memory is reset or reused
+  if mi_unlikely(mi_page_is_objcache(page)) {
+    _mi_objcache_page_free(page);
+  }
+
   size_t inuse = page->capacity * mi_page_block_size(page);
   _mi_stat_decrease(&tld->stats->page_committed, inuse);
   _mi_stat_decrease(&tld->stats->pages, 1);
   _mi_stat_decrease(&tld->stats->page_bins[_mi_page_stats_bin(page)], 1);
+  mi_stat_lite_add(tld->stats_lite->pages_freed, 1);
   
   // reset the page memory to reduce memory pressure?
   if (segment->allow_decommit && mi_option_is_enabled(mi_option_deprecated_page_reset)) {
@@ -1046,6 +1304,7 @@ static mi_slice_t* mi_segment_page_clear(mi_page_t* page, mi_segments_tld_t* tld
 
   // zero the page data, but not the segment fields and heap tag
   page->is_zero_init = false;
+  page->is_sparse = false;
   uint8_t heap_tag = page->heap_tag;
   ptrdiff_t ofs = offsetof(mi_page_t, capacity);
   _mi_memzero((uint8_t*)page + ofs, sizeof(*page) - ofs);
@@ -1137,6 +1396,8 @@ static void mi_segment_abandon(mi_segment_t* segment, mi_segments_tld_t* tld) {
   // all pages in the segment are abandoned; add it to the abandoned list
   _mi_stat_increase(&tld->stats->segments_abandoned, 1);
   mi_segments_track_size(-((long)mi_segment_size(segment)), tld);
+  mi_usdt_probe2(segment_abandon, segment, segment->used);
+  mi_trace_record(mi_trace_segment_abandon, segment, mi_segment_size(segment), segment->used);
   segment->thread_id = 0;
   segment->abandoned_visits = 1;   // from 0 to 1 to signify it is abandoned
   if (segment->was_reclaimed) {
@@ -1225,13 +1486,15 @@ static mi_segment_t* mi_segment_reclaim(mi_segment_t* segment, mi_heap_t* heap,
   // can be 0 still with abandoned_next, or already a thread id for segments outside an arena that are reclaimed on a free.
   mi_assert_internal(mi_atomic_load_relaxed(&segment->thread_id) == 0 || mi_atomic_load_relaxed(&segment->thread_id) == _mi_thread_id());
   mi_assert_internal(segment->subproc == heap->tld->segments.subproc); // only reclaim within the same subprocess
-  mi_atomic_store_release(&segment->thread_id, _mi_thread_id());
+  mi_atomic_store_release(&segment->thread_id, heap->thread_id);
   segment->abandoned_visits = 0;
   segment->was_reclaimed = true;
   tld->reclaim_count++;
   mi_segments_track_size((long)mi_segment_size(segment), tld);
   mi_assert_internal(segment->next == NULL);
   _mi_stat_decrease(&tld->stats->segments_abandoned, 1);
+  mi_usdt_probe2(segment_reclaim, segment, segment->used);
+  mi_trace_record(mi_trace_segment_reclaim, segment, mi_segment_size(segment), segment->used);
 
   // for all slices
   const mi_slice_t* end;
@@ -1296,6 +1559,8 @@ bool _mi_segment_attempt_reclaim(mi_heap_t* heap, mi_segment_t* segment) {
   if (mi_atomic_load_relaxed(&segment->thread_id) != 0) return false;  // it is not abandoned
   if (segment->subproc != heap->tld->segments.subproc)  return false;  // only reclaim within the same subprocess
   if (!_mi_heap_memid_is_suitable(heap,segment->memid)) return false;  // don't reclaim between exclusive and non-exclusive arena's
+  if (!mi_segment_is_numa_suitable(segment, _mi_heap_numa_node(heap))) return false;  // or into a heap bound to another numa node
+  if (!mi_segment_is_thp_suitable(segment, heap->thp)) return false;  // or with another huge page policy
   const long target = _mi_option_get_fast(mi_option_target_segments_per_thread);
   if (target > 0 && (size_t)target <= heap->tld->segments.count) return false; // don't reclaim if going above the target count
 
@@ -1356,10 +1621,11 @@ static mi_segment_t* mi_segment_try_reclaim(mi_heap_t* heap, size_t needed_slice
   {
     mi_assert(segment->subproc == heap->tld->segments.subproc); // cursor only visits segments in our sub-process
     segment->abandoned_visits++;
-    // todo: should we respect numa affinity for abandoned reclaim? perhaps only for the first visit?
     // todo: an arena exclusive heap will potentially visit many abandoned unsuitable segments and use many tries
     // Perhaps we can skip non-suitable ones in a better way?
-    bool is_suitable = _mi_heap_memid_is_suitable(heap, segment->memid);
+    bool is_suitable = _mi_heap_memid_is_suitable(heap, segment->memid) && mi_segment_is_numa_suitable(segment, _mi_heap_numa_node(heap)) && mi_segment_is_thp_suitable(segment, heap->thp);
+    // prefer segments at our own numa node: on the first visit we skip segments at other nodes
+    const bool is_local = (segment->abandoned_visits > 1 || mi_segment_is_numa_suitable(segment, mi_segments_tld_numa_node(tld)));
     bool has_page = mi_segment_check_free(segment,needed_slices,block_size,tld); // try to free up pages (due to concurrent frees)
     if (segment->used == 0) {
       // free the segment (by forced reclaim) to make it available to other threads.
@@ -1369,7 +1635,7 @@ static mi_segment_t* mi_segment_try_reclaim(mi_heap_t* heap, size_t needed_slice
       // freeing but that would violate some invariants temporarily)
       mi_segment_reclaim(segment, heap, 0, NULL, tld);
     }
-    else if (has_page && is_suitable) {
+    else if (has_page && is_suitable && is_local) {
       // found a large enough free span, or a page of the right block_size with free space
       // we return the result of reclaim (which is usually `segment`) as it might free
       // the segment due to concurrent frees (in which case `NULL` is returned).
@@ -1525,7 +1791,9 @@ static mi_segment_t* mi_segment_reclaim_or_alloc(mi_heap_t* heap, size_t needed_
 
   // 1. try to reclaim an abandoned segment
   bool reclaimed;
+  const mi_nsecs_t reclaim_start = mi_stat_latency_start();
   mi_segment_t* segment = mi_segment_try_reclaim(heap, needed_slices, block_size, &reclaimed, tld);
+  mi_stat_latency_end(tld->stats, mi_latency_segment_reclaim, reclaim_start);
   if (reclaimed) {
     // reclaimed the right page right into the heap
     mi_assert_internal(segment != NULL);
@@ -1536,7 +1804,10 @@ static mi_segment_t* mi_segment_reclaim_or_alloc(mi_heap_t* heap, size_t needed_
     return segment;
   }
   // 2. otherwise allocate a fresh segment
-  return mi_segment_alloc(0, 0, heap->arena_id, tld, NULL);
+  const mi_nsecs_t alloc_start = mi_stat_latency_start();
+  segment = mi_segment_alloc(0, 0, heap->arena_id, _mi_heap_numa_node(heap), heap->thp, false, tld, NULL);
+  mi_stat_latency_end(tld->stats, mi_latency_segment_alloc, alloc_start);
+  return segment;
 }
 
 
@@ -1552,7 +1823,7 @@ static mi_page_t* mi_segments_page_alloc(mi_heap_t* heap, mi_page_kind_t page_ki
   size_t page_size = _mi_align_up(required, (required > MI_MEDIUM_PAGE_SIZE ? MI_MEDIUM_PAGE_SIZE : MI_SEGMENT_SLICE_SIZE));
   size_t slices_needed = page_size / MI_SEGMENT_SLICE_SIZE;
   mi_assert_internal(slices_needed * MI_SEGMENT_SLICE_SIZE == page_size);
-  mi_page_t* page = mi_segments_page_find_and_allocate(slices_needed, heap->arena_id, tld); //(required <= MI_SMALL_SIZE_MAX ? 0 : slices_needed), tld);
+  mi_page_t* page = mi_segments_page_find_and_allocate(slices_needed, heap->arena_id, _mi_heap_numa_node(heap), heap->thp, tld); //(required <= MI_SMALL_SIZE_MAX ? 0 : slices_needed), tld);
   if (page==NULL) {
     // no free page, allocate a new segment and try again
     if (mi_segment_reclaim_or_alloc(heap, slices_needed, block_size, tld) == NULL) {
@@ -1565,7 +1836,7 @@ static mi_page_t* mi_segments_page_alloc(mi_heap_t* heap, mi_page_kind_t page_ki
     }
   }
   mi_assert_internal(page != NULL && page->slice_count*MI_SEGMENT_SLICE_SIZE == page_size);
-  mi_assert_internal(_mi_ptr_segment(page)->thread_id == _mi_thread_id());
+  mi_assert_internal(_mi_ptr_segment(page)->thread_id == tld->thread_id);
   mi_segment_try_purge(_mi_ptr_segment(page), false);
   return page;
 }
@@ -1576,10 +1847,26 @@ static mi_page_t* mi_segments_page_alloc(mi_heap_t* heap, mi_page_kind_t page_ki
    Huge page allocation
 ----------------------------------------------------------- */
 
-static mi_page_t* mi_segment_huge_page_alloc(size_t size, size_t page_alignment, mi_arena_id_t req_arena_id, mi_segments_tld_t* tld)
+// Allocate huge blocks above the `remap_threshold` in their own remappable OS area
+static bool mi_segment_huge_use_remap(size_t size, size_t page_alignment, mi_arena_id_t req_arena_id) {
+  #if MI_HUGE_PAGE_ABANDON || (MI_SECURE>0) || (MI_INTPTR_SIZE<8)
+  MI_UNUSED(size); MI_UNUSED(page_alignment); MI_UNUSED(req_arena_id);
+  return false;
+  #else
+  if (page_alignment > 0 || req_arena_id != _mi_arena_id_none() || !_mi_os_has_remap()) return false;
+  if (mi_option_is_enabled(mi_option_disallow_os_alloc)) return false;
+  const size_t threshold = mi_option_get_size(mi_option_remap_threshold);
+  return (threshold > 0 && size >= threshold);
+  #endif
+}
+
+static mi_page_t* mi_segment_huge_page_alloc(size_t size, size_t page_alignment, mi_arena_id_t req_arena_id, int req_numa_node, int req_thp, mi_segments_tld_t* tld)
 {
   mi_page_t* page = NULL;
-  mi_segment_t* segment = mi_segment_alloc(size,page_alignment,req_arena_id,tld,&page);
+  const bool remappable = mi_segment_huge_use_remap(size, page_alignment, req_arena_id);
+  const mi_nsecs_t alloc_start = mi_stat_latency_start();
+  mi_segment_t* segment = mi_segment_alloc(size,page_alignment,req_arena_id,req_numa_node,req_thp,remappable,tld,&page);
+  mi_stat_latency_end(tld->stats, mi_latency_segment_alloc, alloc_start);
   if (segment == NULL || page==NULL) return NULL;
   mi_assert_internal(segment->used==1);
   mi_assert_internal(mi_page_block_size(page) >= size);
@@ -1654,6 +1941,85 @@ void _mi_segment_huge_page_reset(mi_segment_t* segment, mi_page_t* page, mi_bloc
 }
 #endif
 
+// Try to resize the block of a huge page in place to at least `block_size` bytes within its current segment.
+// When shrinking, the released tail is reset right away as huge segments cannot be purged through the commit mask.
+bool _mi_segment_huge_page_resize(mi_page_t* page, size_t block_size, mi_segments_tld_t* tld) {
+  mi_segment_t* const segment = _mi_page_segment(page);
+  mi_assert_internal(segment->kind == MI_SEGMENT_HUGE && segment->used == 1);
+  mi_assert_internal(page->reserved == 1 && page->used == 1);
+  if (segment->thread_id != _mi_thread_id()) return false;
+  size_t psize;
+  uint8_t* const start = _mi_segment_page_start(segment, page, &psize);
+  if (block_size > psize) return false;
+
+  const size_t old_bsize = mi_page_block_size(page);
+  size_t new_bsize = _mi_align_up(block_size, MI_SEGMENT_SLICE_SIZE);
+  if (new_bsize > psize) { new_bsize = psize; }
+  if (new_bsize < old_bsize && segment->allow_purge) {
+    // only reset whole huge OS pages if the segment is backed by transparent huge pages
+    uint8_t* const tail = (segment->thp > 0 ? (uint8_t*)_mi_align_up((uintptr_t)(start + new_bsize), MI_THP_COMMIT_SIZE) : start + new_bsize);
+    if (tail < start + old_bsize) { _mi_os_reset(tail, (size_t)(start + old_bsize - tail)); }
+  }
+  page->block_size = new_bsize;
+  page->block_size_shift = (_mi_is_power_of_two(new_bsize) ? (uint8_t)mi_ctz(new_bsize) : 0);
+  if (new_bsize > old_bsize) { _mi_stat_increase(&tld->stats->page_committed, new_bsize - old_bsize); }
+                        else { _mi_stat_decrease(&tld->stats->page_committed, old_bsize - new_bsize); }
+  return true;
+}
+
+// Grow the block of a huge page in a remappable segment (`MI_MEM_OS_REMAP`) to at least `block_size` bytes.
+// The segment can move to another address in which case the page is returned at its new address.
+// Returns NULL if the segment could not be remapped (and the page is unchanged).
+mi_page_t* _mi_segment_huge_page_remap(mi_page_t* page, size_t block_size, mi_segments_tld_t* tld) {
+  mi_segment_t* segment = _mi_page_segment(page);
+  mi_assert_internal(segment->kind == MI_SEGMENT_HUGE && segment->used == 1);
+  mi_assert_internal(page->reserved == 1 && page->used == 1);
+  if (segment->memid.memkind != MI_MEM_OS_REMAP || segment->thread_id != _mi_thread_id()) return NULL;
+  size_t info_slices;
+  const size_t segment_slices = mi_segment_calculate_slices(block_size, &info_slices);
+  mi_assert_internal(info_slices == segment->segment_info_slices);
+  if (block_size <= mi_page_block_size(page)) return page;     // it fits already
+  if (segment_slices <= segment->segment_slices) {             // it fits in the segment (after an earlier shrink)
+    return (_mi_segment_huge_page_resize(page, block_size, tld) ? page : NULL);
+  }
+
+  // remap the segment (which may move it)
+  const size_t old_size = mi_segment_size(segment);
+  const size_t new_size = segment_slices * MI_SEGMENT_SLICE_SIZE;
+  mi_memid_t memid = segment->memid;
+  _mi_segment_map_freed_at(segment);
+  mi_segment_t* const newsegment = (mi_segment_t*)_mi_os_remap(segment, old_size, new_size, MI_SEGMENT_ALIGN, &memid);
+  if (newsegment == NULL) {
+    _mi_segment_map_allocated_at(segment);
+    return NULL;
+  }
+  segment = newsegment;
+  mi_assert_internal(_mi_is_aligned(segment, MI_SEGMENT_ALIGN));
+  segment->memid = memid;
+  segment->cookie = _mi_ptr_cookie(segment);
+  segment->segment_size = new_size;
+  segment->segment_slices = segment_slices;
+  segment->slice_entries = (segment_slices > MI_SLICES_PER_SEGMENT ? MI_SLICES_PER_SEGMENT : segment_slices);
+  tld->current_size += (new_size - old_size);
+  if (tld->current_size > tld->peak_size) { tld->peak_size = tld->current_size; }
+  _mi_segment_map_allocated_at(segment);
+
+  // and extend the page to the end of the segment
+  mi_slice_t* const slice = &segment->slices[info_slices];
+  const size_t slice_count = segment_slices - info_slices;
+  slice->slice_count = (uint32_t)slice_count;
+  mi_segment_span_set_back_offsets(segment, slice, info_slices, slice_count);
+  page = mi_slice_to_page(slice);
+  size_t psize;
+  page->page_start = _mi_segment_page_start(segment, page, &psize);
+  mi_assert_internal(psize >= block_size && psize > page->block_size);
+  _mi_stat_increase(&tld->stats->page_committed, psize - page->block_size);
+  page->block_size = psize;
+  page->block_size_shift = (_mi_is_power_of_two(psize) ? (uint8_t)mi_ctz(psize) : 0);
+  mi_assert_expensive(mi_segment_is_valid(segment, tld));
+  return page;
+}
+
 /* -----------------------------------------------------------
    Page allocation and free
 ----------------------------------------------------------- */
@@ -1663,7 +2029,7 @@ mi_page_t* _mi_segment_page_alloc(mi_heap_t* heap, size_t block_size, size_t pag
     mi_assert_internal(_mi_is_power_of_two(page_alignment));
     mi_assert_internal(page_alignment >= MI_SEGMENT_SIZE);
     if (page_alignment < MI_SEGMENT_SIZE) { page_alignment = MI_SEGMENT_SIZE; }
-    page = mi_segment_huge_page_alloc(block_size,page_alignment,heap->arena_id,tld);
+    page = mi_segment_huge_page_alloc(block_size,page_alignment,heap->arena_id,_mi_heap_numa_node(heap),heap->thp,tld);
   }
   else if (block_size <= MI_SMALL_OBJ_SIZE_MAX) {
     page = mi_segments_page_alloc(heap,MI_PAGE_SMALL,block_size,block_size,tld);
@@ -1675,9 +2041,11 @@ mi_page_t* _mi_segment_page_alloc(mi_heap_t* heap, size_t block_size, size_t pag
     page = mi_segments_page_alloc(heap,MI_PAGE_LARGE,block_size,block_size,tld);
   }
   else {
-    page = mi_segment_huge_page_alloc(block_size,page_alignment,heap->arena_id,tld);
+    page = mi_segment_huge_page_alloc(block_size,page_alignment,heap->arena_id,_mi_heap_numa_node(heap),heap->thp,tld);
   }
   mi_assert_internal(page == NULL || _mi_heap_memid_is_suitable(heap, _mi_page_segment(page)->memid));
+  mi_assert_internal(page == NULL || mi_segment_is_numa_suitable(_mi_page_segment(page), _mi_heap_numa_node(heap)));
+  mi_assert_internal(page == NULL || mi_segment_is_thp_suitable(_mi_page_segment(page), heap->thp) || _mi_page_segment(page)->memid.is_pinned);
   mi_assert_expensive(page == NULL || mi_segment_is_valid(_mi_page_segment(page),tld));
   mi_assert_internal(page == NULL || _mi_page_segment(page)->subproc == tld->subproc);
   return page;
@@ -28,13 +28,17 @@ terms of the MIT license. A copy of the license can be found in the file
 #include "heap.c"
 #include "init.c"
 #include "libc.c"
+#include "objcache.c"
 #include "options.c"
 #include "os.c"
 #include "page.c"           // includes page-queue.c
+#include "profile.c"
+#include "purge.c"
 #include "random.c"
 #include "segment.c"
 #include "segment-map.c"
 #include "stats.c"
+#include "trace.c"
 #include "prim/prim.c"
 #if MI_OSX_ZONE
 #include "prim/osx/alloc-override-zone.c"
@@ -120,11 +120,126 @@ static void mi_stats_add(mi_stats_t* stats, const mi_stats_t* src) {
   for (size_t i = 0; i <= MI_BIN_HUGE; i++) {
     mi_stat_count_add_mt(&stats->page_bins[i], &src->page_bins[i]);
   }
+  for (size_t i = 0; i < mi_latency_last; i++) {
+    for (size_t b = 0; b < MI_STAT_LATENCY_BUCKETS; b++) {
+      mi_stat_counter_add_mt(&stats->latency_bins[i][b], &src->latency_bins[i][b]);
+    }
+  }
 }
 
 #undef MI_STAT_COUNT
 #undef MI_STAT_COUNTER
 
+
+/* -----------------------------------------------------------
+  Low-overhead statistics (with `MI_STAT_LITE`)
+  Each thread owns a block of counters that only it writes to
+  (see `types.h:mi_stat_lite_add`). All blocks are in a list and
+  are never freed so `mi_stats_get` can sum them from any thread
+  without locks. The block of a terminated thread is reused by a
+  new thread (and keeps its counts).
+----------------------------------------------------------- */
+#if MI_STAT_LITE
+
+#define MI_STATS_LITE_CHUNK   (32)  // allocate this many blocks at a time
+#define MI_STATS_LITE_SHARED  (16)  // stripes of the shared blocks
+
+static _Atomic(mi_stats_lite_t*) mi_stats_lite_list = MI_ATOMIC_VAR_INIT(&_mi_stats_lite_main);
+static mi_stats_lite_t mi_stats_lite_shared[MI_STATS_LITE_SHARED];  // for frees by uninitialized threads (updated atomically, like with per-cpu heaps)
+static mi_stats_lite_t mi_stats_lite_base;    // the totals at the last `mi_stats_reset`
+
+mi_stats_lite_t* _mi_stats_lite_claim(void) {
+  // reuse the block of a terminated thread
+  for (mi_stats_lite_t* s = mi_atomic_load_ptr_acquire(mi_stats_lite_t, &mi_stats_lite_list); s != NULL; s = s->next) {
+    uintptr_t expected = 0;
+    if (mi_atomic_load_relaxed(&s->in_use) == 0 && mi_atomic_cas_strong_acq_rel(&s->in_use, &expected, 1)) {
+      return s;
+    }
+  }
+  // or allocate a fresh chunk of blocks (never freed)
+  mi_memid_t memid;
+  mi_stats_lite_t* const chunk = (mi_stats_lite_t*)_mi_arena_meta_zalloc(MI_STATS_LITE_CHUNK * sizeof(mi_stats_lite_t), &memid);
+  if (chunk == NULL) {
+    // we can still count (but concurrent updates may be lost)
+    return &mi_stats_lite_shared[0];
+  }
+  for (size_t i = 0; i + 1 < MI_STATS_LITE_CHUNK; i++) {
+    chunk[i].next = &chunk[i+1];
+  }
+  mi_atomic_store_relaxed(&chunk[0].in_use, 1);
+  mi_stats_lite_t* const last = &chunk[MI_STATS_LITE_CHUNK-1];
+  mi_stats_lite_t* head = mi_atomic_load_ptr_relaxed(mi_stats_lite_t, &mi_stats_lite_list);
+  do {
+    last->next = head;
+  } while (!mi_atomic_cas_ptr_weak_release(mi_stats_lite_t, &mi_stats_lite_list, &head, chunk));
+  return chunk;
+}
+
+void _mi_stats_lite_release(mi_stats_lite_t* stats) {
+  if (stats == NULL || stats == &mi_stats_lite_shared[0] || stats == &_mi_stats_lite_main) return;
+  mi_atomic_store_release(&stats->in_use, 0);
+}
+
+// called from `free.c:mi_stat_free` if the thread is not initialized
+void _mi_stats_lite_free_shared(size_t bsize, bool is_huge) {
+  mi_stats_lite_t* const stats = &mi_stats_lite_shared[_mi_random_shuffle(_mi_thread_id()) % MI_STATS_LITE_SHARED];
+  if (is_huge) { mi_atomic_addi64_relaxed((int64_t*)&stats->free_huge, (int64_t)bsize); }
+          else { mi_atomic_addi64_relaxed((int64_t*)&stats->free_normal, (int64_t)bsize); }
+}
+
+#define MI_STAT_LITE_COUNTER(stat)  mi_stat_lite_add(sum->stat, mi_atomic_loadi64_relaxed(&s->stat));
+
+// sum the counters of all threads
+static void mi_stats_lite_sum(mi_stats_lite_t* sum) {
+  _mi_memzero(sum, sizeof(mi_stats_lite_t));
+  for (mi_stats_lite_t* s = mi_atomic_load_ptr_acquire(mi_stats_lite_t, &mi_stats_lite_list); s != NULL; s = s->next) {
+    MI_STAT_LITE_FIELDS()
+  }
+  for (size_t i = 0; i < MI_STATS_LITE_SHARED; i++) {
+    mi_stats_lite_t* s = &mi_stats_lite_shared[i];
+    MI_STAT_LITE_FIELDS()
+  }
+}
+
+#undef MI_STAT_LITE_COUNTER
+
+static void mi_stat_lite_set(mi_stat_count_t* stat, int64_t allocated, int64_t freed, int64_t base) {
+  stat->total = allocated - base;
+  stat->current = allocated - freed;
+  if (stat->peak < stat->current) { stat->peak = stat->current; }  // the peak is only approximate
+}
+
+// set the statistics that are maintained by the low-overhead counters
+static void mi_stats_lite_collect(mi_stats_t* stats) {
+  mi_stats_lite_t sum;
+  mi_stats_lite_sum(&sum);
+  #define mi_stat_lite_get(s,stat)  mi_atomic_loadi64_relaxed(&(s)->stat)
+  mi_stat_lite_set(&stats->malloc_normal, mi_stat_lite_get(&sum,malloc_normal), mi_stat_lite_get(&sum,free_normal), mi_stat_lite_get(&mi_stats_lite_base,malloc_normal));
+  mi_stat_lite_set(&stats->malloc_huge, mi_stat_lite_get(&sum,malloc_huge), mi_stat_lite_get(&sum,free_huge), mi_stat_lite_get(&mi_stats_lite_base,malloc_huge));
+  mi_stat_lite_set(&stats->pages, mi_stat_lite_get(&sum,pages), mi_stat_lite_get(&sum,pages_freed), mi_stat_lite_get(&mi_stats_lite_base,pages));
+  mi_stat_lite_set(&stats->segments, mi_stat_lite_get(&sum,segments), mi_stat_lite_get(&sum,segments_freed), mi_stat_lite_get(&mi_stats_lite_base,segments));
+  stats->malloc_normal_count.total = mi_stat_lite_get(&sum,malloc_normal_count) - mi_stat_lite_get(&mi_stats_lite_base,malloc_normal_count);
+  stats->malloc_huge_count.total = mi_stat_lite_get(&sum,malloc_huge_count) - mi_stat_lite_get(&mi_stats_lite_base,malloc_huge_count);
+  #undef mi_stat_lite_get
+}
+
+static void mi_stats_lite_reset(void) {
+  mi_stats_lite_sum(&mi_stats_lite_base);
+}
+
+#else
+
+mi_stats_lite_t* _mi_stats_lite_claim(void) {
+  return NULL;
+}
+
+void _mi_stats_lite_release(mi_stats_lite_t* stats) {
+  MI_UNUSED(stats);
+}
+
+#endif
+
+
 /* -----------------------------------------------------------
   Display statistics
 ----------------------------------------------------------- */
@@ -268,6 +383,93 @@ static void mi_stats_print_bins(const mi_stat_count_t* bins, size_t max, const c
 #endif
 
 
+// Print the lifetime histograms of the size bins that have any (only with `MI_HEAP_PROFILE`, see `profile.c`)
+static void mi_stats_print_lifetimes(const mi_stats_t* stats, mi_output_fun* out, void* arg) {
+  static const char* const labels[MI_STAT_LIFETIME_BUCKETS] = {
+    "<1ms", "<4ms", "<16ms", "<64ms", "<256ms", "<1s", "<4s", "<16s",
+    "<66s", "<4.4m", "<17m", "<70m", "<4.7h", "<19h", "<3.1d", ">3.1d"
+  };
+  bool found = false;
+  for (size_t i = 0; i <= MI_BIN_HUGE; i++) {
+    int64_t sum = 0;
+    for (size_t b = 0; b < MI_STAT_LIFETIME_BUCKETS; b++) { sum += stats->lifetime_bins[i][b].total; }
+    if (sum == 0) continue;
+    if (!found) {
+      found = true;
+      _mi_fprintf(out, arg, "%10s:", "lifetime");
+      for (size_t b = 0; b < MI_STAT_LIFETIME_BUCKETS; b++) { _mi_fprintf(out, arg, "%9s", labels[b]); }
+      _mi_fprintf(out, arg, "\n");
+    }
+    _mi_fprintf(out, arg, "%6s %3lu:", "bin", (long)i);
+    for (size_t b = 0; b < MI_STAT_LIFETIME_BUCKETS; b++) {
+      mi_printf_amount(stats->lifetime_bins[i][b].total, 0, out, arg, "%9s");
+    }
+    _mi_fprintf(out, arg, "\n");
+  }
+  if (found) { _mi_fprintf(out, arg, "\n"); }
+}
+
+// Short names of the latency events (as printed), and long names (as used in json)
+static const char* const mi_latency_names[mi_latency_last] = {
+  "malloc", "seg alloc", "seg reclm", "commit", "decommit", "purge", "arena prg", "mmap", "munmap"
+};
+static const char* const mi_latency_json_names[mi_latency_last] = {
+  "malloc_generic", "segment_alloc", "segment_reclaim", "os_commit", "os_decommit", "os_purge", "arena_purge", "os_alloc", "os_free"
+};
+
+// Print the upper bound of a latency bucket (or the lower bound of the last one)
+static void mi_latency_print_bound(size_t bucket, mi_output_fun* out, void* arg) {
+  const bool is_last = (bucket >= MI_STAT_LATENCY_BUCKETS-1);
+  const int64_t ns = ((int64_t)1 << (is_last ? MI_STAT_LATENCY_BUCKETS-2 : bucket));
+  char buf[32];
+  if (ns < 1000) {
+    _mi_snprintf(buf, 32, "%s%lld ns", (is_last ? ">" : "<"), (long long)ns);
+  }
+  else {
+    int64_t divider = 1000;
+    const char* unit = "us";
+    if (ns >= 1000*divider) { divider *= 1000; unit = "ms"; }
+    if (ns >= 1000*divider) { divider *= 1000; unit = "s"; }
+    const int64_t tens = ns / (divider/10);
+    _mi_snprintf(buf, 32, "%s%lld.%lld %s", (is_last ? ">" : "<"), (long long)(tens/10), (long long)(tens%10), unit);
+  }
+  _mi_fprintf(out, arg, "%12s", buf);
+}
+
+// Print the count and approximate percentiles of the slow paths that have a latency histogram
+static void mi_stats_print_latencies(const mi_stats_t* stats, mi_output_fun* out, void* arg) {
+  bool found = false;
+  for (size_t i = 0; i < mi_latency_last; i++) {
+    const mi_stat_counter_t* const bins = stats->latency_bins[i];
+    int64_t count = 0;
+    size_t max = 0;
+    for (size_t b = 0; b < MI_STAT_LATENCY_BUCKETS; b++) {
+      if (bins[b].total > 0) { count += bins[b].total; max = b; }
+    }
+    if (count == 0) continue;
+    if (!found) {
+      found = true;
+      _mi_fprintf(out, arg, "%10s: %11s %11s %11s %11s %11s\n", "latency", "count   ", "p50   ", "p99   ", "p99.9   ", "max   ");
+    }
+    _mi_fprintf(out, arg, "%10s:", mi_latency_names[i]);
+    mi_print_amount(count, 0, out, arg);
+    // percentiles (in per-mille) as the bound of the bucket in which they fall
+    static const int64_t permille[3] = { 500, 990, 999 };
+    size_t p = 0;
+    int64_t sum = 0;
+    for (size_t b = 0; b < MI_STAT_LATENCY_BUCKETS && p < 3; b++) {
+      sum += bins[b].total;
+      while (p < 3 && sum*1000 >= count*permille[p]) {
+        mi_latency_print_bound(b, out, arg);
+        p++;
+      }
+    }
+    mi_latency_print_bound(max, out, arg);
+    _mi_fprintf(out, arg, "\n");
+  }
+  if (found) { _mi_fprintf(out, arg, "\n"); }
+}
+
 
 //------------------------------------------------------------
 // Use an output wrapper for line-buffered output
@@ -316,7 +518,7 @@ static void _mi_stats_print(mi_stats_t* stats, mi_output_fun* out0, void* arg0)
   #if MI_STAT>1
   mi_stats_print_bins(stats->malloc_bins, MI_BIN_HUGE, "bin",out,arg);
   #endif
-  #if MI_STAT
+  #if MI_STAT || MI_STAT_LITE
   mi_stat_print(&stats->malloc_normal, "binned", (stats->malloc_normal_count.total == 0 ? -1 : 1), out, arg);
   mi_stat_print(&stats->malloc_huge, "huge", (stats->malloc_huge_count.total == 0 ? -1 : 1), out, arg);
   mi_stat_count_t total = { 0,0,0 };
@@ -329,6 +531,7 @@ static void _mi_stats_print(mi_stats_t* stats, mi_output_fun* out0, void* arg0)
   mi_stat_total_print(&stats->malloc_requested, "malloc req", 1, out, arg);
   _mi_fprintf(out, arg, "\n");
   #endif
+  mi_stats_print_lifetimes(stats, out, arg);
   mi_stat_print_ex(&stats->reserved, "reserved", 1, out, arg, "");
   mi_stat_print_ex(&stats->committed, "committed", 1, out, arg, "");
   mi_stat_counter_print_size(&stats->reset, "reset", out, arg );
@@ -352,6 +555,7 @@ static void _mi_stats_print(mi_stats_t* stats, mi_output_fun* out0, void* arg0)
   mi_stat_print(&stats->threads, "threads", 0, out, arg);
   mi_stat_average_print(stats->page_searches_count.total, stats->page_searches.total, "searches", out, arg);
   _mi_fprintf(out, arg, "%10s: %5i\n", "numa nodes", _mi_os_numa_node_count());
+  mi_stats_print_latencies(stats, out, arg);
 
   size_t elapsed;
   size_t user_time;
@@ -391,6 +595,9 @@ void mi_stats_reset(void) mi_attr_noexcept {
   mi_stats_t* stats = mi_stats_get_default();
   if (stats != &_mi_stats_main) { memset(stats, 0, sizeof(mi_stats_t)); }
   memset(&_mi_stats_main, 0, sizeof(mi_stats_t));
+  #if MI_STAT_LITE
+  mi_stats_lite_reset();
+  #endif
   if (mi_process_start == 0) { mi_process_start = _mi_clock_start(); };
 }
 
@@ -408,7 +615,13 @@ void _mi_stats_done(mi_stats_t* stats) {  // called from `mi_thread_done`
 
 void mi_stats_print_out(mi_output_fun* out, void* arg) mi_attr_noexcept {
   mi_stats_merge_from(mi_stats_get_default());
+  #if MI_STAT_LITE
+  mi_stats_t_decl(stats);
+  mi_stats_get(&stats);
+  _mi_stats_print(&stats, out, arg);
+  #else
   _mi_stats_print(&_mi_stats_main, out, arg);
+  #endif
 }
 
 void mi_stats_print(void* out) mi_attr_noexcept {
@@ -444,6 +657,25 @@ mi_msecs_t _mi_clock_end(mi_msecs_t start) {
   return (end - start - mi_clock_diff);
 }
 
+mi_nsecs_t _mi_clock_nsecs(void) {
+  return _mi_prim_clock_nsecs();
+}
+
+
+// ----------------------------------------------------------------
+// Latency histograms of slow paths (with `mi_option_latency_stats`)
+// Each slow path is timed with a monotonic nano-second clock and
+// counted in a log2 bucket (see `internal.h:mi_stat_latency_start`).
+// ----------------------------------------------------------------
+
+void _mi_stat_latency_record(mi_stats_t* stats, mi_stat_latency_t event, mi_nsecs_t start) {
+  mi_assert_internal(event < mi_latency_last);
+  const mi_nsecs_t elapsed = _mi_clock_nsecs() - start;
+  size_t bucket = (elapsed <= 0 ? 0 : 1 + mi_bsr((size_t)elapsed));
+  if (bucket >= MI_STAT_LATENCY_BUCKETS) { bucket = MI_STAT_LATENCY_BUCKETS - 1; }
+  _mi_stat_counter_increase(&stats->latency_bins[event][bucket], 1);
+}
+
 
 // --------------------------------------------------------
 // Basic process statistics
@@ -483,6 +715,59 @@ bool mi_stats_get(mi_stats_t* stats) mi_attr_noexcept {
   if (stats == NULL || stats->size != sizeof(mi_stats_t) || stats->version != MI_STAT_VERSION) return false;
   _mi_memzero(stats,stats->size);
   _mi_memcpy(stats, &_mi_stats_main, sizeof(mi_stats_t));
+  stats->size = sizeof(mi_stats_t);      // as `mi_stats_reset` clears these in `_mi_stats_main`
+  stats->version = MI_STAT_VERSION;
+  #if MI_STAT_LITE
+  mi_stats_lite_collect(stats);
+  #endif
+  return true;
+}
+
+
+// --------------------------------------------------------
+// Heap statistics
+// The page count and size of a heap are maintained on page transitions
+// (see `page-queue.c`) and the live blocks are counted by visiting the
+// pages of the heap; this way they are also available without `MI_STAT`.
+// --------------------------------------------------------
+
+// Fill in the statistics of a heap (and add the size of the pages per bin to `committed_bins` if not NULL)
+static void mi_heap_stats_collect(mi_heap_t* heap, mi_stats_t* stats, size_t* committed_bins) {
+  stats->pages = heap->stat_pages;
+  stats->page_committed = heap->stat_pages_size;
+  for (size_t i = 0; i <= MI_BIN_FULL; i++) {
+    for (const mi_page_t* page = heap->pages[i].first; page != NULL; page = page->next) {
+      const size_t bin = _mi_page_stats_bin(page);
+      const size_t bsize = mi_page_block_size(page);
+      const int64_t live = (int64_t)page->used * (int64_t)mi_page_usable_block_size(page);
+      stats->page_bins[bin].current++;
+      stats->malloc_bins[bin].current += live;
+      if (bsize <= MI_LARGE_OBJ_SIZE_MAX) {
+        stats->malloc_normal.current += live;
+        stats->malloc_normal_count.total += page->used;
+      }
+      else {
+        stats->malloc_huge.current += live;
+        stats->malloc_huge_count.total += page->used;
+      }
+      if (committed_bins != NULL) { committed_bins[bin] += page->reserved * bsize; }
+    }
+  }
+}
+
+// Statistics of a heap (or the default heap if `heap==NULL`). Only the `pages` and `page_committed` statistics
+// have a total and peak; the live bytes (`malloc_normal`, `malloc_huge`, and `malloc_bins`) and pages per bin (`page_bins`)
+// only have a current value, and the `malloc_normal_count` and `malloc_huge_count` are the current live block counts.
+// Should be called by the thread that owns the heap.
+bool mi_heap_stats_get(mi_heap_t* heap, mi_stats_t* stats) mi_attr_noexcept {
+  if (stats == NULL || stats->size != sizeof(mi_stats_t) || stats->version != MI_STAT_VERSION) return false;
+  _mi_memzero(stats, sizeof(mi_stats_t));
+  stats->size = sizeof(mi_stats_t);
+  stats->version = MI_STAT_VERSION;
+  if (heap == NULL) { heap = mi_prim_get_default_heap(); }
+  if (heap != NULL && mi_heap_is_initialized(heap)) {
+    mi_heap_stats_collect(heap, stats, NULL);
+  }
   return true;
 }
 
@@ -543,6 +828,17 @@ static void mi_heap_buf_print_count_bin(mi_heap_buf_t* hbuf, const char* prefix,
   mi_heap_buf_print(hbuf, buf);
 }
 
+static void mi_heap_buf_print_counters(mi_heap_buf_t* hbuf, const char* prefix, const mi_stat_counter_t* counters, size_t count, bool add_comma) {
+  char buf[32*MI_STAT_LATENCY_BUCKETS];
+  size_t len = (size_t)_mi_snprintf(buf, sizeof(buf), "%s[", prefix);
+  for (size_t b = 0; b < count && len < sizeof(buf); b++) {
+    len += (size_t)_mi_snprintf(buf + len, sizeof(buf) - len, "%s%lld", (b==0 ? " " : ", "), (long long)counters[b].total);
+  }
+  if (len < sizeof(buf)) { _mi_snprintf(buf + len, sizeof(buf) - len, " ]%s\n", (add_comma ? "," : "")); }
+  buf[sizeof(buf)-1] = 0;
+  mi_heap_buf_print(hbuf, buf);
+}
+
 static void mi_heap_buf_print_count(mi_heap_buf_t* hbuf, const char* prefix, mi_stat_count_t* stat, bool add_comma) {
   char buf[128];
   _mi_snprintf(buf, 128, "%s{ \"total\": %lld, \"peak\": %lld, \"current\": %lld }%s\n", prefix, stat->total, stat->peak, stat->current, (add_comma ? "," : ""));
@@ -576,6 +872,32 @@ static void mi_heap_buf_print_counter_value(mi_heap_buf_t* hbuf, const char* nam
   mi_heap_buf_print_value(hbuf, name, stat->total);
 }
 
+static void mi_heap_buf_print_heap(mi_heap_buf_t* hbuf, mi_heap_t* heap, bool add_comma) {
+  mi_stats_t_decl(stats);
+  size_t committed_bins[MI_BIN_HUGE+1];
+  _mi_memzero(committed_bins, sizeof(committed_bins));
+  mi_heap_stats_collect(heap, &stats, committed_bins);
+  char buf[160];
+  _mi_snprintf(buf, 160, "    { \"tag\": %d, \"arena_id\": %d, \"live_bytes\": %lld, \"live_blocks\": %lld,\n",
+               (int)heap->tag, (int)heap->arena_id, stats.malloc_normal.current + stats.malloc_huge.current,
+               stats.malloc_normal_count.total + stats.malloc_huge_count.total);
+  buf[159] = 0;
+  mi_heap_buf_print(hbuf, buf);
+  mi_heap_buf_print_count(hbuf, "      \"pages\": ", &stats.pages, true);
+  mi_heap_buf_print_count(hbuf, "      \"page_committed\": ", &stats.page_committed, true);
+  mi_heap_buf_print(hbuf, "      \"bins\": [");
+  bool first = true;
+  for (size_t i = 0; i <= MI_BIN_HUGE; i++) {
+    if (stats.page_bins[i].current == 0) continue;
+    _mi_snprintf(buf, 160, "%s\n        { \"block_size\": %zu, \"pages\": %lld, \"committed\": %zu, \"live_bytes\": %lld }",
+                 (first ? "" : ","), _mi_bin_size(i), stats.page_bins[i].current, committed_bins[i], stats.malloc_bins[i].current);
+    buf[159] = 0;
+    mi_heap_buf_print(hbuf, buf);
+    first = false;
+  }
+  mi_heap_buf_print(hbuf, (add_comma ? " ]\n    },\n" : " ]\n    }\n"));
+}
+
 #define MI_STAT_COUNT(stat)    mi_heap_buf_print_count_value(&hbuf, #stat, &stats->stat);
 #define MI_STAT_COUNTER(stat)  mi_heap_buf_print_counter_value(&hbuf, #stat, &stats->stat);
 
@@ -616,7 +938,13 @@ char* mi_stats_get_json(size_t output_size, char* output_buf) mi_attr_noexcept {
   mi_heap_buf_print(&hbuf, "  },\n");
 
   // statistics
+  #if MI_STAT_LITE
+  mi_stats_t_decl(stats_lite);
+  mi_stats_get(&stats_lite);
+  mi_stats_t* stats = &stats_lite;
+  #else
   mi_stats_t* stats = &_mi_stats_main;
+  #endif
   MI_STAT_FIELDS()
 
   // size bins
@@ -629,6 +957,31 @@ char* mi_stats_get_json(size_t output_size, char* output_buf) mi_attr_noexcept {
   for (size_t i = 0; i <= MI_BIN_HUGE; i++) {
     mi_heap_buf_print_count_bin(&hbuf, "    ", &stats->page_bins[i], i, i!=MI_BIN_HUGE);
   }
+  mi_heap_buf_print(&hbuf, "  ],\n");
+  #if MI_HEAP_PROFILE
+  // (otherwise always zero)
+  mi_heap_buf_print(&hbuf, "  \"lifetime_bins\": [\n");
+  for (size_t i = 0; i <= MI_BIN_HUGE; i++) {
+    mi_heap_buf_print_counters(&hbuf, "    ", stats->lifetime_bins[i], MI_STAT_LIFETIME_BUCKETS, i!=MI_BIN_HUGE);
+  }
+  mi_heap_buf_print(&hbuf, "  ],\n");
+  #endif
+  mi_heap_buf_print(&hbuf, "  \"latency_bins\": {\n");
+  for (size_t i = 0; i < mi_latency_last; i++) {
+    char prefix[64];
+    _mi_snprintf(prefix, 64, "    \"%s\": ", mi_latency_json_names[i]);
+    mi_heap_buf_print_counters(&hbuf, prefix, stats->latency_bins[i], MI_STAT_LATENCY_BUCKETS, i+1 != mi_latency_last);
+  }
+  mi_heap_buf_print(&hbuf, "  },\n");
+
+  // the heaps of the current thread
+  mi_heap_buf_print(&hbuf, "  \"heaps\": [\n");
+  mi_heap_t* const dheap = mi_prim_get_default_heap();
+  if (dheap != NULL && mi_heap_is_initialized(dheap)) {
+    for (mi_heap_t* heap = dheap->tld->heaps; heap != NULL; heap = heap->next) {
+      mi_heap_buf_print_heap(&hbuf, heap, heap->next != NULL);
+    }
+  }
   mi_heap_buf_print(&hbuf, "  ]\n");
   mi_heap_buf_print(&hbuf, "}\n");
   if (hbuf.used >= hbuf.size) {
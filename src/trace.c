@@ -0,0 +1,176 @@
+/* ----------------------------------------------------------------------------
+Copyright (c) 2018-2024, Microsoft Research, Daan Leijen
+This is free software; you can redistribute it and/or modify it under the
+terms of the MIT license. A copy of the license can be found in the file
+"LICENSE" at the root of this distribution.
+-----------------------------------------------------------------------------*/
+
+/* -----------------------------------------------------------
+  Flight recorder (with `mi_option_trace_events`)
+
+  Each thread records compact binary events of the allocator
+  (like OS commits, segment allocation, purging, and slow path
+  allocations) in a ring buffer that keeps its most recent
+  events. A buffer is claimed on the first event of a thread and
+  released when the thread terminates; it keeps its events until
+  it is claimed again by a new thread. Buffers are never freed.
+
+  An event claims its slot with an atomic increment so a buffer
+  can be shared (by threads on a per-cpu heap, or by threads that
+  are not initialized). `mi_trace_dump` writes all buffers to a
+  file descriptor without allocating so it can also be used on an
+  out-of-memory error (see `mi_option_trace_dump_on_error`).
+  It does not stop other threads so the most recent events of
+  running threads may be torn. Use `tools/mitrace.c` to decode
+  a dump.
+----------------------------------------------------------- */
+
+#include "mimalloc.h"
+#include "mimalloc/internal.h"
+#include "mimalloc/atomic.h"
+#include "mimalloc/prim.h"
+
+#include <string.h>  // memcpy
+
+#define MI_TRACE_EVENTS_MIN   (64)
+#define MI_TRACE_EVENTS_MAX   (1024*1024)
+
+typedef struct mi_trace_buffer_s {
+  struct mi_trace_buffer_s* next;       // list of all buffers
+  _Atomic(uintptr_t)  in_use;
+  mi_threadid_t       thread_id;        // the thread that claimed this buffer last
+  size_t              capacity;         // number of events (a power of 2)
+  _Atomic(size_t)     count;            // total events recorded (the next slot is at `count % capacity`)
+  mi_memid_t          memid;
+  mi_trace_event_t    events[1];
+} mi_trace_buffer_t;
+
+static _Atomic(mi_trace_buffer_t*) mi_trace_buffers;     // all buffers (never freed)
+static _Atomic(mi_trace_buffer_t*) mi_trace_shared;      // buffer for threads that are not initialized
+static _Atomic(uintptr_t)          mi_trace_error_dumped; // only dump once on an error
+
+
+/* -----------------------------------------------------------
+  Recording
+----------------------------------------------------------- */
+
+static mi_trace_buffer_t* mi_trace_buffer_claim(mi_threadid_t thread_id) {
+  // reuse the buffer of a terminated thread
+  for (mi_trace_buffer_t* buf = mi_atomic_load_ptr_acquire(mi_trace_buffer_t, &mi_trace_buffers); buf != NULL; buf = buf->next) {
+    uintptr_t expected = 0;
+    if (mi_atomic_load_relaxed(&buf->in_use) == 0 && mi_atomic_cas_strong_acq_rel(&buf->in_use, &expected, 1)) {
+      buf->thread_id = thread_id;
+      mi_atomic_store_release(&buf->count, (size_t)0);
+      return buf;
+    }
+  }
+  // or allocate a fresh one
+  // note: `_mi_os_zalloc` does not commit through `_mi_os_commit` so it cannot record an event itself
+  size_t capacity = MI_TRACE_EVENTS_MIN;
+  const size_t requested = (size_t)mi_option_get_clamp(mi_option_trace_events, MI_TRACE_EVENTS_MIN, MI_TRACE_EVENTS_MAX);
+  while (capacity < requested) { capacity *= 2; }
+  const size_t size = _mi_align_up(sizeof(mi_trace_buffer_t) + (capacity - 1)*sizeof(mi_trace_event_t), _mi_os_page_size());
+  mi_memid_t memid;
+  mi_trace_buffer_t* const buf = (mi_trace_buffer_t*)_mi_os_zalloc(size, &memid);
+  if (buf == NULL) return NULL;
+  buf->memid = memid;
+  buf->capacity = capacity;
+  buf->thread_id = thread_id;
+  mi_atomic_store_relaxed(&buf->in_use, 1);
+  mi_trace_buffer_t* head = mi_atomic_load_ptr_relaxed(mi_trace_buffer_t, &mi_trace_buffers);
+  do {
+    buf->next = head;
+  } while (!mi_atomic_cas_ptr_weak_release(mi_trace_buffer_t, &mi_trace_buffers, &head, buf));
+  return buf;
+}
+
+static mi_trace_buffer_t* mi_trace_buffer_shared(void) {
+  mi_trace_buffer_t* buf = mi_atomic_load_ptr_acquire(mi_trace_buffer_t, &mi_trace_shared);
+  if (buf == NULL) {
+    mi_trace_buffer_t* const fresh = mi_trace_buffer_claim(0);
+    if (fresh == NULL) return NULL;
+    if (mi_atomic_cas_ptr_strong_acq_rel(mi_trace_buffer_t, &mi_trace_shared, &buf, fresh)) {
+      buf = fresh;
+    }
+    else {
+      mi_atomic_store_release(&fresh->in_use, 0);  // lost the race; `buf` is set to the winner
+    }
+  }
+  return buf;
+}
+
+void _mi_trace_record(mi_trace_kind_t kind, const void* p, size_t size, size_t arg) {
+  mi_heap_t* const heap = mi_prim_get_default_heap();
+  mi_tld_t* const tld = (heap == NULL ? NULL : heap->tld);
+  mi_trace_buffer_t* buf;
+  if (tld != NULL) {
+    buf = tld->trace;
+    if mi_unlikely(buf == NULL) {
+      buf = tld->trace = mi_trace_buffer_claim(_mi_thread_id());
+      if (buf == NULL) return;
+    }
+  }
+  else {
+    buf = mi_trace_buffer_shared();
+    if (buf == NULL) return;
+  }
+  const size_t idx = mi_atomic_increment_relaxed(&buf->count) & (buf->capacity - 1);
+  mi_trace_event_t* const ev = &buf->events[idx];
+  ev->time = _mi_clock_nsecs();
+  ev->addr = (uint64_t)(uintptr_t)p;
+  ev->size = (uint64_t)size;
+  ev->kind = (uint32_t)kind;
+  ev->arg  = (uint32_t)arg;
+}
+
+void _mi_trace_release(mi_tld_t* tld) {
+  mi_trace_buffer_t* const buf = tld->trace;
+  if (buf == NULL) return;
+  tld->trace = NULL;
+  mi_atomic_store_release(&buf->in_use, 0);
+}
+
+
+/* -----------------------------------------------------------
+  Dump
+----------------------------------------------------------- */
+
+static bool mi_trace_dump_buffer(int fd, mi_trace_buffer_t* buf) {
+  const size_t count = mi_atomic_load_acquire(&buf->count);
+  if (count == 0) return true;
+  const size_t n = (count < buf->capacity ? count : buf->capacity);
+  const size_t start = (count - n) & (buf->capacity - 1);
+  const size_t first = (start + n <= buf->capacity ? n : buf->capacity - start);  // events up to the end of the ring
+  mi_trace_thread_t thread;
+  thread.thread_id = (uint64_t)buf->thread_id;
+  thread.count = (uint64_t)n;
+  return (_mi_prim_write(fd, &thread, sizeof(thread)) &&
+          _mi_prim_write(fd, &buf->events[start], first * sizeof(mi_trace_event_t)) &&
+          (first == n || _mi_prim_write(fd, &buf->events[0], (n - first) * sizeof(mi_trace_event_t))));
+}
+
+bool mi_trace_dump(int fd) mi_attr_noexcept {
+  if (fd < 0) return false;
+  mi_trace_header_t header;
+  _mi_memzero(&header, sizeof(header));
+  memcpy(header.magic, "mi-trace", 8);
+  header.version = MI_TRACE_VERSION;
+  header.event_size = sizeof(mi_trace_event_t);
+  header.time = _mi_clock_nsecs();
+  if (!_mi_prim_write(fd, &header, sizeof(header))) return false;
+  for (mi_trace_buffer_t* buf = mi_atomic_load_ptr_acquire(mi_trace_buffer_t, &mi_trace_buffers); buf != NULL; buf = buf->next) {
+    if (!mi_trace_dump_buffer(fd, buf)) return false;
+  }
+  return true;
+}
+
+// called from `options.c:_mi_error_message`
+void _mi_trace_error(int err) {
+  mi_trace_record(mi_trace_error, NULL, 0, (size_t)err);
+  const long fd = mi_option_get(mi_option_trace_dump_on_error);
+  if (fd <= 0) return;
+  if (mi_atomic_exchange_acq_rel(&mi_trace_error_dumped, (uintptr_t)1) != 0) return;
+  if (!mi_trace_dump((int)fd)) {
+    _mi_warning_message("unable to dump the flight recorder to file descriptor %ld\n", fd);
+  }
+}
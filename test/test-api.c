@@ -27,12 +27,19 @@ we therefore test the API over various inputs. Please add more tests :-)
 #include <stdbool.h>
 #include <stdint.h>
 #include <errno.h>
+#include <string.h>
 
 #ifdef __cplusplus
 #include <vector>
 #endif
 
+#if !defined(_WIN32) && !defined(__wasi__) && !defined(__EMSCRIPTEN__)
+#include <pthread.h>
+#define TEST_THREADS  1
+#endif
+
 #include "mimalloc.h"
+#include "mimalloc-stats.h"
 // #include "mimalloc/internal.h"
 #include "mimalloc/types.h" // for MI_DEBUG and MI_BLOCK_ALIGNMENT_MAX
 
@@ -51,6 +58,16 @@ bool test_stl_heap_allocator2(void);
 bool test_stl_heap_allocator3(void);
 bool test_stl_heap_allocator4(void);
 
+bool test_count_used(const mi_heap_t* heap, const mi_heap_area_t* area, void* block, size_t block_size, void* arg);
+bool test_objcache(void);
+bool test_commit_limit(void);
+bool test_heap_profile(void);
+bool test_cpu_heaps(void);
+bool test_remote_free_buffered(void);
+bool test_heap_defrag_remote(void);
+bool test_free_batch_double(void);
+bool test_realloc_reclaimed(void);
+
 bool mem_is_zero(uint8_t* p, size_t size) {
   if (p==NULL) return false;
   for (size_t i = 0; i < size; ++i) {
@@ -59,6 +76,10 @@ bool mem_is_zero(uint8_t* p, size_t size) {
   return true;
 }
 
+static void test_last_error(int err, void* arg) {
+  *((int*)arg) = err;
+}
+
 // ---------------------------------------------------------------------------
 // Main testing
 // ---------------------------------------------------------------------------
@@ -234,6 +255,21 @@ int main(void) {
     }
     result = ok;
   }
+  CHECK_BODY("malloc-aligned-natural") {  // aligned blocks come from a size class that is a multiple of the alignment
+    bool ok = true;
+    const size_t sizes[6]  = { 40, 200, 6000, 20000, 300*1024, 3*MI_MiB + 1 };
+    const size_t aligns[6] = { 64, 128, 4096, 4096, 4096, 64*1024 };
+    for (int i = 0; i < 6 && ok; i++) {
+      void* p = mi_malloc_aligned(sizes[i], aligns[i]);
+      ok = (p != NULL && ((uintptr_t)p % aligns[i]) == 0 && mi_usable_size(p) >= sizes[i]);
+      #if !MI_PADDING
+      const size_t asize = (sizes[i] + aligns[i] - 1) & ~(aligns[i] - 1);
+      if (asize <= MI_MEDIUM_OBJ_SIZE_MAX) { ok = ok && mi_usable_size(p) == mi_good_size(asize); }  // not over-allocated
+      #endif
+      mi_free(p);
+    }
+    result = ok;
+  };
   CHECK_BODY("malloc_aligned11") {
     mi_heap_t* heap = mi_heap_new();
     void* p = mi_heap_malloc_aligned(heap, 33554426, 8);
@@ -326,6 +362,49 @@ int main(void) {
     mi_free(p);
   };
 
+  CHECK_BODY("realloc-large-inplace") {
+    uint8_t* p = (uint8_t*)mi_malloc(3*MI_MiB);
+    if (p != NULL) { memset(p, 42, 3*MI_MiB); }
+    uint8_t* q = (uint8_t*)mi_realloc(p, 200*1024);          // shrinks in place and frees the tail slices
+    const size_t usable = mi_usable_size(q);
+    result = (q != NULL && q == p && usable < MI_MiB && q[200*1024 - 1] == 42);
+    q = (uint8_t*)mi_rezalloc(q, 2*MI_MiB);                  // and grows back into them
+    result = result && q == p && mi_usable_size(q) >= 2*MI_MiB && q[200*1024 - 1] == 42 && mem_is_zero(q + usable, 2*MI_MiB - usable);
+    mi_free(q);
+  };
+
+  #if TEST_THREADS
+  CHECK("realloc-large-reclaimed", test_realloc_reclaimed());
+  #endif
+
+  CHECK_BODY("realloc-huge-shrink") {
+    uint8_t* p = (uint8_t*)mi_malloc(48*MI_MiB);
+    if (p != NULL) { memset(p, 42, 48*MI_MiB); }
+    uint8_t* q = (uint8_t*)mi_realloc(p, 20*MI_MiB);         // shrinks in place and resets the tail
+    const size_t usable = mi_usable_size(q);
+    result = (q != NULL && q == p && usable < 21*MI_MiB && q[20*MI_MiB - 1] == 42);
+    q = (uint8_t*)mi_rezalloc(q, 40*MI_MiB);                 // and grows back within its segment
+    result = result && q == p && mi_usable_size(q) >= 40*MI_MiB && q[20*MI_MiB - 1] == 42 && mem_is_zero(q + usable, 40*MI_MiB - usable);
+    mi_free(q);
+  };
+
+  CHECK_BODY("realloc-huge-remap") {
+    mi_option_set(mi_option_remap_threshold, 64*1024);  // 64 MiB (in KiB)
+    const size_t size = 64*MI_MiB;
+    uint8_t* p = (uint8_t*)mi_malloc(size);
+    if (p != NULL) { p[0] = 1; p[size-1] = 2; }
+    uint8_t* q = (uint8_t*)mi_realloc(p, 2*size);       // grows into the reserved address space
+    result = (p != NULL && q != NULL && q[0] == 1 && q[size-1] == 2);
+    #if defined(__linux__) && !defined(__ANDROID__) && (MI_INTPTR_SIZE >= 8) && !MI_SECURE
+    result = result && q == p;
+    #endif
+    if (result) { q[2*size-1] = 3; }
+    q = (uint8_t*)mi_rezalloc(q, 8*size);               // moves to a new reservation
+    result = result && q != NULL && q[0] == 1 && q[size-1] == 2 && q[2*size-1] == 3 && q[2*size] == 0 && q[8*size-1] == 0;
+    mi_free(q);
+    mi_option_set(mi_option_remap_threshold, 0);
+  };
+
   // ---------------------------------------------------
   // Returned block sizes
   // ---------------------------------------------------
@@ -345,11 +424,329 @@ int main(void) {
     }
   }
 
+  // ---------------------------------------------------
+  // Size classes
+  // ---------------------------------------------------
+  CHECK_BODY("malloc-sizeclass") {
+    for (size_t size = 0; size <= 2*MI_SMALL_SIZE_MAX && result; size += 7) {
+      const mi_sizeclass_t sc = mi_sizeclass_of(size);
+      void* p = mi_malloc_sc(sc);
+      result = (sc == MI_SIZECLASS_OF(size) && p != NULL && mi_usable_size(p) >= size);
+      if (p != NULL) { memset(p, 0xAB, size); }
+      mi_free_sc(p, sc);
+    }
+    mi_heap_t* heap = mi_heap_new();
+    uint8_t* p = (uint8_t*)mi_heap_zalloc_sc(heap, MI_SIZECLASS_OF(100));
+    result = result && p != NULL && mem_is_zero(p, 100) && mi_heap_contains_block(heap, p);
+    mi_heap_delete(heap);
+    mi_free(p);
+  };
+
+  // ---------------------------------------------------
+  // Batch allocation
+  // ---------------------------------------------------
+  CHECK_BODY("malloc-batch") {
+    void* ps[1000];
+    mi_heap_t* heap = mi_heap_new();
+    const size_t n = mi_heap_malloc_batch(heap, 40, 1000, ps);
+    result = (n == 1000);
+    for (size_t i = 0; i < n && result; i++) {
+      result = (ps[i] != NULL && mi_usable_size(ps[i]) >= 40 && mi_heap_contains_block(heap, ps[i]));
+      if (result) { memset(ps[i], 0xAB, 40); }
+    }
+    for (size_t i = 0; i < n; i++) { mi_free(ps[i]); }
+    mi_heap_delete(heap);
+  };
+  CHECK_BODY("zalloc-batch") {
+    void* ps[100];
+    for (size_t size = 0; size <= 64*1024 && result; size = 2*size + 24) {
+      const size_t n = mi_zalloc_batch(size, 100, ps);
+      result = (n == 100);
+      for (size_t i = 0; i < n; i++) {
+        if (!mem_is_zero((uint8_t*)ps[i], size)) { result = false; }
+        memset(ps[i], 0xAB, size);  // dirty for the next round
+        mi_free(ps[i]);
+      }
+    }
+  };
+  CHECK_BODY("free-batch") {
+    void* ps[1000];
+    mi_heap_t* heap = mi_heap_new();
+    const size_t n = mi_heap_malloc_batch(heap, 24, 500, ps);
+    result = (n == 500);
+    for (size_t i = n; i < 1000; i++) {
+      ps[i] = (i % 3 == 0 ? NULL : mi_heap_malloc(heap, i));  // interleave pages and NULL pointers
+    }
+    mi_free_batch(ps, 1000);
+    mi_heap_collect(heap, true);
+    size_t used = 0;
+    mi_heap_visit_blocks(heap, false, &test_count_used, &used);
+    result = result && (used == 0);
+    mi_heap_delete(heap);
+  };
+  #if MI_ENCODE_FREELIST
+  CHECK("free-batch-double", test_free_batch_double());
+  #endif
+
+  CHECK_BODY("malloc-page-bump") {
+    void* ps[1000];
+    mi_option_enable(mi_option_page_bump);
+    mi_heap_t* heap = mi_heap_new();
+    for (size_t i = 0; i < 1000; i++) {
+      ps[i] = mi_heap_malloc(heap, 32 + (i % 4)*100);
+      if (ps[i] == NULL) { result = false; } else { memset(ps[i], 0xAB, 32); }
+    }
+    for (size_t i = 0; i < 1000; i += 2) { mi_free(ps[i]); }
+    for (size_t i = 0; i < 1000 && result; i += 2) {
+      ps[i] = mi_heap_zalloc(heap, 32 + (i % 4)*100);
+      result = (ps[i] != NULL && mem_is_zero((uint8_t*)ps[i], 32 + (i % 4)*100));
+    }
+    const size_t n = mi_heap_zalloc_batch(heap, 48, 500, ps);
+    for (size_t i = 0; i < n && result; i++) { result = mem_is_zero((uint8_t*)ps[i], 48); }
+    mi_heap_destroy(heap);
+    mi_option_disable(mi_option_page_bump);
+  };
+
   // ---------------------------------------------------
   // Heaps
   // ---------------------------------------------------
   CHECK("heap_destroy", test_heap1());
   CHECK("heap_delete", test_heap2());
+  CHECK("objcache", test_objcache());
+  CHECK_BODY("heap-monotonic") {
+    mi_heap_t* heap = mi_heap_new_monotonic();
+    uint8_t* ps[200];
+    for (size_t i = 0; i < 200; i++) {
+      const size_t size = (i % 50 == 0 ? 300*1024 : i*13);
+      ps[i] = (uint8_t*)mi_heap_malloc(heap, size);
+      result = result && ps[i] != NULL && ((uintptr_t)ps[i] % MI_MAX_ALIGN_SIZE) == 0 && mi_heap_contains_block(heap, ps[i]);
+      if (ps[i] != NULL) { memset(ps[i], (int)(i & 0xFF), size); }
+      if (i % 2 == 1) { mi_free(ps[i]); }   // a no-op
+    }
+    for (size_t i = 0; i < 200 && result; i += 2) {
+      const size_t size = (i % 50 == 0 ? 300*1024 : i*13);
+      for (size_t j = 0; j < size && result; j++) { result = (ps[i][j] == (uint8_t)(i & 0xFF)); }
+    }
+    for (size_t i = 1; i < 200 && result; i++) {
+      // the usable size of an object does not overlap the next one (and writing it is safe)
+      const size_t size = (i % 50 == 0 ? 300*1024 : i*13);
+      const size_t usable = mi_usable_size(ps[i]);
+      result = (usable >= size && usable < size + MI_MAX_ALIGN_SIZE);
+      if (i % 2 == 0) { memset(ps[i], (int)(i & 0xFF), usable); }
+    }
+    for (size_t i = 0; i < 200 && result; i += 2) {
+      const size_t size = (i % 50 == 0 ? 300*1024 : i*13);
+      for (size_t j = 0; j < size && result; j++) { result = (ps[i][j] == (uint8_t)(i & 0xFF)); }
+    }
+    uint8_t* q = (uint8_t*)mi_heap_malloc_aligned(heap, 100, 256);
+    result = result && q != NULL && ((uintptr_t)q % 256) == 0 && mi_usable_size(q) >= 100 && mi_usable_size(q) < 256 + 100;
+    uint8_t* p = (uint8_t*)mi_heap_zalloc(heap, 1000);
+    result = result && mem_is_zero(p, 1000) && mi_usable_size(p) == 1008;
+    p[0] = 42;
+    p = (uint8_t*)mi_heap_realloc(heap, p, 900);
+    result = result && p[0] == 42 && mi_expand(p, 800) == NULL;
+    mi_heap_destroy(heap);
+  };
+  CHECK_BODY("heap-numa") {
+    // note: this is a smoke test as the numa node of a block is not visible through the API
+    // (and on a single node system the binding does nothing)
+    mi_heap_t* heap = mi_heap_new_on_numa(0);
+    void* ps[100];
+    for (size_t i = 0; i < 100; i++) {
+      ps[i] = mi_heap_malloc(heap, (i % 10 == 0 ? 200*1024 : 8 + i*16));
+      result = result && ps[i] != NULL && mi_heap_contains_block(heap, ps[i]);
+    }
+    for (size_t i = 0; i < 100; i += 2) { mi_free(ps[i]); }
+    mi_heap_delete(heap);
+    result = result && mi_thread_set_numa_node(0);
+    void* p = mi_malloc(1000);
+    result = result && p != NULL;
+    mi_free(p);
+    result = result && mi_thread_set_numa_node(-1);
+  };
+  CHECK_BODY("heap-numa-invalid") {
+    // nodes beyond the node count are rejected (instead of wrapping around)
+    const bool show_errors = mi_option_is_enabled(mi_option_show_errors);
+    mi_option_disable(mi_option_show_errors);
+    int err = 0;
+    mi_register_error(&test_last_error, &err);
+    result = (mi_heap_new_on_numa(1 << 20) == NULL && err == EINVAL);
+    err = 0;
+    result = result && !mi_thread_set_numa_node(1 << 20) && err == EINVAL;
+    mi_register_error(NULL, NULL);
+    mi_option_set_enabled(mi_option_show_errors, show_errors);
+  };
+  CHECK_BODY("heap-thp") {
+    mi_heap_t* heap = mi_heap_new();
+    mi_heap_set_thp(heap, 1);
+    void* ps[64];
+    for (size_t i = 0; i < 64; i++) {
+      ps[i] = mi_heap_malloc(heap, (i % 16 == 0 ? 3*1024*1024 : 8 + i*1024));
+      result = result && ps[i] != NULL && mi_heap_contains_block(heap, ps[i]);
+    }
+    for (size_t i = 0; i < 64; i += 2) { mi_free(ps[i]); }
+    ps[1] = mi_heap_realloc(heap, ps[1], 5*1024*1024);
+    ps[1] = mi_heap_realloc(heap, ps[1], 1024*1024);
+    result = result && ps[1] != NULL;
+    mi_heap_collect(heap, true);
+    mi_heap_delete(heap);
+  };
+  CHECK_BODY("heap-defrag") {
+    mi_heap_t* heap = mi_heap_new();
+    const size_t n = 10000;
+    void** ps = (void**)mi_malloc(n * sizeof(void*));
+    for (size_t i = 0; i < n; i++) { ps[i] = mi_heap_malloc(heap, 64); }
+    for (size_t i = 0; i < n; i++) {
+      if (i % 10 != 0) { mi_free(ps[i]); ps[i] = NULL; }
+    }
+    result = (mi_heap_defrag_begin(heap, 25) > 0);
+    size_t moved = 0;
+    for (size_t i = 0; i < n; i++) {
+      if (ps[i] != NULL && mi_defrag_should_move(ps[i])) {
+        void* p = mi_heap_malloc(heap, 64);
+        result = result && !mi_defrag_should_move(p);
+        mi_free(ps[i]);
+        ps[i] = p;
+        moved++;
+      }
+    }
+    mi_heap_defrag_end(heap);
+    result = result && moved > 0;
+    for (size_t i = 0; i < n; i++) { result = result && !mi_defrag_should_move(ps[i]); mi_free(ps[i]); }
+    mi_free(ps);
+    mi_heap_delete(heap);
+  };
+  #if TEST_THREADS
+  CHECK("heap-defrag-remote", test_heap_defrag_remote());
+  #endif
+  CHECK("heap-commit-limit", test_commit_limit());
+  #if MI_HEAP_PROFILE
+  CHECK("heap-profile", test_heap_profile());
+  #endif
+  CHECK_BODY("heap-stats") {
+    mi_heap_t* heap = mi_heap_new();
+    void* ps[100];
+    for (size_t i = 0; i < 100; i++) { ps[i] = mi_heap_malloc(heap, 64); }
+    mi_stats_t_decl(stats);
+    result = mi_heap_stats_get(heap, &stats);
+    result = result && stats.pages.current >= 1 && stats.page_committed.current >= 100*64;
+    result = result && stats.malloc_normal_count.total == 100 && stats.malloc_normal.current >= 100*64;
+    for (size_t i = 0; i < 100; i++) { mi_free(ps[i]); }
+    mi_heap_collect(heap, true);
+    result = result && mi_heap_stats_get(heap, &stats) && stats.pages.current == 0 && stats.malloc_normal_count.total == 0;
+    mi_heap_delete(heap);
+  };
+  #if MI_STAT || MI_STAT_LITE
+  CHECK_BODY("stats-get") {
+    mi_stats_t_decl(before);
+    mi_stats_t_decl(after);
+    void* ps[100];
+    mi_stats_merge();
+    result = mi_stats_get(&before);
+    for (size_t i = 0; i < 100; i++) { ps[i] = mi_malloc(64); }
+    mi_stats_merge();
+    result = result && mi_stats_get(&after);
+    result = result && (after.malloc_normal_count.total - before.malloc_normal_count.total >= 100);
+    result = result && (after.malloc_normal.current - before.malloc_normal.current >= 100*64);
+    for (size_t i = 0; i < 100; i++) { mi_free(ps[i]); }
+    mi_stats_merge();
+    result = result && mi_stats_get(&after);
+    result = result && (after.malloc_normal.current - before.malloc_normal.current < 100*64);
+  };
+  #endif
+  CHECK_BODY("stats-latency") {
+    mi_stats_t_decl(before);
+    mi_stats_t_decl(after);
+    void* ps[1000];
+    mi_option_enable(mi_option_latency_stats);
+    mi_stats_merge();
+    result = mi_stats_get(&before);
+    for (size_t i = 0; i < 1000; i++) { ps[i] = mi_malloc(1000 + 8*i); }  // many sizes to take the generic path
+    for (size_t i = 0; i < 1000; i++) { mi_free(ps[i]); }
+    mi_option_disable(mi_option_latency_stats);
+    mi_stats_merge();
+    result = result && mi_stats_get(&after);
+    int64_t count = 0;
+    for (size_t b = 0; b < MI_STAT_LATENCY_BUCKETS; b++) {
+      count += after.latency_bins[mi_latency_malloc_generic][b].total - before.latency_bins[mi_latency_malloc_generic][b].total;
+    }
+    result = result && (count >= 10);
+  };
+  #if !defined(_WIN32)
+  CHECK_BODY("trace-dump") {
+    mi_option_set(mi_option_trace_events, 1024);
+    void* p = mi_malloc(64*1024*1024);  // a huge allocation allocates (and commits) a fresh segment
+    mi_free(p);
+    mi_option_set(mi_option_trace_events, 0);
+    FILE* f = tmpfile();
+    result = (f != NULL && mi_trace_dump(fileno(f)));
+    if (result) {
+      mi_trace_header_t header;
+      mi_trace_thread_t thread;
+      rewind(f);
+      result = (fread(&header, sizeof(header), 1, f) == 1 && memcmp(header.magic, "mi-trace", 8) == 0 &&
+                header.version == MI_TRACE_VERSION && fread(&thread, sizeof(thread), 1, f) == 1 && thread.count > 0);
+    }
+    if (f != NULL) { fclose(f); }
+  };
+  #endif
+  #if !defined(__wasi__)
+  CHECK_BODY("purge-thread") {
+    void* ps[16];
+    const bool delayed = (mi_option_get(mi_option_purge_delay) > 0);  // the thread is only used for delayed purges
+    const bool purge_thread = mi_option_is_enabled(mi_option_purge_thread);
+    mi_option_enable(mi_option_purge_thread);
+    for (size_t n = 0; n < 16; n++) {  // take the generic path (at least 100 times) to start the thread
+      for (size_t i = 0; i < 16; i++) { ps[i] = mi_malloc(1024*1024); }
+      for (size_t i = 0; i < 16; i++) { mi_free(ps[i]); }
+    }
+    mi_stats_t_decl(before);
+    mi_stats_t_decl(after);
+    size_t start, elapsed;
+    mi_process_info(&start, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+    result = mi_stats_get(&before);
+    // without further allocator calls the purge thread purges the freed memory
+    do {
+      mi_process_info(&elapsed, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+      result = result && mi_stats_get(&after);
+    } while (delayed && result && after.purge_calls.total == before.purge_calls.total && elapsed - start < 2000);
+    result = result && (!delayed || after.purge_calls.total > before.purge_calls.total);
+    mi_option_set_enabled(mi_option_purge_thread, purge_thread);  // note: a started thread keeps running
+  };
+  CHECK_BODY("purge-adaptive") {
+    void* ps[16];
+    const long delay = mi_option_get(mi_option_purge_delay);
+    const bool purge_thread = mi_option_is_enabled(mi_option_purge_thread);
+    const bool adaptive = mi_option_is_enabled(mi_option_purge_adaptive);
+    mi_option_enable(mi_option_purge_thread);    // purge while idle (started on the generic path of the first bursts)
+    mi_option_enable(mi_option_purge_adaptive);
+    void* keep = mi_malloc(64*1024);              // keep the segment alive
+    mi_stats_t_decl(before);
+    mi_stats_t_decl(after);
+    int64_t late_purges = 0;
+    for (size_t n = 0; n < 16; n++) {
+      // a burst that reuses the memory of the previous burst after the purge delay expired
+      mi_stats_merge();
+      result = result && mi_stats_get(&before);
+      for (size_t i = 0; i < 16; i++) { ps[i] = mi_malloc(1024*1024); }
+      for (size_t i = 0; i < 16; i++) { mi_free(ps[i]); }
+      mi_collect(false);
+      size_t start, elapsed;
+      mi_process_info(&start, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+      do {
+        mi_process_info(&elapsed, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+      } while (delay > 0 && elapsed - start < (size_t)(4*delay));
+      mi_stats_merge();
+      result = result && mi_stats_get(&after);
+      if (n >= 8) { late_purges += after.purge_calls.total - before.purge_calls.total; }
+    }
+    mi_free(keep);
+    mi_option_set_enabled(mi_option_purge_adaptive, adaptive);
+    mi_option_set_enabled(mi_option_purge_thread, purge_thread);
+    // the delay is lengthened such that the later bursts are no longer purged in between
+    result = result && (delay <= 0 || late_purges < 8);
+  };
+  #endif
 
   //mi_stats_print(NULL);
 
@@ -364,6 +761,13 @@ int main(void) {
   };
   #endif
 
+  #if TEST_THREADS
+  CHECK("remote-free-buffered", test_remote_free_buffered());
+  #endif
+  #if TEST_THREADS && defined(__linux__)
+  CHECK("cpu-heaps", test_cpu_heaps());
+  #endif
+
   CHECK("stl_allocator1", test_stl_allocator1());
   CHECK("stl_allocator2", test_stl_allocator2());
 
@@ -402,6 +806,358 @@ bool test_heap2(void) {
   return true;
 }
 
+bool test_count_used(const mi_heap_t* heap, const mi_heap_area_t* area, void* block, size_t block_size, void* arg) {
+  (void)heap; (void)block; (void)block_size;
+  *((size_t*)arg) += area->used;
+  return true;
+}
+
+typedef struct test_obj_s { uint64_t magic; size_t uses; } test_obj_t;
+static void test_obj_init(void* p, void* arg) { test_obj_t* obj = (test_obj_t*)p; obj->magic = 0xFEED; obj->uses = 0; (*(size_t*)arg)++; }
+static void test_obj_done(void* p, void* arg) { test_obj_t* obj = (test_obj_t*)p; obj->magic = 0; (*(size_t*)arg)--; }
+
+bool test_objcache(void) {
+  size_t live = 0;
+  mi_objcache_t* oc = mi_objcache_new(42, sizeof(test_obj_t), &test_obj_init, &test_obj_done, &live);
+  if (oc == NULL) return false;
+  bool ok = true;
+  test_obj_t* objs[1000];
+  for (int round = 0; round < 3 && ok; round++) {
+    for (int i = 0; i < 1000 && ok; i++) {
+      objs[i] = (test_obj_t*)mi_objcache_alloc(oc);
+      ok = (objs[i] != NULL && objs[i]->magic == 0xFEED && objs[i]->uses <= (size_t)round);
+      if (ok) { objs[i]->uses++; }   // freed objects stay constructed
+    }
+    for (int i = 0; i < 1000; i++) { mi_objcache_free(oc, objs[i]); }
+  }
+  ok = ok && (live >= 1000);
+  // another heap with the same tag does not construct its blocks
+  const size_t live_before = live;
+  mi_heap_t* heap = mi_heap_new_ex(42, false, 0);
+  void* p = mi_heap_malloc(heap, sizeof(test_obj_t) + 16);
+  ok = ok && (p != NULL && live == live_before);
+  mi_free(p);
+  mi_heap_delete(heap);
+  // deleting the cache destructs all objects, also the ones still in use
+  for (int i = 0; i < 100 && ok; i++) {
+    ok = (mi_objcache_alloc(oc) != NULL);
+  }
+  mi_objcache_delete(oc);
+  return (ok && live == 0);
+}
+
+static void test_commit_pressure(mi_heap_t* heap, size_t committed, size_t limit, void* arg) {
+  if (heap != NULL && committed > limit) { (*(size_t*)arg)++; }
+}
+
+bool test_commit_limit(void) {
+  size_t pressure = 0;
+  mi_register_commit_pressure(&test_commit_pressure, &pressure);
+  mi_heap_t* heap = mi_heap_new();
+  mi_heap_set_commit_limit(heap, 1024*1024, 4*1024*1024);
+  size_t total = 0;
+  void* p;
+  while ((p = mi_heap_malloc(heap, 32*1024)) != NULL && total < 64*1024*1024) {
+    total += 32*1024;
+  }
+  mi_heap_delete(heap);
+  mi_register_commit_pressure(NULL, NULL);
+  return (p == NULL && total >= 1024*1024 && total <= 4*1024*1024 && pressure == 1);
+}
+
+// sum the bytes at the end of each line of collapsed stacks (one call per line)
+static void test_profile_out(const char* msg, void* arg) {
+  const char* last = strrchr(msg, ' ');
+  if (last == NULL) return;
+  long long n = 0;
+  for (const char* c = last + 1; *c >= '0' && *c <= '9'; c++) { n = 10*n + (*c - '0'); }
+  *(long long*)arg += n;
+}
+
+static long long test_profile_live(void) {
+  long long live = 0;
+  mi_heap_profile_print_out(mi_heap_profile_collapsed_live, &test_profile_out, &live);
+  return live;
+}
+
+static long long test_profile_lifetimes(void) {
+  mi_stats_t_decl(stats);
+  mi_stats_get(&stats);
+  long long freed = 0;
+  for (size_t i = 0; i <= MI_BIN_HUGE; i++) {
+    for (size_t b = 0; b < MI_STAT_LIFETIME_BUCKETS; b++) { freed += stats.lifetime_bins[i][b].total; }
+  }
+  return freed;
+}
+
+bool test_heap_profile(void) {
+  const long long freed = test_profile_lifetimes();
+  mi_heap_t* heap = mi_heap_new();
+  mi_heap_profile_set_sample_rate(heap, 1);  // sample every allocation
+  const long long before = test_profile_live();
+  void* ps[100];
+  for (size_t i = 0; i < 100; i++) { ps[i] = mi_heap_malloc(heap, 64); }
+  const long long live = test_profile_live();
+  for (size_t i = 0; i < 100; i++) { mi_free(ps[i]); }
+  const long long after = test_profile_live();
+  for (size_t i = 0; i < 100; i++) { ps[i] = mi_heap_malloc(heap, 64); }
+  #if MI_GUARDED
+  for (size_t i = 0; i < 100; i++) { mi_free(ps[i]); }  // `mi_heap_destroy` is `mi_heap_delete` in guarded builds and keeps the samples
+  #endif
+  mi_heap_destroy(heap);  // forgets the samples
+  return (live - before == 100*64 && after == before && test_profile_live() == before &&
+          test_profile_lifetimes() - freed >= 200);
+}
+
+#if MI_ENCODE_FREELIST
+static void test_count_error(int err, void* arg) {
+  if (err == EAGAIN) { (*((size_t*)arg))++; }
+}
+
+// a pointer that occurs twice in a batch is detected as a double free (and only freed once)
+bool test_free_batch_double(void) {
+  mi_heap_t* heap = mi_heap_new();
+  void* a = mi_heap_malloc(heap, 24);
+  void* b = mi_heap_malloc(heap, 24);
+  void* c = mi_heap_malloc(heap, 24);
+  if (a == NULL || b == NULL || c == NULL) return false;
+  size_t errors = 0;
+  const bool show_errors = mi_option_is_enabled(mi_option_show_errors);
+  mi_option_disable(mi_option_show_errors);
+  mi_register_error(&test_count_error, &errors);
+  void* ps[4] = { a, b, a, c };
+  mi_free_batch(ps, 4);
+  mi_register_error(NULL, NULL);
+  mi_option_set_enabled(mi_option_show_errors, show_errors);
+  void* x = mi_heap_malloc(heap, 24);
+  void* y = mi_heap_malloc(heap, 24);
+  const bool ok = (errors == 1 && x != y);
+  mi_free(x);
+  mi_free(y);
+  mi_heap_delete(heap);
+  return ok;
+}
+#endif
+
+#if TEST_THREADS
+#define TEST_REMOTE_BLOCKS  (200)
+static void* test_remote_blocks[TEST_REMOTE_BLOCKS];
+static void* test_remote_dblocks[10];  // in a heap that can be destroyed
+static int   test_remote_stage;
+
+// the consumer and producer take turns: odd stages are for the consumer
+static void test_remote_wait(int stage) {
+  while (__atomic_load_n(&test_remote_stage, __ATOMIC_ACQUIRE) != stage) { /* spin */ }
+}
+
+static void test_remote_next(int stage) {
+  __atomic_store_n(&test_remote_stage, stage, __ATOMIC_RELEASE);
+}
+
+static void* test_remote_consumer(void* arg) {
+  (void)arg;
+  mi_thread_set_remote_free_buffered(true);
+  size_t i = 0;
+  for (int stage = 1; stage <= 9; stage += 2) {
+    test_remote_wait(stage);
+    const size_t n = (stage == 3 ? 54 : 10);  // at stage 3 the page chain reaches 64 blocks
+    for (size_t k = 0; k < n; k++, i++) { mi_free(test_remote_blocks[i]); }
+    if (stage == 1) { for (size_t k = 0; k < 10; k++) { mi_free(test_remote_dblocks[k]); } }  // not buffered
+    if (stage == 5) { mi_free(mi_malloc(4*1024*1024)); }           // slow path
+    if (stage == 7) { mi_collect(false); }
+    if (stage == 9) { mi_thread_set_remote_free_buffered(false); }
+    test_remote_next(stage + 1);
+  }
+  test_remote_wait(11);
+  mi_thread_set_remote_free_buffered(true);
+  for (size_t k = 0; k < 10; k++, i++) { mi_free(test_remote_blocks[i]); }
+  return NULL;  // thread done
+}
+
+static size_t test_remote_used(mi_heap_t* heap) {
+  size_t used = 0;
+  mi_heap_collect(heap, false);   // collects published frees
+  mi_heap_visit_blocks(heap, false, &test_count_used, &used);
+  return used;
+}
+
+bool test_remote_free_buffered(void) {
+  mi_heap_t* heap = mi_heap_new_in_arena(0);  // (frees to heaps that can be destroyed are never buffered)
+  for (size_t i = 0; i < TEST_REMOTE_BLOCKS; i++) {
+    test_remote_blocks[i] = mi_heap_malloc(heap, 64);
+    if (test_remote_blocks[i] == NULL) return false;
+  }
+  mi_heap_t* dheap = mi_heap_new();
+  for (size_t i = 0; i < 10; i++) {
+    test_remote_dblocks[i] = mi_heap_malloc(dheap, 64);
+    if (test_remote_dblocks[i] == NULL) return false;
+  }
+  test_remote_stage = 0;
+  pthread_t consumer;
+  if (pthread_create(&consumer, NULL, &test_remote_consumer, NULL) != 0) return false;
+  // 1: buffered, 3: the chain is full, 5: slow path, 7: collect, 9: disabled
+  const size_t expected[5] = { 0, 64, 74, 84, 94 };
+  bool ok = true;
+  for (int stage = 1; stage <= 9; stage += 2) {
+    test_remote_next(stage);
+    test_remote_wait(stage + 1);
+    ok = (test_remote_used(heap) == TEST_REMOTE_BLOCKS - expected[stage/2]) && ok;
+    if (stage == 1) {
+      ok = (test_remote_used(dheap) == 0) && ok;
+      mi_heap_destroy(dheap);
+    }
+  }
+  // 11: thread done
+  test_remote_next(11);
+  pthread_join(consumer, NULL);
+  ok = (test_remote_used(heap) == TEST_REMOTE_BLOCKS - 104) && ok;
+  for (size_t i = 104; i < TEST_REMOTE_BLOCKS; i++) { mi_free(test_remote_blocks[i]); }
+  mi_heap_delete(heap);
+  return ok;
+}
+#endif
+
+#if TEST_THREADS
+static uint8_t* test_reclaim_large;
+static void*    test_reclaim_small;
+
+static void* test_reclaim_alloc(void* arg) {
+  test_reclaim_small = mi_malloc(64);  // (first, so its page is not in the way of the large block)
+  test_reclaim_large = (uint8_t*)mi_zalloc(MI_MiB);
+  if (test_reclaim_large != NULL) { test_reclaim_large[MI_MiB - 1] = 42; }
+  return arg;  // and abandon the segment on exit
+}
+
+// a reclaimed large page is not in the full queue but its block can still grow in place
+bool test_realloc_reclaimed(void) {
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, &test_reclaim_alloc, NULL) != 0) return false;
+  pthread_join(thread, NULL);
+  const long reclaim = mi_option_get(mi_option_abandoned_reclaim_on_free);
+  mi_option_set(mi_option_abandoned_reclaim_on_free, 1);
+  mi_free(test_reclaim_small);  // reclaims the segment into our heap
+  mi_option_set(mi_option_abandoned_reclaim_on_free, reclaim);
+  const size_t usable = mi_usable_size(test_reclaim_large);
+  uint8_t* const p = (uint8_t*)mi_rezalloc(test_reclaim_large, 2*MI_MiB);
+  const bool ok = (p != NULL && p == test_reclaim_large && p[MI_MiB - 1] == 42 &&
+                   mem_is_zero(p + usable, 2*MI_MiB - usable));
+  mi_free(p);
+  return ok;
+}
+
+#define TEST_DEFRAG_BLOCKS  (10000)
+static void* test_defrag_blocks[TEST_DEFRAG_BLOCKS];
+
+static void* test_defrag_remote_free(void* arg) {
+  (void)arg;
+  for (size_t i = 0; i < TEST_DEFRAG_BLOCKS; i++) {
+    if (i % 10 != 0) { mi_free(test_defrag_blocks[i]); test_defrag_blocks[i] = NULL; }
+  }
+  return NULL;
+}
+
+// pages that are full when another thread frees most of their blocks are sparse as well
+bool test_heap_defrag_remote(void) {
+  mi_heap_t* heap = mi_heap_new();
+  for (size_t i = 0; i < TEST_DEFRAG_BLOCKS; i++) {
+    test_defrag_blocks[i] = mi_heap_malloc(heap, 64);
+    if (test_defrag_blocks[i] == NULL) return false;
+  }
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, &test_defrag_remote_free, NULL) != 0) return false;
+  pthread_join(thread, NULL);
+  bool ok = (mi_heap_defrag_begin(heap, 25) > 0);
+  size_t moved = 0;
+  for (size_t i = 0; i < TEST_DEFRAG_BLOCKS; i += 10) {
+    if (mi_defrag_should_move(test_defrag_blocks[i])) {
+      void* p = mi_heap_malloc(heap, 64);
+      ok = ok && !mi_defrag_should_move(p);
+      mi_free(test_defrag_blocks[i]);
+      test_defrag_blocks[i] = p;
+      moved++;
+    }
+  }
+  mi_heap_defrag_end(heap);
+  ok = ok && (moved >= TEST_DEFRAG_BLOCKS/10 - 200);  // all but the blocks in the last (expandable) pages
+  for (size_t i = 0; i < TEST_DEFRAG_BLOCKS; i += 10) { mi_free(test_defrag_blocks[i]); }
+  mi_heap_delete(heap);
+  return ok;
+}
+#endif
+
+#if TEST_THREADS && defined(__linux__)
+#define TEST_CPU_THREADS  (8)
+#define TEST_CPU_BLOCKS   (2000)
+static void* test_cpu_blocks[TEST_CPU_THREADS][TEST_CPU_BLOCKS];
+
+static void test_cpu_deferred(bool force, unsigned long long heartbeat, void* arg) {
+  (void)force; (void)heartbeat;
+  // allocate while the heap of the cpu is claimed
+  void* p = mi_malloc(64);
+  if (p != NULL) { __atomic_fetch_add((size_t*)arg, 1, __ATOMIC_RELAXED); }
+  mi_free(p);
+}
+
+static void* test_cpu_alloc(void* arg) {
+  const size_t id = (size_t)arg;
+  bool ok = true;
+  for (int round = 0; round < 20 && ok; round++) {
+    for (size_t i = 0; i < TEST_CPU_BLOCKS && ok; i++) {
+      const size_t size = 1 + (i % 500);
+      uint8_t* p = (uint8_t*)(i % 7 == 0 ? mi_malloc_aligned(size, 64) : mi_malloc(size));
+      ok = (p != NULL);
+      if (ok) { memset(p, (int)id, size); }
+      test_cpu_blocks[id][i] = p;
+    }
+    for (size_t i = 0; i < TEST_CPU_BLOCKS && ok; i++) {
+      const uint8_t* p = (const uint8_t*)test_cpu_blocks[id][i];
+      ok = (p[0] == (uint8_t)id && p[i % 500] == (uint8_t)id);
+    }
+    // free all blocks locally except in the last round
+    for (size_t i = 0; i < TEST_CPU_BLOCKS && round < 19; i++) { mi_free(test_cpu_blocks[id][i]); }
+  }
+  void* ps[100];
+  const size_t n = mi_malloc_batch(40, 100, ps);
+  ok = ok && (n == 100);
+  mi_free_batch(ps, n);
+  return (ok ? arg : NULL);
+}
+
+static void* test_cpu_free(void* arg) {
+  // free the blocks of another thread
+  const size_t id = ((size_t)arg + 1) % TEST_CPU_THREADS;
+  for (size_t i = 0; i < TEST_CPU_BLOCKS; i++) { mi_free(test_cpu_blocks[id][i]); }
+  return arg;
+}
+
+static bool test_cpu_run(void* (*fun)(void*)) {
+  pthread_t threads[TEST_CPU_THREADS];
+  bool ok = true;
+  for (size_t i = 0; i < TEST_CPU_THREADS; i++) {
+    if (pthread_create(&threads[i], NULL, fun, (void*)i) != 0) return false;
+  }
+  for (size_t i = 0; i < TEST_CPU_THREADS; i++) {
+    void* res = NULL;
+    pthread_join(threads[i], &res);
+    ok = ok && (res == (void*)i);
+  }
+  return ok;
+}
+
+bool test_cpu_heaps(void) {
+  const bool enabled = mi_option_is_enabled(mi_option_cpu_heaps);
+  size_t reentered = 0;
+  mi_option_enable(mi_option_cpu_heaps);
+  mi_register_deferred_free(&test_cpu_deferred, &reentered);
+  bool ok = test_cpu_run(&test_cpu_alloc);
+  ok = test_cpu_run(&test_cpu_free) && ok;
+  mi_register_deferred_free(NULL, NULL);
+  mi_option_set_enabled(mi_option_cpu_heaps, enabled);
+  // the deferred free callback allocates from within the allocator
+  return (ok && reentered > 0);
+}
+#endif
+
 bool test_stl_allocator1(void) {
 #ifdef __cplusplus
   std::vector<int, mi_stl_allocator<int> > vec;
@@ -0,0 +1,100 @@
+/* ----------------------------------------------------------------------------
+Copyright (c) 2018-2024, Microsoft Research, Daan Leijen
+This is free software; you can redistribute it and/or modify it under the
+terms of the MIT license. A copy of the license can be found in the file
+"LICENSE" at the root of this distribution.
+-----------------------------------------------------------------------------*/
+
+/* -----------------------------------------------------------
+  Decode a dump of the mimalloc flight recorder (see `mi_trace_dump`
+  and `mi_option_trace_dump_on_error`) as text or JSON.
+
+  Build with:   cc -O2 -Iinclude -o mitrace tools/mitrace.c
+  Use as:       mitrace [--json] <dump file>
+
+  Times are shown relative to the moment of the dump.
+----------------------------------------------------------- */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <mimalloc-stats.h>   // only for the dump format
+
+static const char* mitrace_kind_names[mi_trace_last] = {
+  "none", "malloc_generic", "segment_alloc", "segment_abandon", "segment_reclaim",
+  "arena_reserve", "arena_purge", "os_commit", "os_decommit", "os_purge", "error"
+};
+
+static const char* mitrace_kind_name(uint32_t kind) {
+  return (kind < mi_trace_last ? mitrace_kind_names[kind] : "unknown");
+}
+
+static void mitrace_print_event(const mi_trace_event_t* ev, int64_t dump_time, bool json, bool last) {
+  const double ms = (double)(ev->time - dump_time) / 1.0e6;
+  if (json) {
+    printf("        { \"time_ms\": %.6f, \"kind\": \"%s\", \"addr\": \"0x%llx\", \"size\": %llu, \"arg\": %u }%s\n",
+           ms, mitrace_kind_name(ev->kind), (unsigned long long)ev->addr, (unsigned long long)ev->size, ev->arg, (last ? "" : ","));
+  }
+  else {
+    printf("  %14.6f ms  %-16s addr: 0x%012llx  size: %12llu  arg: %u\n",
+           ms, mitrace_kind_name(ev->kind), (unsigned long long)ev->addr, (unsigned long long)ev->size, ev->arg);
+  }
+}
+
+int main(int argc, char** argv) {
+  bool json = false;
+  const char* fname = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--json") == 0) { json = true; }
+    else { fname = argv[i]; }
+  }
+  if (fname == NULL) {
+    fprintf(stderr, "usage: mitrace [--json] <dump file>\n");
+    return 2;
+  }
+  FILE* f = fopen(fname, "rb");
+  if (f == NULL) {
+    fprintf(stderr, "mitrace: cannot open '%s'\n", fname);
+    return 1;
+  }
+
+  mi_trace_header_t header;
+  if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, "mi-trace", 8) != 0) {
+    fprintf(stderr, "mitrace: '%s' is not a mimalloc trace dump\n", fname);
+    fclose(f);
+    return 1;
+  }
+  if (header.version != MI_TRACE_VERSION || header.event_size != sizeof(mi_trace_event_t)) {
+    fprintf(stderr, "mitrace: unsupported dump version %u (expecting version %d)\n", header.version, MI_TRACE_VERSION);
+    fclose(f);
+    return 1;
+  }
+
+  if (json) { printf("{\n  \"version\": %u,\n  \"threads\": [\n", header.version); }
+  mi_trace_thread_t thread;
+  bool first_thread = true;
+  int result = 0;
+  while (fread(&thread, sizeof(thread), 1, f) == 1) {
+    if (json) {
+      printf("%s    { \"thread_id\": \"0x%llx\", \"events\": [\n", (first_thread ? "" : ",\n"), (unsigned long long)thread.thread_id);
+    }
+    else {
+      printf("thread 0x%llx: %llu events\n", (unsigned long long)thread.thread_id, (unsigned long long)thread.count);
+    }
+    first_thread = false;
+    for (uint64_t i = 0; i < thread.count; i++) {
+      mi_trace_event_t ev;
+      if (fread(&ev, sizeof(ev), 1, f) != 1) {
+        fprintf(stderr, "mitrace: truncated dump\n");
+        result = 1;
+        break;
+      }
+      mitrace_print_event(&ev, header.time, json, i+1 == thread.count);
+    }
+    if (json) { printf("      ] }"); }
+    if (result != 0) break;
+  }
+  if (json) { printf("\n  ]\n}\n"); }
+  fclose(f);
+  return result;
+}